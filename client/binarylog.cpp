@@ -0,0 +1,366 @@
+#include "binarylog.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <atomic>
+#include <cstring>
+
+#include "mozilla/shared/loglevel.h"
+
+namespace
+{
+    // Past this many distinct literals new ones are written inline.
+    constexpr int MAX_INTERNED = 65536;
+    // Upper bound for a single string, anything larger is corrupt input.
+    constexpr quint64 MAX_STRING_SIZE = 16 * 1024 * 1024;
+
+    void writeVarint(quint64 value, QByteArray &out)
+    {
+        while (value >= 0x80) {
+            out.append(char(value | 0x80));
+            value >>= 7;
+        }
+        out.append(char(value));
+    }
+
+    void writeString(const QByteArray &value, QByteArray &out)
+    {
+        writeVarint(value.size(), out);
+        out.append(value);
+    }
+
+    quint64 zigzag(qint64 value)
+    {
+        return (quint64(value) << 1) ^ quint64(value >> 63);
+    }
+
+    qint64 unzigzag(quint64 value)
+    {
+        return qint64(value >> 1) ^ -qint64(value & 1);
+    }
+
+    QMutex s_mutex;
+    QFile s_file;
+    BinaryLogEncoder s_encoder;
+    QByteArray s_buffer;
+    std::atomic<bool> s_open { false };
+}
+
+QString BinaryLog::levelName(int level)
+{
+    switch (level) {
+    case LogLevel::Trace: return "Trace";
+    case LogLevel::Debug: return "Debug";
+    case LogLevel::Info: return "Info";
+    case LogLevel::Warning: return "Warning";
+    case LogLevel::Error: return "Error";
+    }
+    return QString("Level%1").arg(level);
+}
+
+quint32 BinaryLogEncoder::intern(const QByteArray &value, QByteArray &out)
+{
+    auto it = m_ids.constFind(value);
+    if (it != m_ids.constEnd()) {
+        return it.value();
+    }
+
+    const quint32 id = m_ids.size();
+    // The key may be raw data pointing at a caller's buffer, keep a copy.
+    m_ids.insert(QByteArray(value.constData(), value.size()), id);
+
+    out.append(char(BinaryLog::Define));
+    writeVarint(id, out);
+    writeString(value, out);
+    return id;
+}
+
+void BinaryLogEncoder::encode(qint64 timestamp, int level, const QString &category,
+                              const QList<BinaryLog::Arg> &args, QByteArray &out)
+{
+    const quint32 categoryId = intern(category.toUtf8(), out);
+
+    // Literals first, their definitions must precede the record.
+    QList<quint32> literalIds;
+    for (const BinaryLog::Arg &arg : args) {
+        if (arg.type == BinaryLog::Literal && m_ids.size() < MAX_INTERNED) {
+            literalIds.append(intern(QByteArray::fromRawData(arg.literal, qstrlen(arg.literal)), out));
+        }
+    }
+
+    out.append(char(BinaryLog::Record));
+    writeVarint(zigzag(timestamp - m_lastTimestamp), out);
+    m_lastTimestamp = timestamp;
+    out.append(char(level));
+    writeVarint(categoryId, out);
+    writeVarint(args.size(), out);
+
+    int literal = 0;
+    for (const BinaryLog::Arg &arg : args) {
+        switch (arg.type) {
+        case BinaryLog::Literal:
+            if (literal < literalIds.size()) {
+                out.append(char(BinaryLog::Literal));
+                writeVarint(literalIds.at(literal++), out);
+            } else {
+                out.append(char(BinaryLog::Text));
+                writeString(QByteArray(arg.literal), out);
+            }
+            break;
+        case BinaryLog::Text:
+            out.append(char(BinaryLog::Text));
+            writeString(arg.text.toUtf8(), out);
+            break;
+        case BinaryLog::Unsigned:
+        case BinaryLog::Pointer:
+            out.append(char(arg.type));
+            writeVarint(arg.number, out);
+            break;
+        }
+    }
+}
+
+void BinaryLogEncoder::reset(QByteArray &out)
+{
+    m_ids.clear();
+    m_lastTimestamp = 0;
+    out.append(char(BinaryLog::Reset));
+}
+
+BinaryLogDecoder::BinaryLogDecoder(QIODevice *device) : m_device(device)
+{
+}
+
+bool BinaryLogDecoder::readHeader()
+{
+    const QByteArray magic = m_device->read(BinaryLog::MAGIC_SIZE);
+    if (magic != QByteArray(BinaryLog::MAGIC, BinaryLog::MAGIC_SIZE)) {
+        m_error = "not a binary log";
+        return false;
+    }
+    return true;
+}
+
+bool BinaryLogDecoder::readByte(quint8 &value)
+{
+    char c;
+    if (!m_device->getChar(&c)) {
+        return false;
+    }
+    value = quint8(c);
+    return true;
+}
+
+bool BinaryLogDecoder::readVarint(quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        quint8 byte;
+        if (!readByte(byte)) {
+            m_error = "truncated varint";
+            return false;
+        }
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    m_error = "varint too long";
+    return false;
+}
+
+bool BinaryLogDecoder::readString(QString &value)
+{
+    quint64 size;
+    if (!readVarint(size)) {
+        return false;
+    }
+    if (size > MAX_STRING_SIZE) {
+        m_error = "string too long";
+        return false;
+    }
+    const QByteArray data = m_device->read(qint64(size));
+    if (quint64(data.size()) != size) {
+        m_error = "truncated string";
+        return false;
+    }
+    value = QString::fromUtf8(data);
+    return true;
+}
+
+bool BinaryLogDecoder::readArg(QString &text)
+{
+    quint8 type;
+    if (!readByte(type)) {
+        m_error = "truncated record";
+        return false;
+    }
+
+    quint64 number;
+    switch (type) {
+    case BinaryLog::Literal:
+        if (!readVarint(number)) {
+            return false;
+        }
+        if (!m_strings.contains(quint32(number))) {
+            m_error = QString("undefined string id %1").arg(number);
+            return false;
+        }
+        text = m_strings.value(quint32(number));
+        return true;
+    case BinaryLog::Text:
+        return readString(text);
+    case BinaryLog::Unsigned:
+        if (!readVarint(number)) {
+            return false;
+        }
+        text = QString::number(number);
+        return true;
+    case BinaryLog::Pointer:
+        if (!readVarint(number)) {
+            return false;
+        }
+        text = "0x" + QString::number(number, 16);
+        return true;
+    }
+
+    m_error = QString("unknown argument type %1").arg(int(type));
+    return false;
+}
+
+bool BinaryLogDecoder::next(BinaryLog::Entry &entry)
+{
+    for (;;) {
+        quint8 tag;
+        if (!readByte(tag)) {
+            return false;
+        }
+
+        switch (tag) {
+        case BinaryLog::Define: {
+            quint64 id;
+            QString value;
+            if (!readVarint(id) || !readString(value)) {
+                return false;
+            }
+            m_strings.insert(quint32(id), value);
+            break;
+        }
+        case BinaryLog::Reset:
+            m_strings.clear();
+            m_lastTimestamp = 0;
+            break;
+        case BinaryLog::Record: {
+            quint64 delta;
+            quint8 level;
+            quint64 category;
+            quint64 count;
+            if (!readVarint(delta) || !readByte(level) || !readVarint(category) || !readVarint(count)) {
+                return false;
+            }
+
+            m_lastTimestamp += unzigzag(delta);
+            entry.timestamp = m_lastTimestamp;
+            entry.level = level;
+            entry.category = m_strings.value(quint32(category));
+
+            // Same rendering as the text log: arguments separated by spaces.
+            QStringList parts;
+            for (quint64 i = 0; i < count; ++i) {
+                QString text;
+                if (!readArg(text)) {
+                    return false;
+                }
+                parts.append(text);
+            }
+            entry.message = parts.join(' ').trimmed();
+            return true;
+        }
+        default:
+            m_error = QString("unknown tag %1").arg(int(tag));
+            return false;
+        }
+    }
+}
+
+QString BinaryLogSink::fileNameFor(const QString &textLogFileName)
+{
+    const QFileInfo info(textLogFileName);
+    return info.dir().filePath(info.completeBaseName() + ".blog");
+}
+
+bool BinaryLogSink::openIfEnabled(const QString &textLogFileName)
+{
+    if (!qEnvironmentVariableIsSet(BinaryLog::ENABLE_VARIABLE)) {
+        return false;
+    }
+    return open(fileNameFor(textLogFileName));
+}
+
+bool BinaryLogSink::open(const QString &fileName)
+{
+    QMutexLocker locker(&s_mutex);
+    if (s_file.isOpen()) {
+        return true;
+    }
+
+    s_file.setFileName(fileName);
+    if (!s_file.open(QIODevice::Append)) {
+        return false;
+    }
+
+    s_encoder = BinaryLogEncoder();
+    s_buffer.clear();
+    if (s_file.size() == 0) {
+        s_buffer.append(BinaryLog::MAGIC, BinaryLog::MAGIC_SIZE);
+    } else {
+        s_encoder.reset(s_buffer);
+    }
+    s_file.write(s_buffer);
+
+    s_open.store(true, std::memory_order_release);
+    return true;
+}
+
+void BinaryLogSink::close()
+{
+    QMutexLocker locker(&s_mutex);
+    s_open.store(false, std::memory_order_release);
+    s_file.close();
+}
+
+bool BinaryLogSink::isOpen()
+{
+    return s_open.load(std::memory_order_acquire);
+}
+
+void BinaryLogSink::flush()
+{
+    QMutexLocker locker(&s_mutex);
+    s_file.flush();
+}
+
+void BinaryLogSink::write(int level, const QString &category, const QList<BinaryLog::Arg> &args)
+{
+    const qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+
+    QMutexLocker locker(&s_mutex);
+    if (!s_file.isOpen()) {
+        return;
+    }
+
+    s_buffer.clear();
+    s_encoder.encode(timestamp, level, category, args, s_buffer);
+    s_file.write(s_buffer);
+
+    // QFile buffers the rest, errors should survive a crash right after.
+    if (level >= LogLevel::Warning) {
+        s_file.flush();
+    }
+}
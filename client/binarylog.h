@@ -0,0 +1,122 @@
+#ifndef BINARYLOG_H
+#define BINARYLOG_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+class QIODevice;
+
+// Compact binary encoding of Logger::Log records, an alternative to the text
+// log. A record keeps the streamed arguments typed: literal strings and
+// category names are written once and referenced by id afterwards, numbers
+// as varints, timestamps as deltas to the previous record.
+//
+// The stream starts with MAGIC followed by entries, each tagged by one byte:
+//   Define: varint id, varint length, utf-8 bytes
+//   Record: zigzag varint timestamp delta (ms), level byte, varint category
+//           id, varint argument count, arguments
+//   Reset:  forget all ids, written when appending to an existing file
+// An argument is a type byte followed by a varint id (Literal), a varint
+// length and utf-8 bytes (Text) or a varint (Unsigned, Pointer).
+namespace BinaryLog
+{
+    constexpr char MAGIC[] = "AMNBLOG1";
+    constexpr int MAGIC_SIZE = sizeof(MAGIC) - 1;
+
+    // Setting this environment variable routes Logger::Log records into a
+    // binary file next to the text log.
+    constexpr char ENABLE_VARIABLE[] = "AMNEZIA_BINARY_LOG";
+
+    enum Tag : quint8 {
+        Define = 1,
+        Record = 2,
+        Reset = 3,
+    };
+
+    enum ArgType : quint8 {
+        Literal = 1,
+        Text = 2,
+        Unsigned = 3,
+        Pointer = 4,
+    };
+
+    struct Arg
+    {
+        ArgType type;
+        quint64 number = 0;
+        // A string literal, never freed.
+        const char *literal = nullptr;
+        QString text;
+    };
+
+    struct Entry
+    {
+        qint64 timestamp = 0;
+        int level = 0;
+        QString category;
+        QString message;
+    };
+
+    QString levelName(int level);
+}
+
+class BinaryLogEncoder
+{
+public:
+    // Appends the encoded record, and the definitions it needs, to out.
+    void encode(qint64 timestamp, int level, const QString &category, const QList<BinaryLog::Arg> &args,
+                QByteArray &out);
+    // Forgets all ids, for a stream appended to an existing file.
+    void reset(QByteArray &out);
+
+private:
+    quint32 intern(const QByteArray &value, QByteArray &out);
+
+    QHash<QByteArray, quint32> m_ids;
+    qint64 m_lastTimestamp = 0;
+};
+
+class BinaryLogDecoder
+{
+public:
+    explicit BinaryLogDecoder(QIODevice *device);
+
+    // False if the device doesn't start with the magic.
+    bool readHeader();
+    // Reads the next record, false at the end of the stream or on corrupt
+    // input, see error().
+    bool next(BinaryLog::Entry &entry);
+    QString error() const { return m_error; }
+
+private:
+    bool readByte(quint8 &value);
+    bool readVarint(quint64 &value);
+    bool readString(QString &value);
+    bool readArg(QString &text);
+
+    QIODevice *m_device;
+    QHash<quint32, QString> m_strings;
+    qint64 m_lastTimestamp = 0;
+    QString m_error;
+};
+
+// Process wide binary sink used by Logger::Log when enabled.
+class BinaryLogSink
+{
+public:
+    // <name>.blog for the text log <name>.log.
+    static QString fileNameFor(const QString &textLogFileName);
+    // Opens the sink for the text log if ENABLE_VARIABLE is set.
+    static bool openIfEnabled(const QString &textLogFileName);
+
+    static bool open(const QString &fileName);
+    static void close();
+    static bool isOpen();
+    static void flush();
+
+    static void write(int level, const QString &category, const QList<BinaryLog::Arg> &args);
+};
+
+#endif // BINARYLOG_H
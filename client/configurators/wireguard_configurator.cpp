@@ -14,6 +14,7 @@
 
 #include "containers/containers_defs.h"
 #include "core/controllers/serverController.h"
+#include "core/ipAddressPool.h"
 #include "core/scripts_registry.h"
 #include "core/server_defs.h"
 #include "settings.h"
@@ -76,49 +77,33 @@ WireguardConfigurator::ConnectionData WireguardConfigurator::prepareWireguardCon
         return connData;
     }
 
-    // Get list of already created clients (only IP addresses)
-    QString nextIpNumber;
+    // Read the server config once and take the lowest address no peer uses
+    IpAddressPool pool;
     {
-        QString script = QString("cat %1 | grep AllowedIPs").arg(m_serverConfigPath);
-        QString stdOut;
-        auto cbReadStdOut = [&](const QString &data, libssh::Client &) {
-            stdOut += data + "\n";
-            return ErrorCode::NoError;
-        };
-
-        errorCode = m_serverController->runContainerScript(credentials, container, script, cbReadStdOut);
+        const QByteArray serverConfig =
+                m_serverController->getTextFileFromContainer(container, credentials, m_serverConfigPath, errorCode);
         if (errorCode != ErrorCode::NoError) {
             return connData;
         }
 
-        stdOut.replace("AllowedIPs = ", "");
-        stdOut.replace("/32", "");
-        QStringList ips = stdOut.split("\n", Qt::SkipEmptyParts);
-
-        // Calc next IP address
-        if (ips.isEmpty()) {
-            nextIpNumber = "2";
-        } else {
-            int next = ips.last().split(".").last().toInt() + 1;
-            if (next > 254) {
-                errorCode = ErrorCode::AddressPoolError;
-                return connData;
-            }
-            nextIpNumber = QString::number(next);
-        }
-    }
+        // The same subnet the server was configured with, see genVarsForScript
+        const QJsonObject subnetConfig = containerConfig.value(ProtocolProps::protoToString(Proto::WireGuard)).toObject();
+        const QString subnetIp = subnetConfig.value(config_key::subnet_address).toString(protocols::wireguard::defaultSubnetAddress);
+        const int subnetCidr = subnetConfig.value(config_key::subnet_cidr).toString(protocols::wireguard::defaultSubnetCidr).toInt();
 
-    QString subnetIp = containerConfig.value(config_key::subnet_address).toString(protocols::wireguard::defaultSubnetAddress);
-    {
-        QStringList l = subnetIp.split(".", Qt::SkipEmptyParts);
-        if (l.isEmpty()) {
+        pool = IpAddressPool(QHostAddress(subnetIp), subnetCidr);
+        if (!pool.isValid()) {
             errorCode = ErrorCode::AddressPoolError;
             return connData;
         }
-        l.removeLast();
-        l.append(nextIpNumber);
+        pool.reserveWireguardConfig(QString::fromUtf8(serverConfig));
 
-        connData.clientIP = l.join(".");
+        const QHostAddress clientIp = pool.allocate();
+        if (clientIp.isNull()) {
+            errorCode = ErrorCode::AddressPoolError;
+            return connData;
+        }
+        connData.clientIP = clientIp.toString();
     }
 
     // Get keys
@@ -0,0 +1,348 @@
+#include "provisioningScheduler.h"
+
+#include <QRandomGenerator>
+#include <QSet>
+#include <QThread>
+#include <QTimer>
+
+#include "logger.h"
+#include "serverController.h"
+
+namespace
+{
+    Logger logger("ProvisioningScheduler");
+}
+
+ProvisioningScheduler::ProvisioningScheduler(std::shared_ptr<Settings> settings, QObject *parent)
+    : QObject(parent), m_settings(settings)
+{
+}
+
+ProvisioningScheduler::~ProvisioningScheduler()
+{
+    // Running jobs are asked to stop and finish in their threads, their
+    // results are dropped together with the connection to this object. Their
+    // sessions are released once they are done, see closeSession().
+    for (const std::shared_ptr<Session> &session : std::as_const(m_sessions)) {
+        if (session->runningJob != -1) {
+            QMetaObject::invokeMethod(
+                    session->worker,
+                    [session]() {
+                        if (session->controller) {
+                            session->controller->cancelInstallation();
+                        }
+                    },
+                    Qt::QueuedConnection);
+        }
+    }
+
+    const QStringList hosts = m_sessions.keys();
+    for (const QString &host : hosts) {
+        closeSession(host);
+    }
+}
+
+void ProvisioningScheduler::setMaxConcurrent(int maxConcurrent)
+{
+    m_maxConcurrent = qMax(1, maxConcurrent);
+    dispatch();
+}
+
+void ProvisioningScheduler::setMaxAttempts(int maxAttempts)
+{
+    m_maxAttempts = qMax(1, maxAttempts);
+}
+
+int ProvisioningScheduler::setupContainer(const ServerCredentials &credentials, DockerContainer container, const QJsonObject &config)
+{
+    Job job;
+    job.operation = Setup;
+    job.credentials = credentials;
+    job.container = container;
+    job.config = config;
+    return enqueue(job);
+}
+
+int ProvisioningScheduler::updateContainer(const ServerCredentials &credentials, DockerContainer container,
+                                           const QJsonObject &oldConfig, const QJsonObject &newConfig)
+{
+    Job job;
+    job.operation = Update;
+    job.credentials = credentials;
+    job.container = container;
+    job.oldConfig = oldConfig;
+    job.config = newConfig;
+    return enqueue(job);
+}
+
+int ProvisioningScheduler::removeContainer(const ServerCredentials &credentials, DockerContainer container)
+{
+    Job job;
+    job.operation = Remove;
+    job.credentials = credentials;
+    job.container = container;
+    return enqueue(job);
+}
+
+void ProvisioningScheduler::cancel(int jobId)
+{
+    auto it = m_jobs.find(jobId);
+    if (it == m_jobs.end()) {
+        return;
+    }
+
+    if (it->state == Running) {
+        if (!it->cancelled) {
+            it->cancelled = true;
+            const std::shared_ptr<Session> session = m_sessions.value(it->host);
+            // Runs in the nested event loop the controller waits in.
+            QMetaObject::invokeMethod(
+                    session->worker,
+                    [session]() {
+                        if (session->controller) {
+                            session->controller->cancelInstallation();
+                        }
+                    },
+                    Qt::QueuedConnection);
+        }
+        return;
+    }
+
+    m_queue.removeOne(jobId);
+    finish(jobId, ErrorCode::ServerCancelInstallation, QJsonObject());
+    dispatch();
+}
+
+void ProvisioningScheduler::cancelAll()
+{
+    const QList<int> jobIds = m_jobs.keys();
+    for (int jobId : jobIds) {
+        cancel(jobId);
+    }
+}
+
+int ProvisioningScheduler::pendingCount() const
+{
+    return m_jobs.size();
+}
+
+int ProvisioningScheduler::enqueue(Job job)
+{
+    const int jobId = m_nextJobId++;
+    job.host = hostKey(job.credentials);
+    m_jobs.insert(jobId, job);
+    m_queue.append(jobId);
+
+    ++m_total;
+    emit progressChanged(m_finished, m_total);
+
+    // Later, so the caller gets the id before jobStarted.
+    QTimer::singleShot(0, this, &ProvisioningScheduler::dispatch);
+    return jobId;
+}
+
+void ProvisioningScheduler::dispatch()
+{
+    // A host with a running job or one waiting for a retry takes nothing
+    // else, so jobs for one host keep their order.
+    QSet<QString> busyHosts;
+    for (const Job &job : std::as_const(m_jobs)) {
+        if (job.state != Queued) {
+            busyHosts.insert(job.host);
+        }
+    }
+
+    for (int i = 0; i < m_queue.size() && m_running < m_maxConcurrent;) {
+        const int jobId = m_queue.at(i);
+        const QString host = m_jobs.value(jobId).host;
+        if (busyHosts.contains(host)) {
+            ++i;
+            continue;
+        }
+
+        busyHosts.insert(host);
+        m_queue.removeAt(i);
+        start(jobId);
+    }
+}
+
+void ProvisioningScheduler::start(int jobId)
+{
+    Job &job = m_jobs[jobId];
+    job.state = Running;
+    ++job.attempt;
+    ++m_running;
+
+    const std::shared_ptr<Session> session = this->session(job.host);
+    session->idleTimer->stop();
+    session->runningJob = jobId;
+
+    emit jobStarted(jobId, job.attempt);
+
+    QMetaObject::invokeMethod(
+            session->worker,
+            [session, jobId, job, settings = m_settings]() {
+                session->busy = true;
+                if (!session->controller) {
+                    session->controller = new ServerController(settings);
+                }
+                // A cancel for this job is queued behind this call, one for
+                // an earlier job ran before it.
+                session->controller->resetCancellation();
+
+                QJsonObject config = job.config;
+                ErrorCode errorCode = ErrorCode::NoError;
+                switch (job.operation) {
+                case Setup: errorCode = session->controller->setupContainer(job.credentials, job.container, config); break;
+                case Update:
+                    errorCode = session->controller->updateContainer(job.credentials, job.container, job.oldConfig, config);
+                    break;
+                case Remove: errorCode = session->controller->removeContainer(job.credentials, job.container); break;
+                }
+
+                session->busy = false;
+                emit session->worker->jobFinished(jobId, errorCode, config);
+                if (session->closing) {
+                    releaseSession(session);
+                }
+            },
+            Qt::QueuedConnection);
+}
+
+void ProvisioningScheduler::onJobFinished(int jobId, ErrorCode errorCode, const QJsonObject &config)
+{
+    auto it = m_jobs.find(jobId);
+    if (it == m_jobs.end()) {
+        return;
+    }
+
+    --m_running;
+    if (const std::shared_ptr<Session> session = m_sessions.value(it->host)) {
+        session->runningJob = -1;
+        session->idleTimer->start();
+    }
+
+    if (it->cancelled && errorCode != ErrorCode::NoError) {
+        errorCode = ErrorCode::ServerCancelInstallation;
+    }
+
+    if (!it->cancelled && isRetryable(errorCode) && it->attempt < m_maxAttempts) {
+        int delayMsec = qMin(RETRY_BASE_DELAY_MSEC << qMin(it->attempt - 1, 16), RETRY_MAX_DELAY_MSEC);
+        // Jitter, so hosts failing together don't come back together.
+        delayMsec += QRandomGenerator::global()->bounded(delayMsec / 4 + 1);
+
+        logger.warning() << "Job" << jobId << "on" << it->host << "failed with" << static_cast<int>(errorCode)
+                         << "attempt" << it->attempt << "retrying in" << delayMsec << "ms";
+
+        it->state = Waiting;
+        emit jobRetrying(jobId, errorCode, delayMsec);
+
+        QTimer::singleShot(delayMsec, this, [this, jobId]() {
+            auto it = m_jobs.find(jobId);
+            if (it == m_jobs.end() || it->state != Waiting) {
+                return;
+            }
+            it->state = Queued;
+            m_queue.prepend(jobId);
+            dispatch();
+        });
+    } else {
+        finish(jobId, errorCode, config);
+    }
+
+    dispatch();
+}
+
+void ProvisioningScheduler::finish(int jobId, ErrorCode errorCode, const QJsonObject &config)
+{
+    m_jobs.remove(jobId);
+    ++m_finished;
+
+    emit jobFinished(jobId, errorCode, config);
+    emit progressChanged(m_finished, m_total);
+
+    if (m_jobs.isEmpty()) {
+        m_finished = 0;
+        m_total = 0;
+        emit idle();
+    }
+}
+
+std::shared_ptr<ProvisioningScheduler::Session> ProvisioningScheduler::session(const QString &host)
+{
+    std::shared_ptr<Session> session = m_sessions.value(host);
+    if (session) {
+        return session;
+    }
+
+    session = std::make_shared<Session>();
+
+    session->thread = new QThread();
+    session->thread->setObjectName("Provisioning " + host);
+    session->worker = new ProvisioningWorker();
+    session->worker->moveToThread(session->thread);
+    connect(session->worker, &ProvisioningWorker::jobFinished, this, &ProvisioningScheduler::onJobFinished);
+    connect(session->thread, &QThread::finished, session->worker, &QObject::deleteLater);
+    connect(session->thread, &QThread::finished, session->thread, &QObject::deleteLater);
+    session->thread->start();
+
+    session->idleTimer = new QTimer(this);
+    session->idleTimer->setSingleShot(true);
+    session->idleTimer->setInterval(SESSION_IDLE_MSEC);
+    connect(session->idleTimer, &QTimer::timeout, this, [this, host]() { closeSession(host); });
+
+    m_sessions.insert(host, session);
+    return session;
+}
+
+void ProvisioningScheduler::closeSession(const QString &host)
+{
+    const std::shared_ptr<Session> session = m_sessions.take(host);
+    if (!session) {
+        return;
+    }
+
+    delete session->idleTimer;
+    session->idleTimer = nullptr;
+
+    // A running job waits for SSH in a nested event loop, which runs this
+    // too. Its controller must not go away under it, so a busy session is
+    // only marked and released by the job when it returns.
+    QMetaObject::invokeMethod(
+            session->worker,
+            [session]() {
+                if (session->busy) {
+                    session->closing = true;
+                } else {
+                    releaseSession(session);
+                }
+            },
+            Qt::QueuedConnection);
+}
+
+// static
+void ProvisioningScheduler::releaseSession(const std::shared_ptr<Session> &session)
+{
+    delete session->controller;
+    session->controller = nullptr;
+    QThread::currentThread()->quit();
+}
+
+// static
+QString ProvisioningScheduler::hostKey(const ServerCredentials &credentials)
+{
+    return QString("%1@%2:%3").arg(credentials.userName, credentials.hostName).arg(credentials.port);
+}
+
+// static
+bool ProvisioningScheduler::isRetryable(ErrorCode errorCode)
+{
+    switch (errorCode) {
+    case ErrorCode::SshTimeoutError:
+    case ErrorCode::SshInterruptedError:
+    case ErrorCode::SshInternalError:
+    case ErrorCode::SshScpFailureError:
+    case ErrorCode::ServerPacketManagerError: return true;
+    default: return false;
+    }
+}
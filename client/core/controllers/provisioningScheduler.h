@@ -0,0 +1,149 @@
+#ifndef PROVISIONINGSCHEDULER_H
+#define PROVISIONINGSCHEDULER_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+
+#include <memory>
+
+#include "containers/containers_defs.h"
+#include "core/defs.h"
+
+class QThread;
+class QTimer;
+class ServerController;
+class Settings;
+
+using namespace amnezia;
+
+// Lives in a host session's thread and reports job results back to the
+// scheduler. A signal rather than a direct call, so results of jobs still
+// running when the scheduler goes away are dropped.
+class ProvisioningWorker : public QObject
+{
+    Q_OBJECT
+signals:
+    void jobFinished(int jobId, ErrorCode errorCode, const QJsonObject &config);
+};
+
+// Runs container setup, update and removal on many servers at once.
+//
+// Every host gets a session: a thread with its own ServerController, so the
+// SSH connection is reused by all jobs for that host. Jobs for one host run
+// in the order they were queued, at most maxConcurrent hosts are busy at a
+// time. Jobs failing with a connection error are retried with exponential
+// backoff, sessions are closed after they've been idle for a while.
+class ProvisioningScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int DEFAULT_MAX_CONCURRENT = 4;
+    static constexpr int DEFAULT_MAX_ATTEMPTS = 3;
+    static constexpr int RETRY_BASE_DELAY_MSEC = 2000;
+    static constexpr int RETRY_MAX_DELAY_MSEC = 60000;
+    static constexpr int SESSION_IDLE_MSEC = 60000;
+
+    enum Operation {
+        Setup,
+        Update,
+        Remove
+    };
+
+    explicit ProvisioningScheduler(std::shared_ptr<Settings> settings, QObject *parent = nullptr);
+    ~ProvisioningScheduler();
+
+    void setMaxConcurrent(int maxConcurrent);
+    void setMaxAttempts(int maxAttempts);
+
+    // Queue a job and return its id. config is the container config, for
+    // Update the new one.
+    int setupContainer(const ServerCredentials &credentials, DockerContainer container, const QJsonObject &config);
+    int updateContainer(const ServerCredentials &credentials, DockerContainer container, const QJsonObject &oldConfig,
+                        const QJsonObject &newConfig);
+    int removeContainer(const ServerCredentials &credentials, DockerContainer container);
+
+    // A queued job is dropped, a running one is asked to stop at its next
+    // cancellation point. Either way it finishes with ServerCancelInstallation,
+    // unless a running job manages to complete first.
+    void cancel(int jobId);
+    void cancelAll();
+
+    // Jobs queued, waiting for a retry or running.
+    int pendingCount() const;
+
+signals:
+    void jobStarted(int jobId, int attempt);
+    void jobRetrying(int jobId, ErrorCode errorCode, int delayMsec);
+    void jobFinished(int jobId, ErrorCode errorCode, const QJsonObject &config);
+    // finished of total jobs queued since the scheduler was last idle.
+    void progressChanged(int finished, int total);
+    void idle();
+
+private:
+    enum State {
+        Queued,
+        Waiting,
+        Running
+    };
+
+    struct Job
+    {
+        Operation operation = Setup;
+        ServerCredentials credentials;
+        DockerContainer container = DockerContainer::None;
+        QJsonObject oldConfig;
+        QJsonObject config;
+
+        QString host;
+        State state = Queued;
+        int attempt = 0;
+        bool cancelled = false;
+    };
+
+    struct Session
+    {
+        QThread *thread = nullptr;
+        ProvisioningWorker *worker = nullptr;
+        QTimer *idleTimer = nullptr;
+        // Created and used in the session's thread only.
+        ServerController *controller = nullptr;
+        // Set in the session's thread only: a job is on its stack, and the
+        // session was closed meanwhile.
+        bool busy = false;
+        bool closing = false;
+        int runningJob = -1;
+    };
+
+    int enqueue(Job job);
+    void dispatch();
+    void start(int jobId);
+    void onJobFinished(int jobId, ErrorCode errorCode, const QJsonObject &config);
+    void finish(int jobId, ErrorCode errorCode, const QJsonObject &config);
+
+    std::shared_ptr<Session> session(const QString &host);
+    void closeSession(const QString &host);
+    // In the session's thread.
+    static void releaseSession(const std::shared_ptr<Session> &session);
+
+    static QString hostKey(const ServerCredentials &credentials);
+    static bool isRetryable(ErrorCode errorCode);
+
+    std::shared_ptr<Settings> m_settings;
+
+    int m_maxConcurrent = DEFAULT_MAX_CONCURRENT;
+    int m_maxAttempts = DEFAULT_MAX_ATTEMPTS;
+
+    QHash<int, Job> m_jobs;
+    // Ids of jobs ready to run, in submission order.
+    QList<int> m_queue;
+    QHash<QString, std::shared_ptr<Session>> m_sessions;
+    int m_running = 0;
+    int m_nextJobId = 1;
+
+    int m_finished = 0;
+    int m_total = 0;
+};
+
+#endif // PROVISIONINGSCHEDULER_H
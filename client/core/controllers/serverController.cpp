@@ -34,6 +34,10 @@
 namespace
 {
     Logger logger("ServerController");
+
+    // Printed by batched scripts before each command, followed by a per run
+    // nonce and the index of the command.
+    constexpr char SCRIPT_COMMAND_MARKER[] = "<<amnezia-command:";
 }
 
 ServerController::ServerController(std::shared_ptr<Settings> settings, QObject *parent) : m_settings(settings)
@@ -55,44 +59,143 @@ ErrorCode ServerController::runScript(const ServerCredentials &credentials, QStr
         return error;
     }
 
-    script.replace("\r", "");
-
     qDebug() << "ServerController::Run script";
 
+    const QStringList commands = scriptCommands(script);
+
+    // A single channel for the whole script instead of one per command, unless
+    // the script can't be uploaded to the host.
+    if (commands.size() > 1) {
+        bool uploaded = false;
+        error = runScriptBatch(credentials, commands, uploaded, cbReadStdOut, cbReadStdErr);
+        if (uploaded) {
+            qDebug().noquote() << "ServerController::runScript finished\n";
+            return error;
+        }
+        qDebug() << "ServerController::runScript failed to upload the script, running it line by line";
+    }
+
+    for (const QString &command : commands) {
+        qDebug().noquote() << command;
+        Logger::appendSshLog("Run command:" + command);
+
+        error = m_sshClient.executeCommand(command, cbReadStdOut, cbReadStdErr);
+        if (error != ErrorCode::NoError) {
+            return error;
+        }
+    }
+
+    qDebug().noquote() << "ServerController::runScript finished\n";
+    return ErrorCode::NoError;
+}
+
+QStringList ServerController::scriptCommands(QString script)
+{
+    script.replace("\r", "");
+
+    QStringList commands;
     QString totalLine;
     const QStringList &lines = script.split("\n", Qt::SkipEmptyParts);
-    for (int i = 0; i < lines.count(); i++) {
-        QString currentLine = lines.at(i);
-
+    for (const QString &currentLine : lines) {
         if (totalLine.isEmpty()) {
             totalLine = currentLine;
         } else {
             totalLine = totalLine + "\n" + currentLine;
         }
 
-        QString lineToExec;
         if (currentLine.endsWith("\\")) {
             continue;
-        } else {
-            lineToExec = totalLine;
-            totalLine.clear();
         }
 
-        if (lineToExec.startsWith("#")) {
-            continue;
+        if (!totalLine.startsWith("#")) {
+            commands.append(totalLine);
         }
+        totalLine.clear();
+    }
+    return commands;
+}
 
-        qDebug().noquote() << lineToExec;
-        Logger::appendSshLog("Run command:" + lineToExec);
+// The commands are uploaded as one shell script and run over a single channel.
+// Each command runs in its own subshell, so cd, exit or variables don't leak
+// into the next one, the same as with a channel per command. Before each
+// command the script prints a marker with its index, the output is split at
+// the markers so the callbacks see the output of one command at a time.
+ErrorCode ServerController::runScriptBatch(const ServerCredentials &credentials, const QStringList &commands, bool &uploaded,
+                                           const std::function<ErrorCode(const QString &, libssh::Client &)> &cbReadStdOut,
+                                           const std::function<ErrorCode(const QString &, libssh::Client &)> &cbReadStdErr)
+{
+    const QString nonce = Utils::getRandomString(16);
+    const QString marker = QString("\n%1%2:").arg(SCRIPT_COMMAND_MARKER, nonce);
+    const QString remotePath = QString("/tmp/amnezia-%1.sh").arg(nonce);
+
+    // bash keeps the file open, it can go away right after the start.
+    QString batch = "rm -f -- \"$0\"\n";
+    for (int i = 0; i < commands.size(); ++i) {
+        batch += QString("printf '\\n%1%2:%d\\n' %3\n(\n%4\n)\n").arg(SCRIPT_COMMAND_MARKER, nonce, QString::number(i), commands.at(i));
+    }
 
-        error = m_sshClient.executeCommand(lineToExec, cbReadStdOut, cbReadStdErr);
-        if (error != ErrorCode::NoError) {
-            return error;
-        }
+    uploaded = uploadFileToHost(credentials, batch.toUtf8(), remotePath) == ErrorCode::NoError;
+    if (!uploaded) {
+        return ErrorCode::NoError;
     }
 
-    qDebug().noquote() << "ServerController::runScript finished\n";
-    return ErrorCode::NoError;
+    QString pending;
+    const auto forwardStdOut = [&](bool atEnd) {
+        for (;;) {
+            const int markerPos = pending.indexOf(marker);
+            int lineEnd = -1;
+            if (markerPos >= 0) {
+                lineEnd = pending.indexOf('\n', markerPos + marker.size());
+            }
+
+            QString data;
+            if (lineEnd >= 0) {
+                data = pending.left(markerPos);
+            } else if (atEnd) {
+                data = pending;
+            } else {
+                // Hold back the start of a marker split between two reads.
+                int keep = markerPos >= 0 ? pending.size() - markerPos : 0;
+                for (int i = qMin(marker.size() - 1, pending.size()); i > keep; --i) {
+                    if (pending.endsWith(QStringView(marker).left(i))) {
+                        keep = i;
+                        break;
+                    }
+                }
+                data = pending.left(pending.size() - keep);
+            }
+
+            pending.remove(0, data.size());
+            if (!data.isEmpty() && cbReadStdOut) {
+                const ErrorCode error = cbReadStdOut(data, m_sshClient);
+                if (error != ErrorCode::NoError) {
+                    return error;
+                }
+            }
+            if (lineEnd < 0) {
+                return ErrorCode::NoError;
+            }
+
+            const int index = QStringView(pending).mid(marker.size(), lineEnd - markerPos - marker.size()).toInt();
+            pending.remove(0, lineEnd - markerPos + 1);
+            if (index >= 0 && index < commands.size()) {
+                qDebug().noquote() << commands.at(index);
+                Logger::appendSshLog("Run command:" + commands.at(index));
+            }
+        }
+    };
+
+    const auto cbBatchStdOut = [&](const QString &data, libssh::Client &) {
+        pending += data;
+        return forwardStdOut(false);
+    };
+
+    const QString runner = QString("if command -v bash > /dev/null 2>&1; then bash %1; else sh %1; fi").arg(remotePath);
+    const ErrorCode error = m_sshClient.executeCommand(runner, cbBatchStdOut, cbReadStdErr);
+    if (error != ErrorCode::NoError) {
+        return error;
+    }
+    return forwardStdOut(true);
 }
 
 ErrorCode ServerController::runContainerScript(const ServerCredentials &credentials, DockerContainer container, QString script,
@@ -659,6 +762,11 @@ void ServerController::cancelInstallation()
     m_cancelInstallation = true;
 }
 
+void ServerController::resetCancellation()
+{
+    m_cancelInstallation = false;
+}
+
 ErrorCode ServerController::setupServerFirewall(const ServerCredentials &credentials)
 {
     return runScript(credentials, replaceVars(amnezia::scriptData(SharedScriptType::setup_host_firewall), genVarsForScript(credentials)));
@@ -773,7 +881,6 @@ ErrorCode ServerController::isUserInSudo(const ServerCredentials &credentials, D
 
 ErrorCode ServerController::isServerDpkgBusy(const ServerCredentials &credentials, DockerContainer container)
 {
-    m_cancelInstallation = false;
     QString stdOut;
     auto cbReadStdOut = [&](const QString &data, libssh::Client &) {
         stdOut += data + "\n";
@@ -4,6 +4,8 @@
 #include <QJsonObject>
 #include <QObject>
 
+#include <atomic>
+
 #include "containers/containers_defs.h"
 #include "core/defs.h"
 #include "core/sshclient.h"
@@ -52,12 +54,20 @@ public:
 
     QString checkSshConnection(const ServerCredentials &credentials, ErrorCode &errorCode);
 
+    // Stays cancelled until reset, a controller reused for another
+    // operation resets it first.
     void cancelInstallation();
+    void resetCancellation();
 
     ErrorCode getDecryptedPrivateKey(const ServerCredentials &credentials, QString &decryptedPrivateKey,
                                      const std::function<QString()> &callback);
 
 private:
+    static QStringList scriptCommands(QString script);
+    ErrorCode runScriptBatch(const ServerCredentials &credentials, const QStringList &commands, bool &uploaded,
+                             const std::function<ErrorCode(const QString &, libssh::Client &)> &cbReadStdOut,
+                             const std::function<ErrorCode(const QString &, libssh::Client &)> &cbReadStdErr);
+
     ErrorCode installDockerWorker(const ServerCredentials &credentials, DockerContainer container);
     ErrorCode prepareHostWorker(const ServerCredentials &credentials, DockerContainer container, const QJsonObject &config = QJsonObject());
     ErrorCode buildContainerWorker(const ServerCredentials &credentials, DockerContainer container,
@@ -78,7 +88,8 @@ private:
     std::shared_ptr<Settings> m_settings;
     std::shared_ptr<VpnConfigurator> m_configurator;
 
-    bool m_cancelInstallation = false;
+    // Also read by the busy check running in another thread.
+    std::atomic<bool> m_cancelInstallation { false };
     libssh::Client m_sshClient;
 signals:
     void serverIsBusy(const bool isBusy);
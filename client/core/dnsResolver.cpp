@@ -0,0 +1,193 @@
+#include "dnsResolver.h"
+
+#include <QDebug>
+#include <QtGlobal>
+
+#include <QHostInfo>
+#ifdef AMNEZIA_DESKTOP
+    #include <QDnsLookup>
+#endif
+
+namespace
+{
+    // Answers are kept at least this long even with a lower TTL, and at most
+    // the maximum, so a record with a huge TTL still gets refreshed.
+    constexpr qint64 MIN_TTL_SEC = 30;
+    constexpr qint64 MAX_TTL_SEC = 3600;
+    // Failed lookups are retried after this.
+    constexpr qint64 NEGATIVE_TTL_SEC = 30;
+    // QHostInfo doesn't report TTLs.
+    constexpr qint64 DEFAULT_TTL_SEC = 300;
+}
+
+DnsResolver::DnsResolver(QObject *parent) : QObject(parent)
+{
+    m_clock.start();
+}
+
+void DnsResolver::setNameserver(const QHostAddress &address, quint16 port)
+{
+    m_nameserver = address;
+    m_nameserverPort = port;
+}
+
+void DnsResolver::clearCache()
+{
+    m_cache.clear();
+}
+
+// static
+QString DnsResolver::cacheKey(const QString &hostname, Family family)
+{
+    return QString("%1:%2").arg(family == Ipv6 ? "AAAA" : "A", hostname);
+}
+
+void DnsResolver::resolve(const QStringList &hostnames, Families families, QObject *context,
+                          const std::function<void(const Result &)> &callback)
+{
+    auto batch = std::make_shared<Batch>();
+    batch->context = context;
+    batch->callback = callback;
+
+    QList<Family> wanted;
+    for (Family family : { Ipv4, Ipv6 }) {
+        if (families.testFlag(family)) {
+            wanted.append(family);
+        }
+    }
+
+    const qint64 now = m_clock.elapsed();
+    QList<QPair<QString, QList<QHostAddress>>> cached;
+
+    for (const QString &hostname : hostnames) {
+        batch->result.insert(hostname, {});
+
+        // Spellings of a name share its lookups.
+        const QString name = hostname.trimmed().toLower();
+        QStringList &spellings = batch->names[name];
+        if (spellings.contains(hostname)) {
+            continue;
+        }
+        spellings.append(hostname);
+        if (spellings.size() > 1) {
+            continue;
+        }
+
+        for (Family family : wanted) {
+            const QString key = cacheKey(name, family);
+
+            auto entry = m_cache.constFind(key);
+            if (entry != m_cache.constEnd() && entry->expires > now) {
+                cached.append({ name, entry->addresses });
+                continue;
+            }
+
+            ++batch->remaining;
+            auto query = m_queries.find(key);
+            if (query == m_queries.end()) {
+                query = m_queries.insert(key, { name, family, {} });
+                m_queue.enqueue(key);
+            }
+            query->batches.append(batch);
+        }
+    }
+
+    // Held until the cached answers are in, so they can't complete the batch
+    // while lookups are still outstanding.
+    ++batch->remaining;
+    for (const auto &answer : cached) {
+        ++batch->remaining;
+        deliver(batch, answer.first, answer.second);
+    }
+    deliver(batch, QString(), {});
+
+    startQueries();
+}
+
+void DnsResolver::startQueries()
+{
+    while (m_active < m_maxConcurrent && !m_queue.isEmpty()) {
+        ++m_active;
+        lookup(m_queue.dequeue());
+    }
+}
+
+void DnsResolver::lookup(const QString &key)
+{
+    const Query &query = m_queries[key];
+
+#ifdef AMNEZIA_DESKTOP
+    // Only an explicit nameserver is queried directly. The system resolver
+    // also consults /etc/hosts, nsswitch, mDNS and its own cache, which a
+    // plain DNS query skips.
+    if (!m_nameserver.isNull()) {
+        auto *dnsLookup = new QDnsLookup(query.family == Ipv6 ? QDnsLookup::AAAA : QDnsLookup::A, query.hostname,
+                                         m_nameserver, this);
+    #if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+        dnsLookup->setNameserverPort(m_nameserverPort);
+    #endif
+
+        connect(dnsLookup, &QDnsLookup::finished, this, [this, dnsLookup, key]() {
+            dnsLookup->deleteLater();
+
+            QList<QHostAddress> addresses;
+            qint64 ttl = MAX_TTL_SEC;
+            if (dnsLookup->error() == QDnsLookup::NoError) {
+                for (const QDnsHostAddressRecord &record : dnsLookup->hostAddressRecords()) {
+                    addresses.append(record.value());
+                    ttl = qMin<qint64>(ttl, record.timeToLive());
+                }
+            } else if (dnsLookup->error() != QDnsLookup::NotFoundError) {
+                qDebug() << "DnsResolver: lookup of" << dnsLookup->name() << "failed:" << dnsLookup->errorString();
+            }
+
+            finishQuery(key, addresses, addresses.isEmpty() ? NEGATIVE_TTL_SEC : qBound(MIN_TTL_SEC, ttl, MAX_TTL_SEC));
+        });
+        dnsLookup->lookup();
+        return;
+    }
+#endif
+
+    const Family family = query.family;
+    QHostInfo::lookupHost(query.hostname, this, [this, key, family](const QHostInfo &hostInfo) {
+        QList<QHostAddress> addresses;
+        for (const QHostAddress &address : hostInfo.addresses()) {
+            const bool ipv6 = address.protocol() == QAbstractSocket::IPv6Protocol;
+            if (ipv6 == (family == Ipv6)) {
+                addresses.append(address);
+            }
+        }
+        finishQuery(key, addresses, addresses.isEmpty() ? NEGATIVE_TTL_SEC : DEFAULT_TTL_SEC);
+    });
+}
+
+void DnsResolver::finishQuery(const QString &key, const QList<QHostAddress> &addresses, qint64 ttlSec)
+{
+    --m_active;
+
+    const Query query = m_queries.take(key);
+    m_cache.insert(key, { addresses, m_clock.elapsed() + ttlSec * 1000 });
+
+    for (const auto &batch : query.batches) {
+        deliver(batch, query.hostname, addresses);
+    }
+
+    startQueries();
+}
+
+void DnsResolver::deliver(const std::shared_ptr<Batch> &batch, const QString &name,
+                          const QList<QHostAddress> &addresses)
+{
+    if (!addresses.isEmpty()) {
+        for (const QString &hostname : batch->names.value(name)) {
+            batch->result[hostname].append(addresses);
+        }
+    }
+
+    if (--batch->remaining > 0) {
+        return;
+    }
+    if (batch->context) {
+        batch->callback(batch->result);
+    }
+}
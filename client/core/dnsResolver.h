@@ -0,0 +1,96 @@
+#ifndef DNSRESOLVER_H
+#define DNSRESOLVER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QQueue>
+#include <QStringList>
+
+#include <functional>
+#include <memory>
+
+// Resolves batches of hostnames with a bounded number of lookups in flight.
+// Answers are cached for a while, failures briefly, and a hostname that is
+// already being looked up is not queried again. Each batch completes with a
+// single callback carrying the addresses of all its hostnames.
+class DnsResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Family {
+        Ipv4 = 0x1,
+        Ipv6 = 0x2,
+    };
+    Q_DECLARE_FLAGS(Families, Family)
+
+    // Hostname to its addresses, empty when it didn't resolve.
+    using Result = QHash<QString, QList<QHostAddress>>;
+
+    static constexpr int DEFAULT_MAX_CONCURRENT = 16;
+
+    explicit DnsResolver(QObject *parent = nullptr);
+
+    void setMaxConcurrent(int count) { m_maxConcurrent = qMax(1, count); }
+    // Queries this server directly instead of the system resolver, answers
+    // are then cached for their TTL. Desktop only.
+    void setNameserver(const QHostAddress &address, quint16 port = 53);
+
+    // The callback runs on the resolver's thread once all hostnames are
+    // resolved, unless context is gone by then.
+    void resolve(const QStringList &hostnames, Families families, QObject *context,
+                 const std::function<void(const Result &)> &callback);
+
+    void clearCache();
+
+private:
+    struct Batch
+    {
+        Result result;
+        // Lower case name to the spellings it was requested in.
+        QHash<QString, QStringList> names;
+        int remaining = 0;
+        QPointer<QObject> context;
+        std::function<void(const Result &)> callback;
+    };
+
+    struct Query
+    {
+        QString hostname;
+        Family family;
+        QList<std::shared_ptr<Batch>> batches;
+    };
+
+    struct CacheEntry
+    {
+        QList<QHostAddress> addresses;
+        qint64 expires;
+    };
+
+    static QString cacheKey(const QString &hostname, Family family);
+
+    void startQueries();
+    void lookup(const QString &key);
+    void finishQuery(const QString &key, const QList<QHostAddress> &addresses, qint64 ttlSec);
+    void deliver(const std::shared_ptr<Batch> &batch, const QString &name, const QList<QHostAddress> &addresses);
+
+    int m_maxConcurrent = DEFAULT_MAX_CONCURRENT;
+    int m_active = 0;
+
+    QHostAddress m_nameserver;
+    quint16 m_nameserverPort = 53;
+
+    QElapsedTimer m_clock;
+    QHash<QString, CacheEntry> m_cache;
+    // Keyed like the cache; a key is in m_queue until its lookup starts.
+    QHash<QString, Query> m_queries;
+    QQueue<QString> m_queue;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(DnsResolver::Families)
+
+#endif // DNSRESOLVER_H
@@ -0,0 +1,132 @@
+#include "ipAddressPool.h"
+
+#include <QStringList>
+#include <QtAlgorithms>
+
+IpAddressPool::IpAddressPool(const QHostAddress &network, int prefixLength)
+{
+    if (network.protocol() != QAbstractSocket::IPv4Protocol || prefixLength < MIN_PREFIX_LENGTH
+        || prefixLength > MAX_PREFIX_LENGTH) {
+        return;
+    }
+
+    const quint32 mask = ~quint32(0) << (32 - prefixLength);
+    m_network = network.toIPv4Address() & mask;
+    m_prefixLength = prefixLength;
+    m_size = quint32(1) << (32 - prefixLength);
+    m_free = m_size;
+    m_bits.fill(0, (m_size + 63) / 64);
+
+    setBit(0);
+    setBit(1);
+    setBit(m_size - 1);
+}
+
+bool IpAddressPool::contains(const QHostAddress &address) const
+{
+    quint32 offset;
+    return offsetOf(address, offset);
+}
+
+bool IpAddressPool::reserve(const QHostAddress &address)
+{
+    quint32 offset;
+    if (!offsetOf(address, offset) || testBit(offset)) {
+        return false;
+    }
+    setBit(offset);
+    return true;
+}
+
+QHostAddress IpAddressPool::allocate()
+{
+    for (qsizetype word = m_firstFreeWord; word < m_bits.size(); ++word) {
+        const quint64 freeBits = ~m_bits.at(word);
+        if (freeBits == 0) {
+            continue;
+        }
+
+        m_firstFreeWord = word;
+        const quint32 offset = quint32(word) * 64 + qCountTrailingZeroBits(freeBits);
+        if (offset >= m_size) {
+            break;
+        }
+        setBit(offset);
+        return QHostAddress(m_network + offset);
+    }
+
+    m_firstFreeWord = m_bits.size();
+    return QHostAddress();
+}
+
+bool IpAddressPool::release(const QHostAddress &address)
+{
+    quint32 offset;
+    // The reserved addresses stay used.
+    if (!offsetOf(address, offset) || offset <= 1 || offset == m_size - 1 || !testBit(offset)) {
+        return false;
+    }
+    clearBit(offset);
+    return true;
+}
+
+bool IpAddressPool::isUsed(const QHostAddress &address) const
+{
+    quint32 offset;
+    return offsetOf(address, offset) && testBit(offset);
+}
+
+int IpAddressPool::reserveWireguardConfig(const QString &config)
+{
+    int reserved = 0;
+    const QStringList lines = config.split('\n');
+    for (const QString &line : lines) {
+        const int separator = line.indexOf('=');
+        if (separator < 0) {
+            continue;
+        }
+
+        const QString key = line.left(separator).trimmed();
+        if (key.compare("Address", Qt::CaseInsensitive) != 0 && key.compare("AllowedIPs", Qt::CaseInsensitive) != 0) {
+            continue;
+        }
+
+        // Comma separated addresses with an optional prefix length, only
+        // host routes and the interface address itself name one address.
+        const QStringList values = line.mid(separator + 1).split(',', Qt::SkipEmptyParts);
+        for (const QString &value : values) {
+            const QString entry = value.trimmed();
+            const int slash = entry.indexOf('/');
+            if (slash >= 0 && key.compare("AllowedIPs", Qt::CaseInsensitive) == 0 && entry.mid(slash + 1) != "32") {
+                continue;
+            }
+            if (reserve(QHostAddress(entry.left(slash)))) {
+                ++reserved;
+            }
+        }
+    }
+    return reserved;
+}
+
+bool IpAddressPool::offsetOf(const QHostAddress &address, quint32 &offset) const
+{
+    if (!isValid() || address.protocol() != QAbstractSocket::IPv4Protocol) {
+        return false;
+    }
+
+    offset = address.toIPv4Address() - m_network;
+    return offset < m_size;
+}
+
+void IpAddressPool::setBit(quint32 offset)
+{
+    m_bits[offset / 64] |= quint64(1) << (offset % 64);
+    --m_free;
+}
+
+void IpAddressPool::clearBit(quint32 offset)
+{
+    m_bits[offset / 64] &= ~(quint64(1) << (offset % 64));
+    ++m_free;
+    m_firstFreeWord = qMin(m_firstFreeWord, qsizetype(offset / 64));
+}
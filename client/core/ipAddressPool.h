@@ -0,0 +1,63 @@
+#ifndef IPADDRESSPOOL_H
+#define IPADDRESSPOOL_H
+
+#include <QHostAddress>
+#include <QList>
+#include <QString>
+
+// Free and used host addresses of an IPv4 subnet, one bit per address.
+// Allocation returns the lowest free address, so addresses freed by removed
+// clients are handed out again before the pool grows.
+class IpAddressPool
+{
+public:
+    // Larger subnets would take more than 2 MiB of bits.
+    static constexpr int MIN_PREFIX_LENGTH = 8;
+    // Smaller ones have no host addresses left besides the reserved ones.
+    static constexpr int MAX_PREFIX_LENGTH = 30;
+
+    IpAddressPool() = default;
+    // The network and broadcast addresses, and the first host address, which
+    // clients never got, start out used.
+    IpAddressPool(const QHostAddress &network, int prefixLength);
+
+    // False for an IPv6 network or a prefix length out of range.
+    bool isValid() const { return !m_bits.isEmpty(); }
+
+    QHostAddress network() const { return QHostAddress(m_network); }
+    int prefixLength() const { return m_prefixLength; }
+    bool contains(const QHostAddress &address) const;
+
+    // Marks an address used, false if it is outside the subnet or already
+    // used.
+    bool reserve(const QHostAddress &address);
+    // The lowest free address marked used, null if the pool is exhausted.
+    QHostAddress allocate();
+    // False if the address is outside the subnet or wasn't used.
+    bool release(const QHostAddress &address);
+
+    bool isUsed(const QHostAddress &address) const;
+    quint32 size() const { return m_size; }
+    quint32 freeCount() const { return m_free; }
+
+    // Reserves the interface Address and all peer AllowedIPs of a WireGuard
+    // server config, in one pass. Returns the number of addresses reserved.
+    int reserveWireguardConfig(const QString &config);
+
+private:
+    bool offsetOf(const QHostAddress &address, quint32 &offset) const;
+    bool testBit(quint32 offset) const { return m_bits.at(offset / 64) & (quint64(1) << (offset % 64)); }
+    void setBit(quint32 offset);
+    void clearBit(quint32 offset);
+
+    quint32 m_network = 0;
+    int m_prefixLength = 0;
+    quint32 m_size = 0;
+    quint32 m_free = 0;
+
+    QList<quint64> m_bits;
+    // No free bit below this word.
+    qsizetype m_firstFreeWord = 0;
+};
+
+#endif // IPADDRESSPOOL_H
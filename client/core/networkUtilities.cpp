@@ -33,6 +33,9 @@
 
 #include <QHostAddress>
 #include <QHostInfo>
+#include <QtAlgorithms>
+
+#include <algorithm>
 
 QRegularExpression NetworkUtilities::ipAddressRegExp()
 {
@@ -90,21 +93,209 @@ QString NetworkUtilities::ipAddressFromIpWithSubnet(const QString ip)
     return ip.split("/").first();
 }
 
-QStringList NetworkUtilities::summarizeRoutes(const QStringList &ips, const QString cidr)
-{
-    //    QMap<int, int>
-    //    QHostAddress
+namespace {
+    // IPv4 and IPv6 prefixes share one representation: the address is kept
+    // left-aligned in 128 bits, so IPv4 occupies the top 32 bits of hi.
+    struct RoutePrefix
+    {
+        quint64 hi = 0;
+        quint64 lo = 0;
+        int length = 0;
+        quint64 covered = 0; // addresses of the input covered by this prefix, used for over-coverage
+    };
 
-           //    QMap<QString, QStringList> subnets; // <"a.b", <list subnets>>
+    quint64 maskHi(int length)
+    {
+        return length <= 0 ? 0 : (length >= 64 ? ~0ULL : ~0ULL << (64 - length));
+    }
 
-           //    for (const QString &ip : ips) {
-           //        if (ip.count(".") != 3) continue;
+    quint64 maskLo(int length)
+    {
+        return length <= 64 ? 0 : (length >= 128 ? ~0ULL : ~0ULL << (128 - length));
+    }
 
-           //        const QStringList &parts = ip.split(".");
-           //        subnets[parts.at(0) + "." + parts.at(1)].append(ip);
-           //    }
+    bool prefixLess(const RoutePrefix &a, const RoutePrefix &b)
+    {
+        if (a.hi != b.hi)
+            return a.hi < b.hi;
+        if (a.lo != b.lo)
+            return a.lo < b.lo;
+        return a.length < b.length;
+    }
+
+    bool prefixContains(const RoutePrefix &net, const RoutePrefix &p)
+    {
+        return net.length <= p.length && (p.hi & maskHi(net.length)) == net.hi && (p.lo & maskLo(net.length)) == net.lo;
+    }
+
+    RoutePrefix prefixSupernet(const RoutePrefix &p, int length)
+    {
+        RoutePrefix net;
+        net.hi = p.hi & maskHi(length);
+        net.lo = p.lo & maskLo(length);
+        net.length = length;
+        return net;
+    }
 
-    return QStringList();
+    // Length of the longest prefix shared by a and b
+    int commonPrefixLength(const RoutePrefix &a, const RoutePrefix &b)
+    {
+        int length = 0;
+        if (a.hi != b.hi) {
+            length = qCountLeadingZeroBits(a.hi ^ b.hi);
+        } else {
+            length = 64 + (a.lo != b.lo ? qCountLeadingZeroBits(a.lo ^ b.lo) : 64);
+        }
+        return qMin(length, qMin(a.length, b.length));
+    }
+
+    // Number of addresses in a prefix, saturated to the quint64 range
+    quint64 prefixSize(int hostBits)
+    {
+        return hostBits >= 64 ? ~0ULL : 1ULL << hostBits;
+    }
+
+    bool parseRoutePrefix(const QString &ipWithSubnet, RoutePrefix *prefix, int *width)
+    {
+        const int slash = ipWithSubnet.indexOf('/');
+        const QHostAddress addr(slash < 0 ? ipWithSubnet : ipWithSubnet.left(slash));
+
+        if (addr.protocol() == QAbstractSocket::IPv4Protocol) {
+            *width = 32;
+            prefix->hi = quint64(addr.toIPv4Address()) << 32;
+            prefix->lo = 0;
+        } else if (addr.protocol() == QAbstractSocket::IPv6Protocol) {
+            *width = 128;
+            const Q_IPV6ADDR ip6 = addr.toIPv6Address();
+            prefix->hi = 0;
+            prefix->lo = 0;
+            for (int i = 0; i < 8; ++i) {
+                prefix->hi = (prefix->hi << 8) | ip6[i];
+                prefix->lo = (prefix->lo << 8) | ip6[i + 8];
+            }
+        } else {
+            return false;
+        }
+
+        prefix->length = *width;
+        if (slash >= 0) {
+            bool ok;
+            prefix->length = ipWithSubnet.mid(slash + 1).toInt(&ok);
+            if (!ok || prefix->length < 0 || prefix->length > *width)
+                return false;
+        }
+
+        prefix->hi &= maskHi(prefix->length);
+        prefix->lo &= maskLo(prefix->length);
+        return true;
+    }
+
+    QString routePrefixToString(const RoutePrefix &prefix, int width)
+    {
+        QString ip;
+        if (width == 32) {
+            ip = QHostAddress(quint32(prefix.hi >> 32)).toString();
+        } else {
+            Q_IPV6ADDR ip6;
+            for (int i = 0; i < 8; ++i) {
+                ip6[i] = quint8(prefix.hi >> (56 - 8 * i));
+                ip6[i + 8] = quint8(prefix.lo >> (56 - 8 * i));
+            }
+            ip = QHostAddress(ip6).toString();
+        }
+
+        if (prefix.length == width)
+            return ip;
+        return QString("%1/%2").arg(ip).arg(prefix.length);
+    }
+
+    // Sort-and-merge aggregation of one address family. Covered prefixes are dropped and
+    // sibling prefixes are collapsed into their parent, so the result covers exactly the
+    // same addresses. With maxExtraAddresses > 0 neighbouring prefixes are additionally
+    // replaced by their common supernet when it adds at most that many addresses which
+    // are not part of the input.
+    QList<RoutePrefix> aggregateRoutePrefixes(QList<RoutePrefix> prefixes, int width, quint64 maxExtraAddresses)
+    {
+        std::sort(prefixes.begin(), prefixes.end(), prefixLess);
+
+        QList<RoutePrefix> merged;
+        merged.reserve(prefixes.size());
+        for (const RoutePrefix &p : std::as_const(prefixes)) {
+            if (!merged.isEmpty() && prefixContains(merged.last(), p))
+                continue;
+
+            merged.append(p);
+            while (merged.size() >= 2) {
+                const RoutePrefix &a = merged.at(merged.size() - 2);
+                const RoutePrefix &b = merged.last();
+                if (a.length != b.length || a.length == 0 || commonPrefixLength(a, b) != a.length - 1)
+                    break;
+
+                const RoutePrefix parent = prefixSupernet(a, a.length - 1);
+                merged.removeLast();
+                merged.last() = parent;
+            }
+        }
+
+        if (maxExtraAddresses == 0)
+            return merged;
+
+        QList<RoutePrefix> result;
+        result.reserve(merged.size());
+        for (RoutePrefix p : std::as_const(merged)) {
+            p.covered = prefixSize(width - p.length);
+            if (!result.isEmpty() && prefixContains(result.last(), p))
+                continue;
+
+            result.append(p);
+            while (result.size() >= 2) {
+                const int length = commonPrefixLength(result.at(result.size() - 2), result.last());
+                if (width - length >= 64)
+                    break;
+
+                RoutePrefix net = prefixSupernet(result.last(), length);
+                int first = result.size();
+                while (first > 0 && prefixContains(net, result.at(first - 1))) {
+                    --first;
+                    net.covered += result.at(first).covered;
+                }
+                if (prefixSize(width - length) - net.covered > maxExtraAddresses)
+                    break;
+
+                result.erase(result.begin() + first, result.end());
+                result.append(net);
+            }
+        }
+        return result;
+    }
+}
+
+QStringList NetworkUtilities::summarizeRoutes(const QStringList &ips, quint64 maxExtraAddresses)
+{
+    QList<RoutePrefix> ipv4;
+    QList<RoutePrefix> ipv6;
+    QStringList unparsed;
+
+    for (const QString &ip : ips) {
+        RoutePrefix prefix;
+        int width = 0;
+        if (!parseRoutePrefix(ip.trimmed(), &prefix, &width)) {
+            unparsed.append(ip);
+            continue;
+        }
+        (width == 32 ? ipv4 : ipv6).append(prefix);
+    }
+
+    QStringList result;
+    result.reserve(ipv4.size() + ipv6.size() + unparsed.size());
+    for (const RoutePrefix &prefix : aggregateRoutePrefixes(ipv4, 32, maxExtraAddresses))
+        result.append(routePrefixToString(prefix, 32));
+    for (const RoutePrefix &prefix : aggregateRoutePrefixes(ipv6, 128, maxExtraAddresses))
+        result.append(routePrefixToString(prefix, 128));
+
+    // Entries which are not IP prefixes are passed through untouched
+    result.append(unparsed);
+    return result;
 }
 
 QString NetworkUtilities::getIPAddress(const QString &host)
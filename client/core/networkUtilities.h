@@ -29,7 +29,9 @@ public:
     static QString netMaskFromIpWithSubnet(const QString ip);
     static QString ipAddressFromIpWithSubnet(const QString ip);
 
-    static QStringList summarizeRoutes(const QStringList &ips, const QString cidr);
+    // Collapses the list into the minimal set of IPv4/IPv6 prefixes covering the same addresses.
+    // maxExtraAddresses allows each resulting prefix to cover up to that many addresses not in the list.
+    static QStringList summarizeRoutes(const QStringList &ips, quint64 maxExtraAddresses = 0);
 
 };
 
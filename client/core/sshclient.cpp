@@ -172,12 +172,15 @@ namespace libssh {
                     return ErrorCode::NoError;
                 };
 
+                // Closing the channel stops the rest of a batched script.
                 auto errorCode = readOutput(false);
                 if (errorCode != ErrorCode::NoError) {
+                    closeChannel();
                     return errorCode;
                 }
                 errorCode = readOutput(true);
                 if (errorCode != ErrorCode::NoError) {
+                    closeChannel();
                     return errorCode;
                 }
             } else {
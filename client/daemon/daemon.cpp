@@ -14,9 +14,9 @@
 
 #include "leakdetector.h"
 #include "logger.h"
+#include "spantracer.h"
 
 constexpr const char* JSON_ALLOWEDIPADDRESSRANGES = "allowedIPAddressRanges";
-constexpr int HANDSHAKE_POLL_MSEC = 250;
 
 namespace {
 
@@ -34,8 +34,10 @@ Daemon::Daemon(QObject* parent) : QObject(parent) {
   Q_ASSERT(s_daemon == nullptr);
   s_daemon = this;
 
-  m_handshakeTimer.setSingleShot(true);
-  connect(&m_handshakeTimer, &QTimer::timeout, this, &Daemon::checkHandshake);
+  m_handshakeWatcher = new HandshakeWatcher(
+      [this]() { return wgutils()->getPeerStatus(); }, this);
+  connect(m_handshakeWatcher, &HandshakeWatcher::handshakeCompleted, this,
+          &Daemon::handshakeCompleted);
 }
 
 Daemon::~Daemon() {
@@ -68,6 +70,7 @@ bool Daemon::activate(const InterfaceConfig& config) {
   // If the activation abort's for any reason `the `activationFailure` signal is
   // emitted.
   logger.debug() << "Activating interface";
+  SpanTracer::Scope span("daemon.activate");
   auto emit_failure_guard = qScopeGuard([this] { emit activationFailure(); });
 
   if (m_connections.contains(config.m_hopType)) {
@@ -89,8 +92,13 @@ bool Daemon::activate(const InterfaceConfig& config) {
       bool status = run(Switch, config);
       logger.debug() << "Connection status:" << status;
       if (status) {
+        // The previous server may not have completed a handshake yet, stop
+        // polling its peer before the state is replaced.
+        m_handshakeWatcher->unwatch(
+            m_connections.value(config.m_hopType).m_config.m_serverPublicKey);
         m_connections[config.m_hopType] = ConnectionState(config);
-        m_handshakeTimer.start(HANDSHAKE_POLL_MSEC);
+        SpanTracer::instance().begin("daemon.handshake");
+        m_handshakeWatcher->watch(config.m_serverPublicKey);
         emit_failure_guard.dismiss();
         return true;
       }
@@ -114,6 +122,7 @@ bool Daemon::activate(const InterfaceConfig& config) {
 
   // Bring up the wireguard interface if not already done.
   if (!wgutils()->interfaceExists()) {
+    SpanTracer::Scope span("daemon.addInterface");
     if (!wgutils()->addInterface(config)) {
       logger.error() << "Interface creation failed.";
       return false;
@@ -126,9 +135,12 @@ bool Daemon::activate(const InterfaceConfig& config) {
   }
 
   // Add the peer to this interface.
-  if (!wgutils()->updatePeer(config)) {
-    logger.error() << "Peer creation failed.";
-    return false;
+  {
+    SpanTracer::Scope span("daemon.updatePeer");
+    if (!wgutils()->updatePeer(config)) {
+      logger.error() << "Peer creation failed.";
+      return false;
+    }
   }
 
   if (!maybeUpdateResolvers(config)) {
@@ -145,11 +157,14 @@ bool Daemon::activate(const InterfaceConfig& config) {
   }
 
   // set routing
-  for (const IPAddress& ip : config.m_allowedIPAddressRanges) {
-    if (!wgutils()->updateRoutePrefix(ip)) {
-      logger.debug() << "Routing configuration failed for"
-                     << logger.sensitive(ip.toString());
-      return false;
+  {
+    SpanTracer::Scope span("daemon.routes");
+    for (const IPAddress& ip : config.m_allowedIPAddressRanges) {
+      if (!wgutils()->updateRoutePrefix(ip)) {
+        logger.debug() << "Routing configuration failed for"
+                       << logger.sensitive(ip.toString());
+        return false;
+      }
     }
   }
 
@@ -157,7 +172,8 @@ bool Daemon::activate(const InterfaceConfig& config) {
   logger.debug() << "Connection status:" << status;
   if (status) {
     m_connections[config.m_hopType] = ConnectionState(config);
-    m_handshakeTimer.start(HANDSHAKE_POLL_MSEC);
+    SpanTracer::instance().begin("daemon.handshake");
+    m_handshakeWatcher->watch(config.m_serverPublicKey);
     emit_failure_guard.dismiss();
     return true;
   }
@@ -455,6 +471,8 @@ bool Daemon::deactivate(bool emitSignals) {
   }
 
   m_connections.clear();
+  m_handshakeWatcher->clear();
+  SpanTracer::instance().cancel("daemon.handshake");
   return true;
 }
 
@@ -547,6 +565,10 @@ QJsonObject Daemon::getStatus() {
     json.insert("deviceIpv4Address",
                 QJsonValue(connection.m_config.m_deviceIpv4Address));
     json.insert("date", connection.m_date.toString());
+    if (connection.m_timeToHandshake >= 0) {
+      json.insert("timeToHandshake",
+                  QJsonValue(connection.m_timeToHandshake));
+    }
     json.insert("txBytes", QJsonValue(status.m_txBytes));
     json.insert("rxBytes", QJsonValue(status.m_rxBytes));
     return json;
@@ -556,38 +578,18 @@ QJsonObject Daemon::getStatus() {
   return json;
 }
 
-void Daemon::checkHandshake() {
-  Q_ASSERT(wgutils() != nullptr);
-
-  logger.debug() << "Checking for handshake...";
-
-  int pendingHandshakes = 0;
-  QList<WireguardUtils::PeerStatus> peers = wgutils()->getPeerStatus();
+void Daemon::handshakeCompleted(const QString& pubkey,
+                                const QDateTime& handshake,
+                                qint64 timeToHandshake) {
   for (ConnectionState& connection : m_connections) {
-    const InterfaceConfig& config = connection.m_config;
-    if (connection.m_date.isValid()) {
+    if (connection.m_date.isValid() ||
+        connection.m_config.m_serverPublicKey != pubkey) {
       continue;
     }
-    logger.debug() << "awaiting" << config.m_serverPublicKey;
-
-    // Check if the handshake has completed.
-    for (const WireguardUtils::PeerStatus& status : peers) {
-      if (config.m_serverPublicKey != status.m_pubkey) {
-        continue;
-      }
-      if (status.m_handshake != 0) {
-        connection.m_date.setMSecsSinceEpoch(status.m_handshake);
-        emit connected(status.m_pubkey);
-      }
-    }
-
-    if (!connection.m_date.isValid()) {
-      pendingHandshakes++;
-    }
-  }
-
-  // Check again if there were connections that haven't completed a handshake.
-  if (pendingHandshakes > 0) {
-    m_handshakeTimer.start(HANDSHAKE_POLL_MSEC);
+    connection.m_date = handshake;
+    connection.m_timeToHandshake = timeToHandshake;
+    SpanTracer::instance().end("daemon.handshake");
+    SpanTracer::instance().writeTrace();
+    emit connected(pubkey);
   }
 }
@@ -9,6 +9,7 @@
 #include <QTimer>
 
 #include "dnsutils.h"
+#include "handshakewatcher.h"
 #include "interfaceconfig.h"
 #include "iputils.h"
 #include "wireguardutils.h"
@@ -75,18 +76,21 @@ class Daemon : public QObject {
   static bool parseStringList(const QJsonObject& obj, const QString& name,
                               QStringList& list);
 
-  void checkHandshake();
+  void handshakeCompleted(const QString& pubkey, const QDateTime& handshake,
+                          qint64 timeToHandshake);
 
   class ConnectionState {
    public:
     ConnectionState(){};
     ConnectionState(const InterfaceConfig& config) { m_config = config; }
     QDateTime m_date;
+    // Milliseconds from activation to the first handshake, -1 until then.
+    qint64 m_timeToHandshake = -1;
     InterfaceConfig m_config;
   };
   QMap<InterfaceConfig::HopType, ConnectionState> m_connections;
   QHash<IPAddress, int> m_excludedAddrSet;
-  QTimer m_handshakeTimer;
+  HandshakeWatcher* m_handshakeWatcher = nullptr;
 };
 
 #endif  // DAEMON_H
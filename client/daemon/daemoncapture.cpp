@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "daemoncapture.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "logger.h"
+
+namespace {
+Logger logger("DaemonCapture");
+
+QMutex s_mutex;
+QFile s_file;
+QElapsedTimer s_clock;
+// Opened on the first record, 0 unknown, 1 open, -1 disabled or failed.
+int s_state = 0;
+
+bool ensureOpen() {
+  if (s_state != 0) {
+    return s_state > 0;
+  }
+
+  const QString fileName =
+      qEnvironmentVariable(DaemonCapture::ENABLE_VARIABLE);
+  if (fileName.isEmpty()) {
+    s_state = -1;
+    return false;
+  }
+
+  s_file.setFileName(fileName);
+  if (!s_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    logger.error() << "Unable to open the capture file" << fileName;
+    s_state = -1;
+    return false;
+  }
+
+  logger.info() << "Capturing the daemon protocol to" << fileName;
+  s_clock.start();
+  s_state = 1;
+  return true;
+}
+}  // namespace
+
+// static
+bool DaemonCapture::isEnabled() {
+  static const bool enabled =
+      qEnvironmentVariableIsSet(DaemonCapture::ENABLE_VARIABLE);
+  return enabled;
+}
+
+// static
+void DaemonCapture::recordIncoming(const QJsonObject& message) {
+  if (!isEnabled()) {
+    return;
+  }
+
+  if (message.value("type").toString() != "activate") {
+    record("in", message);
+    return;
+  }
+
+  // The replay runs against mocks, it never needs the real keys.
+  QJsonObject redacted(message);
+  for (const char* key : {"privateKey", "serverPskKey"}) {
+    if (redacted.contains(key)) {
+      redacted.insert(key, REDACTED);
+    }
+  }
+  record("in", redacted);
+}
+
+// static
+void DaemonCapture::recordOutgoing(const QJsonObject& message) {
+  if (!isEnabled()) {
+    return;
+  }
+  record("out", message);
+}
+
+// static
+void DaemonCapture::record(const char* direction, const QJsonObject& message) {
+  QMutexLocker locker(&s_mutex);
+  if (!ensureOpen()) {
+    return;
+  }
+
+  QJsonObject entry;
+  entry.insert("t", s_clock.elapsed());
+  entry.insert("dir", direction);
+  entry.insert("msg", message);
+
+  s_file.write(QJsonDocument(entry).toJson(QJsonDocument::Compact));
+  s_file.write("\n");
+  s_file.flush();
+}
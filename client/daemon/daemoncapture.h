@@ -0,0 +1,33 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef DAEMONCAPTURE_H
+#define DAEMONCAPTURE_H
+
+#include <QByteArray>
+#include <QString>
+
+class QJsonObject;
+
+// Records the messages exchanged on the daemon socket so that a session can
+// be replayed later, see tools/daemonreplay. Enabled by setting
+// ENABLE_VARIABLE to the name of the capture file. Each message becomes one
+// line:
+//   {"t":<ms since the capture was opened>,"dir":"in"|"out","msg":{...}}
+// Keys in activate requests are replaced by REDACTED.
+class DaemonCapture final {
+ public:
+  static constexpr const char* ENABLE_VARIABLE = "AMNEZIA_DAEMON_CAPTURE";
+  static constexpr const char* REDACTED = "redacted";
+
+  static bool isEnabled();
+
+  static void recordIncoming(const QJsonObject& message);
+  static void recordOutgoing(const QJsonObject& message);
+
+ private:
+  static void record(const char* direction, const QJsonObject& message);
+};
+
+#endif  // DAEMONCAPTURE_H
@@ -9,9 +9,13 @@
 #include <QJsonValue>
 #include <QLocalSocket>
 
+#include <optional>
+
 #include "daemon.h"
+#include "daemoncapture.h"
 #include "leakdetector.h"
 #include "logger.h"
+#include "spantracer.h"
 
 namespace {
 Logger logger("DaemonLocalServerConnection");
@@ -50,22 +54,21 @@ void DaemonLocalServerConnection::readData() {
 
   Q_ASSERT(m_socket);
 
-  while (true) {
-    int pos = m_buffer.indexOf("\n");
-    if (pos == -1) {
-      QByteArray input = m_socket->readAll();
-      if (input.isEmpty()) {
-        break;
-      }
-      m_buffer.append(input);
-      continue;
-    }
-
-    QByteArray line = m_buffer.left(pos);
-    m_buffer.remove(0, pos + 1);
-
-    QByteArray command(line);
-    command = command.trimmed();
+  QByteArray input = m_socket->readAll();
+  if (input.isEmpty()) {
+    return;
+  }
+  m_buffer.append(input);
+
+  // Walk the complete lines by offset and drop them from the buffer in one
+  // go afterwards; erasing each line from the front is quadratic for a burst
+  // of commands. The scan resumes where the previous read stopped, so a long
+  // line arriving in pieces isn't searched again from its start.
+  qsizetype start = 0;
+  qsizetype pos;
+  while ((pos = m_buffer.indexOf('\n', qMax(start, m_scanned))) != -1) {
+    QByteArray command = m_buffer.mid(start, pos - start).trimmed();
+    start = pos + 1;
 
     if (command.isEmpty()) {
       continue;
@@ -73,6 +76,9 @@ void DaemonLocalServerConnection::readData() {
 
     parseCommand(command);
   }
+
+  m_buffer.remove(0, start);
+  m_scanned = m_buffer.size();
 }
 
 void DaemonLocalServerConnection::parseCommand(const QByteArray& data) {
@@ -83,6 +89,8 @@ void DaemonLocalServerConnection::parseCommand(const QByteArray& data) {
   }
 
   QJsonObject obj = json.object();
+  DaemonCapture::recordIncoming(obj);
+
   QJsonValue typeValue = obj.value("type");
   if (!typeValue.isString()) {
     logger.warning() << "No type command. Ignoring request.";
@@ -90,6 +98,13 @@ void DaemonLocalServerConnection::parseCommand(const QByteArray& data) {
   }
   QString type = typeValue.toString();
 
+  // The client polls the status every second, those spans would push the
+  // connect and handshake spans out of the trace within minutes.
+  std::optional<SpanTracer::Scope> span;
+  if (type != "status") {
+    span.emplace("daemon.command");
+  }
+
   logger.debug() << "Command received:" << type;
 
   if (type == "activate") {
@@ -115,8 +130,7 @@ void DaemonLocalServerConnection::parseCommand(const QByteArray& data) {
   if (type == "status") {
     QJsonObject obj = Daemon::instance()->getStatus();
     obj.insert("type", "status");
-    m_socket->write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
-    m_socket->write("\n");
+    write(obj);
     return;
   }
 
@@ -124,8 +138,7 @@ void DaemonLocalServerConnection::parseCommand(const QByteArray& data) {
     QJsonObject obj;
     obj.insert("type", "logs");
     obj.insert("logs", Daemon::instance()->logs().replace("\n", "|"));
-    m_socket->write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
-    m_socket->write("\n");
+    write(obj);
     return;
   }
 
@@ -157,6 +170,8 @@ void DaemonLocalServerConnection::backendFailure() {
 }
 
 void DaemonLocalServerConnection::write(const QJsonObject& obj) {
+  DaemonCapture::recordOutgoing(obj);
+
   m_socket->write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
   m_socket->write("\n");
 }
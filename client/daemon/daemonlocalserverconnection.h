@@ -31,6 +31,8 @@ class DaemonLocalServerConnection final : public QObject {
   QLocalSocket* m_socket = nullptr;
 
   QByteArray m_buffer;
+  // Bytes of m_buffer already searched for a line end.
+  qsizetype m_scanned = 0;
 };
 
 #endif  // DAEMONLOCALSERVERCONNECTION_H
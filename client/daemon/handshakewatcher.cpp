@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "handshakewatcher.h"
+
+#include "leakdetector.h"
+#include "logger.h"
+
+namespace {
+Logger logger("HandshakeWatcher");
+
+// Number of polls at the fast interval before backing off.
+constexpr int FAST_POLL_COUNT = 4;
+constexpr int FAST_POLL_MSEC = 50;
+constexpr int BACKOFF_START_MSEC = 100;
+constexpr int BACKOFF_MAX_MSEC = 1000;
+}  // namespace
+
+HandshakeWatcher::HandshakeWatcher(const StatusSource& source, QObject* parent)
+    : QObject(parent), m_source(source) {
+  MZ_COUNT_CTOR(HandshakeWatcher);
+
+  m_timer.setSingleShot(true);
+  connect(&m_timer, &QTimer::timeout, this, &HandshakeWatcher::poll);
+}
+
+HandshakeWatcher::~HandshakeWatcher() { MZ_COUNT_DTOR(HandshakeWatcher); }
+
+// static
+int HandshakeWatcher::pollInterval(int attempt) {
+  if (attempt < FAST_POLL_COUNT) {
+    return FAST_POLL_MSEC;
+  }
+  const int shift = qMin(attempt - FAST_POLL_COUNT, 16);
+  return qMin(BACKOFF_START_MSEC << shift, BACKOFF_MAX_MSEC);
+}
+
+void HandshakeWatcher::watch(const QString& pubkey) {
+  Pending pending;
+  pending.startMsec = QDateTime::currentMSecsSinceEpoch();
+  pending.elapsed.start();
+  m_pending.insert(pubkey, pending);
+
+  m_attempt = 0;
+  schedule();
+}
+
+void HandshakeWatcher::unwatch(const QString& pubkey) {
+  m_pending.remove(pubkey);
+  if (m_pending.isEmpty()) {
+    m_timer.stop();
+  }
+}
+
+void HandshakeWatcher::clear() {
+  m_pending.clear();
+  m_timer.stop();
+}
+
+void HandshakeWatcher::schedule() {
+  m_timer.start(pollInterval(m_attempt));
+}
+
+void HandshakeWatcher::poll() {
+  if (m_pending.isEmpty()) {
+    return;
+  }
+
+  logger.debug() << "Checking for handshake...";
+
+  const QList<WireguardUtils::PeerStatus> peers = m_source();
+  for (const WireguardUtils::PeerStatus& status : peers) {
+    if (status.m_handshake == 0) {
+      continue;
+    }
+    auto it = m_pending.find(status.m_pubkey);
+    if (it == m_pending.end()) {
+      continue;
+    }
+
+    // A handshake from before watch() belongs to an earlier session of the
+    // peer, fall back to the locally measured time in that case.
+    qint64 timeToHandshake = status.m_handshake - it->startMsec;
+    if (timeToHandshake < 0) {
+      timeToHandshake = it->elapsed.elapsed();
+    }
+    m_pending.erase(it);
+
+    logger.info() << "Handshake with" << logger.sensitive(status.m_pubkey)
+                  << "after" << timeToHandshake << "ms";
+    emit handshakeCompleted(status.m_pubkey,
+                            QDateTime::fromMSecsSinceEpoch(status.m_handshake),
+                            timeToHandshake);
+  }
+
+  // Check again if there are peers that haven't completed a handshake.
+  if (!m_pending.isEmpty()) {
+    ++m_attempt;
+    schedule();
+  }
+}
@@ -0,0 +1,64 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef HANDSHAKEWATCHER_H
+#define HANDSHAKEWATCHER_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+
+#include <functional>
+
+#include "wireguardutils.h"
+
+// Waits for the first handshake of a set of peers. The peer status is polled
+// on an adaptive schedule: a few quick polls right after the peer was added,
+// when the handshake is most likely to complete, then exponentially further
+// apart. A single status query serves all watched peers.
+class HandshakeWatcher final : public QObject {
+  Q_OBJECT
+
+ public:
+  using StatusSource = std::function<QList<WireguardUtils::PeerStatus>()>;
+
+  HandshakeWatcher(const StatusSource& source, QObject* parent = nullptr);
+  ~HandshakeWatcher();
+
+  // Starts watching the peer, restarting the schedule from the fast polls.
+  void watch(const QString& pubkey);
+  void unwatch(const QString& pubkey);
+  void clear();
+
+  bool isWatching(const QString& pubkey) const {
+    return m_pending.contains(pubkey);
+  }
+
+  // Delay before the given (0-based) poll.
+  static int pollInterval(int attempt);
+
+ signals:
+  // timeToHandshake is measured from watch() to the handshake time reported
+  // by the peer status.
+  void handshakeCompleted(const QString& pubkey, const QDateTime& handshake,
+                          qint64 timeToHandshake);
+
+ private:
+  void poll();
+  void schedule();
+
+  StatusSource m_source;
+  QTimer m_timer;
+  int m_attempt = 0;
+
+  struct Pending {
+    qint64 startMsec;
+    QElapsedTimer elapsed;
+  };
+  QHash<QString, Pending> m_pending;
+};
+
+#endif  // HANDSHAKEWATCHER_H
@@ -1,16 +1,17 @@
 #include "logger.h"
 
+#include <QBuffer>
 #include <QDateTime>
 #include <QDebug>
 #include <QDesktopServices>
 #include <QDir>
+#include <QFileInfo>
 #include <QMetaEnum>
 #include <QJsonDocument>
 #include <QStandardPaths>
 #include <QUrl>
 
-#include <iostream>
-
+#include "spantracer.h"
 #include "version.h"
 #include "utilities.h"
 
@@ -22,8 +23,8 @@
     #include <AmneziaVPN-Swift.h>
 #endif
 
-QFile Logger::m_file;
-QTextStream Logger::m_textStream;
+RotatingLogFile Logger::m_file;
+LogWriter Logger::m_writer;
 QString Logger::m_logFileName = QString("%1.log").arg(APPLICATION_NAME);
 
 void debugMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& msg)
@@ -41,10 +42,12 @@ void debugMessageHandler(QtMsgType type, const QMessageLogContext& context, cons
         return;
     }
 
-    Logger::m_textStream << qFormatLogMessage(type, context, msg) << Qt::endl << Qt::flush;
-    Logger::appendAllLog(qFormatLogMessage(type, context, msg));
-
-    std::cout << qFormatLogMessage(type, context, msg).toStdString() << std::endl << std::flush;
+    // Formatting is the only work done on the calling thread, the writer
+    // thread does the file and console output.
+    Logger::m_writer.push(qFormatLogMessage(type, context, msg));
+    if (type == QtFatalMsg) {
+        Logger::m_writer.flush();
+    }
 }
 
 Logger &Logger::Instance()
@@ -53,17 +56,19 @@ Logger &Logger::Instance()
     return s;
 }
 
+Logger::Logger() : m_sshLog(new LogModel(LogModel::DEFAULT_CAPACITY, this)), m_allLog(new LogModel(LogModel::DEFAULT_CAPACITY, this))
+{
+}
+
 void Logger::appendSshLog(const QString &log)
 {
     QString dt = QDateTime::currentDateTime().toString();
-    Instance().m_sshLog.append(dt + ": " + log + "\n");
-    emit Instance().sshLogChanged(Instance().sshLog());
+    Instance().m_sshLog->append(dt + ": " + log);
 }
 
 void Logger::appendAllLog(const QString &log)
 {
-    Instance().m_allLog.append(log + "\n");
-    emit Instance().allLogChanged(Instance().allLog());
+    Instance().m_allLog->append(log.split('\n'));
 }
 
 bool Logger::init()
@@ -76,13 +81,19 @@ bool Logger::init()
         return false;
     }
 
-    m_file.setFileName(appDir.filePath(m_logFileName));
-    if (!m_file.open(QIODevice::Append)) {
+    if (!m_file.open(appDir.filePath(m_logFileName))) {
         qWarning() << "Cannot open log file:" << m_logFileName;
         return false;
     }
-    m_file.setTextModeEnabled(true);
-    m_textStream.setDevice(&m_file);
+
+    BinaryLogSink::openIfEnabled(m_file.fileName());
+    SpanTracer::instance().setTraceFile(appDir.filePath(QFileInfo(m_logFileName).completeBaseName() + "-trace.json"));
+
+    // allLog is a property of the GUI thread object, hand it whole batches.
+    Logger *instance = &Instance();
+    m_writer.start(&m_file, [instance](const QString &batch) {
+        QMetaObject::invokeMethod(instance, [batch]() { appendAllLog(batch); }, Qt::QueuedConnection);
+    });
 
 #if !defined(QT_DEBUG) || defined(Q_OS_IOS)
     qInstallMessageHandler(debugMessageHandler);
@@ -95,8 +106,9 @@ void Logger::deInit()
 {
     qInstallMessageHandler(nullptr);
     qSetMessagePattern("%{message}");
-    m_textStream.setDevice(nullptr);
+    m_writer.stop();
     m_file.close();
+    BinaryLogSink::close();
 }
 
 bool Logger::setServiceLogsEnabled(bool enabled) {
@@ -134,11 +146,10 @@ QString Logger::userLogsFilePath()
 
 QString Logger::getLogFile()
 {
-    m_file.flush();
-    QFile file(userLogsFilePath());
-
-    file.open(QIODevice::ReadOnly);
-    QString qtLog = file.readAll();
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    exportLogFile(&buffer);
+    QString qtLog = QString::fromUtf8(buffer.data());
     
 #ifdef Q_OS_IOS
     return QString().fromStdString(AmneziaVPN::swiftUpdateLogData(qtLog.toStdString()));
@@ -148,6 +159,12 @@ QString Logger::getLogFile()
 
 }
 
+bool Logger::exportLogFile(QIODevice *out)
+{
+    m_writer.flush();
+    return RotatingLogFile::exportTo(userLogsFilePath(), out);
+}
+
 bool Logger::openLogsFolder()
 {
     QString path = userLogsDir();
@@ -179,13 +196,12 @@ QString Logger::appLogFileNamePath()
 void Logger::clearLogs()
 {
     bool isLogActive = m_file.isOpen();
+    m_writer.stop();
     m_file.close();
+    BinaryLogSink::close();
 
-    QFile file(userLogsFilePath());
-
-    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
-    file.resize(0);
-    file.close();
+    RotatingLogFile::remove(userLogsFilePath());
+    QFile::remove(BinaryLogSink::fileNameFor(userLogsFilePath()));
     
 #ifdef Q_OS_IOS
     AmneziaVPN::swiftDeleteLog();
@@ -227,10 +243,16 @@ void Logger::cleanUp()
 }
 
 Logger::Log::Log(Logger* logger, LogLevel logLevel)
-    : m_logger(logger), m_logLevel(logLevel), m_data(new Data()) {}
+    : m_logger(logger), m_logLevel(logLevel), m_data(new Data()) {
+    m_data->m_binary = BinaryLogSink::isOpen();
+}
 
 Logger::Log::~Log() {
-    qDebug() << "Amnezia" << m_logger->className() << m_data->m_buffer.trimmed();
+    if (m_data->m_binary) {
+        BinaryLogSink::write(m_logLevel, m_logger->className(), m_data->m_args);
+    } else {
+        qDebug() << "Amnezia" << m_logger->className() << m_data->m_buffer.trimmed();
+    }
     delete m_data;
 }
 
@@ -248,32 +270,89 @@ QString Logger::sensitive(const QString& input) {
 }
 
 
-#define CREATE_LOG_OP_REF(x)                  \
-Logger::Log& Logger::Log::operator<<(x t) {   \
-    m_data->m_ts << t << ' ';                 \
-    return *this;                             \
+Logger::Log& Logger::Log::operator<<(uint64_t t) {
+    if (m_data->m_binary) {
+        m_data->m_args.append({BinaryLog::Unsigned, t});
+    } else {
+        m_data->m_ts << t << ' ';
+    }
+    return *this;
 }
 
-CREATE_LOG_OP_REF(uint64_t);
-CREATE_LOG_OP_REF(const char*);
-CREATE_LOG_OP_REF(const QString&);
-CREATE_LOG_OP_REF(const QByteArray&);
-CREATE_LOG_OP_REF(const void*);
+void Logger::Log::addLiteral(const char* literal) {
+    if (m_data->m_binary) {
+        BinaryLog::Arg arg{BinaryLog::Literal};
+        arg.literal = literal;
+        m_data->m_args.append(arg);
+    } else {
+        m_data->m_ts << literal << ' ';
+    }
+}
 
-#undef CREATE_LOG_OP_REF
+void Logger::Log::addCString(const char* text) {
+    if (m_data->m_binary) {
+        addText(QString::fromUtf8(text));
+    } else {
+        m_data->m_ts << text << ' ';
+    }
+}
+
+Logger::Log& Logger::Log::operator<<(const QString& t) {
+    if (m_data->m_binary) {
+        addText(t);
+    } else {
+        m_data->m_ts << t << ' ';
+    }
+    return *this;
+}
+
+Logger::Log& Logger::Log::operator<<(const QByteArray& t) {
+    if (m_data->m_binary) {
+        addText(QString::fromUtf8(t));
+    } else {
+        m_data->m_ts << t << ' ';
+    }
+    return *this;
+}
+
+Logger::Log& Logger::Log::operator<<(const void* t) {
+    if (m_data->m_binary) {
+        m_data->m_args.append({BinaryLog::Pointer, quint64(quintptr(t))});
+    } else {
+        m_data->m_ts << t << ' ';
+    }
+    return *this;
+}
+
+void Logger::Log::addText(const QString& text) {
+    BinaryLog::Arg arg{BinaryLog::Text};
+    arg.text = text;
+    m_data->m_args.append(arg);
+}
 
 Logger::Log& Logger::Log::operator<<(const QStringList& t) {
-    m_data->m_ts << '[' << t.join(",") << ']' << ' ';
+    if (m_data->m_binary) {
+        addText('[' + t.join(",") + ']');
+    } else {
+        m_data->m_ts << '[' << t.join(",") << ']' << ' ';
+    }
     return *this;
 }
 
 Logger::Log& Logger::Log::operator<<(const QJsonObject& t) {
-    m_data->m_ts << QJsonDocument(t).toJson(QJsonDocument::Indented) << ' ';
+    if (m_data->m_binary) {
+        addText(QJsonDocument(t).toJson(QJsonDocument::Indented));
+    } else {
+        m_data->m_ts << QJsonDocument(t).toJson(QJsonDocument::Indented) << ' ';
+    }
     return *this;
 }
 
 Logger::Log& Logger::Log::operator<<(QTextStreamFunction t) {
-    m_data->m_ts << t;
+    // Stream manipulators only affect the text rendering.
+    if (!m_data->m_binary) {
+        m_data->m_ts << t;
+    }
     return *this;
 }
 
@@ -300,5 +379,9 @@ void Logger::Log::addMetaEnum(quint64 value, const QMetaObject* meta,
         ts << value << ")";
     }
 
-    m_data->m_ts << out;
+    if (m_data->m_binary) {
+        addText(out);
+    } else {
+        m_data->m_ts << out;
+    }
 }
@@ -7,15 +7,18 @@
 #include <QString>
 #include <QTextStream>
 
-#include "ui/property_helper.h"
+#include "binarylog.h"
+#include "logwriter.h"
+#include "rotatinglogfile.h"
+#include "ui/models/logModel.h"
 
 #include "mozilla/shared/loglevel.h"
 
 class Logger : public QObject
 {
     Q_OBJECT
-    AUTO_PROPERTY(QString, sshLog)
-    AUTO_PROPERTY(QString, allLog)
+    Q_PROPERTY(LogModel *sshLog READ sshLog CONSTANT)
+    Q_PROPERTY(LogModel *allLog READ allLog CONSTANT)
 
 public:
     static Logger& Instance();
@@ -23,6 +26,9 @@ public:
     static void appendSshLog(const QString &log);
     static void appendAllLog(const QString &log);
 
+    LogModel *sshLog() const { return m_sshLog; }
+    LogModel *allLog() const { return m_allLog; }
+
 
     static bool init();
     static void deInit();
@@ -36,6 +42,8 @@ public:
 
     static QString userLogsFilePath();
     static QString getLogFile();
+    // Streams all log segments, oldest first, into out.
+    static bool exportLogFile(QIODevice *out);
 
     // compat with Mozilla logger
     Logger(const QString &className) { m_className = className; }
@@ -47,7 +55,6 @@ public:
         ~Log();
 
         Log& operator<<(uint64_t t);
-        Log& operator<<(const char* t);
         Log& operator<<(const QString& t);
         Log& operator<<(const QStringList& t);
         Log& operator<<(const QByteArray& t);
@@ -55,6 +62,26 @@ public:
         Log& operator<<(QTextStreamFunction t);
         Log& operator<<(const void* t);
 
+        // Only string literals are kept by pointer and interned by the binary
+        // log. Any other C string is copied, it may be gone or overwritten
+        // by the time the record is written.
+        template <size_t N>
+        Log& operator<<(const char (&t)[N]) {
+            addLiteral(t);
+            return *this;
+        }
+        template <size_t N>
+        Log& operator<<(char (&t)[N]) {
+            addCString(t);
+            return *this;
+        }
+        template <typename T>
+        typename std::enable_if<std::is_same<T, const char*>::value || std::is_same<T, char*>::value, Log&>::type
+        operator<<(T t) {
+            addCString(t);
+            return *this;
+        }
+
         // Q_ENUM
         template <typename T>
         typename std::enable_if<QtPrivate::IsQEnumHelper<T>::Value, Log&>::type
@@ -67,6 +94,9 @@ public:
 
     private:
         void addMetaEnum(quint64 value, const QMetaObject* meta, const char* name);
+        void addText(const QString& text);
+        void addLiteral(const char* literal);
+        void addCString(const char* text);
 
         Logger* m_logger;
         LogLevel m_logLevel;
@@ -76,6 +106,10 @@ public:
 
             QString m_buffer;
             QTextStream m_ts;
+
+            // Arguments kept typed for the binary log instead of m_buffer.
+            bool m_binary = false;
+            QList<BinaryLog::Arg> m_args;
         };
 
         Data* m_data;
@@ -88,18 +122,22 @@ public:
     QString sensitive(const QString& input);
 
 private:
-    Logger() {}
+    Logger();
     Logger(Logger const &) = delete;
     Logger& operator= (Logger const&) = delete;
 
     static QString userLogsDir();
 
-    static QFile m_file;
-    static QTextStream m_textStream;
+    static RotatingLogFile m_file;
+    static LogWriter m_writer;
     static QString m_logFileName;
 
     friend void debugMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& msg);
 
+    // Only the singleton owns the models, the Mozilla style loggers don't.
+    LogModel *m_sshLog = nullptr;
+    LogModel *m_allLog = nullptr;
+
     // compat with Mozilla logger
     QString m_className;
 };
@@ -0,0 +1,201 @@
+#include "logwriter.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <iostream>
+
+#include "rotatinglogfile.h"
+
+namespace
+{
+    // The file and stdout are flushed once this much is pending or after
+    // the interval, whichever comes first.
+    constexpr qint64 FLUSH_THRESHOLD_BYTES = 64 * 1024;
+    constexpr int FLUSH_INTERVAL_MSEC = 100;
+
+    size_t roundUpToPowerOfTwo(int value)
+    {
+        size_t size = 2;
+        while (size < size_t(value)) {
+            size <<= 1;
+        }
+        return size;
+    }
+}
+
+LogWriter::LogWriter(int capacity) : m_mask(roundUpToPowerOfTwo(capacity) - 1)
+{
+    m_slots.reset(new Slot[m_mask + 1]);
+    for (size_t i = 0; i <= m_mask; ++i) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+LogWriter::~LogWriter()
+{
+    stop();
+}
+
+void LogWriter::start(RotatingLogFile *file, const BatchHandler &handler)
+{
+    stop();
+
+    m_file = file;
+    m_handler = handler;
+    m_running = true;
+
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName("LogWriter");
+    m_thread->start(QThread::LowPriority);
+}
+
+void LogWriter::stop()
+{
+    if (!m_thread) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_running = false;
+        m_wakeup.wakeOne();
+    }
+
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+    m_file = nullptr;
+    m_handler = BatchHandler();
+}
+
+// Bounded MPMC queue after Dmitry Vyukov: each slot carries a sequence
+// number telling producers and the consumer whose turn it is.
+bool LogWriter::push(QString &&record)
+{
+    size_t pos = m_head.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &m_slots[pos & m_mask];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+        if (diff == 0) {
+            if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->record = std::move(record);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Wake the writer early when the ring fills up faster than the flush
+    // interval drains it.
+    if ((pos & (m_mask >> 3)) == 0) {
+        m_wakeup.wakeOne();
+    }
+    return true;
+}
+
+bool LogWriter::pop(QString &record)
+{
+    Slot &slot = m_slots[m_tail & m_mask];
+    if (slot.sequence.load(std::memory_order_acquire) != m_tail + 1) {
+        return false;
+    }
+
+    record = std::move(slot.record);
+    slot.record = QString();
+    slot.sequence.store(m_tail + m_mask + 1, std::memory_order_release);
+    ++m_tail;
+    return true;
+}
+
+void LogWriter::flush()
+{
+    if (!m_thread) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    const quint64 ticket = ++m_flushTicket;
+    m_wakeup.wakeOne();
+    while (m_flushedTicket < ticket && m_running) {
+        m_flushed.wait(&m_mutex);
+    }
+}
+
+void LogWriter::run()
+{
+    QElapsedTimer sinceFlush;
+    sinceFlush.start();
+    qint64 unflushed = 0;
+
+    for (;;) {
+        m_mutex.lock();
+        if (m_running && m_flushTicket == m_flushedTicket) {
+            m_wakeup.wait(&m_mutex, FLUSH_INTERVAL_MSEC);
+        }
+        const quint64 ticket = m_flushTicket;
+        const bool running = m_running;
+        m_mutex.unlock();
+
+        unflushed += writeBatch();
+
+        const bool flushRequested = ticket != m_flushedTicket;
+        if (unflushed > 0
+            && (flushRequested || !running || unflushed >= FLUSH_THRESHOLD_BYTES
+                || sinceFlush.hasExpired(FLUSH_INTERVAL_MSEC))) {
+            m_file->flush();
+            std::cout.flush();
+            unflushed = 0;
+            sinceFlush.restart();
+        }
+
+        if (flushRequested || !running) {
+            QMutexLocker locker(&m_mutex);
+            m_flushedTicket = ticket;
+            m_flushed.wakeAll();
+        }
+
+        if (!running) {
+            return;
+        }
+    }
+}
+
+qint64 LogWriter::writeBatch()
+{
+    QString batch;
+    QString record;
+
+    const quint64 dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        batch += QString("LogWriter: %1 log messages dropped\n").arg(dropped);
+    }
+
+    // Cap the batch so a steady stream of producers can't starve the flush.
+    for (size_t i = 0; i <= m_mask && pop(record); ++i) {
+        batch += record;
+        batch += '\n';
+    }
+    if (batch.isEmpty()) {
+        return 0;
+    }
+
+    const QByteArray data = batch.toUtf8();
+    m_file->write(data);
+    std::cout.write(data.constData(), data.size());
+
+    if (m_handler) {
+        batch.chop(1);
+        m_handler(batch);
+    }
+    return data.size();
+}
@@ -0,0 +1,70 @@
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class QThread;
+class RotatingLogFile;
+
+// Asynchronous sink for formatted log lines. Producers push records into a
+// bounded lock-free ring buffer, a dedicated thread drains it and writes the
+// records in batches to the log file and stdout. When the ring is full new
+// records are dropped and counted rather than blocking the caller.
+class LogWriter
+{
+public:
+    using BatchHandler = std::function<void(const QString &batch)>;
+
+    explicit LogWriter(int capacity = 16384);
+    ~LogWriter();
+
+    // Starts the writer thread on an already opened file. The handler, if
+    // any, is called on the writer thread with every batch written.
+    void start(RotatingLogFile *file, const BatchHandler &handler = BatchHandler());
+    // Writes out everything queued so far and stops the writer thread.
+    void stop();
+    bool isRunning() const { return m_thread != nullptr; }
+
+    // Safe to call from any thread. Returns false if the record was dropped.
+    bool push(QString &&record);
+
+    // Blocks until all records pushed before the call hit the file.
+    void flush();
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        QString record;
+    };
+
+    bool pop(QString &record);
+    void run();
+    qint64 writeBatch();
+
+    std::unique_ptr<Slot[]> m_slots;
+    const size_t m_mask;
+
+    alignas(64) std::atomic<size_t> m_head { 0 };
+    alignas(64) size_t m_tail = 0;
+    std::atomic<quint64> m_dropped { 0 };
+
+    RotatingLogFile *m_file = nullptr;
+    BatchHandler m_handler;
+    QThread *m_thread = nullptr;
+
+    QMutex m_mutex;
+    QWaitCondition m_wakeup;
+    QWaitCondition m_flushed;
+    bool m_running = false;
+    quint64 m_flushTicket = 0;
+    quint64 m_flushedTicket = 0;
+};
+
+#endif // LOGWRITER_H
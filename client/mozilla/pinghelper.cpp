@@ -16,9 +16,15 @@
 // Any X seconds, a new ping.
 constexpr uint32_t PING_TIMEOUT_SEC = 1;
 
-// Maximum window size for ping statistics.
+// Pings in flight that replies can still be matched against.
 constexpr int PING_STATS_WINDOW = 32;
 
+// A ping still unanswered this many pings later counts as lost.
+constexpr int PING_LOSS_DISTANCE = 2;
+
+// Marks a ping already counted as lost, late replies to it are ignored.
+constexpr qint64 PING_LOST = -2;
+
 namespace {
 Logger logger("PingHelper");
 }
@@ -63,6 +69,7 @@ void PingHelper::start(const QString& serverIpv4Gateway,
     m_pingData[i].latency = -1;
     m_pingData[i].sequence = 0;
   }
+  m_stats.reset();
 
   m_pingTimer.start(PING_TIMEOUT_SEC * 1000);
 }
@@ -83,11 +90,14 @@ void PingHelper::nextPing() {
   logger.debug() << "Sending ping seq:" << m_sequence;
 #endif
 
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  checkLoss(now);
+
   // The ICMP sequence number is used to match replies with their originating
   // request, and serves as an index into the circular buffer. Overflows of
   // the sequence number acceptable.
   int index = m_sequence % PING_STATS_WINDOW;
-  m_pingData[index].timestamp = QDateTime::currentMSecsSinceEpoch();
+  m_pingData[index].timestamp = now;
   m_pingData[index].latency = -1;
   m_pingData[index].sequence = m_sequence;
   m_pingSender->sendPing(m_gateway, m_sequence);
@@ -97,93 +107,63 @@ void PingHelper::nextPing() {
 
 void PingHelper::pingReceived(quint16 sequence) {
   int index = sequence % PING_STATS_WINDOW;
-  if (m_pingData[index].sequence == sequence) {
-    qint64 sendTime = m_pingData[index].timestamp;
-    m_pingData[index].latency = QDateTime::currentMSecsSinceEpoch() - sendTime;
+  if (m_pingData[index].sequence == sequence &&
+      m_pingData[index].latency == -1) {
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    m_pingData[index].latency = now - m_pingData[index].timestamp;
+    m_stats.addReply(now, m_pingData[index].latency);
+
     emit pingSentAndReceived(m_pingData[index].latency);
+    emit latencyChanged(latency(), percentile(50), percentile(90),
+                        percentile(99));
+    emit jitterChanged(jitter());
+    emit lossChanged(loss());
 #ifdef MZ_DEBUG
     logger.debug() << "Ping answer received seq:" << sequence
                    << "avg:" << latency()
                    << "loss:" << QString("%1%").arg(loss() * 100.0)
-                   << "stddev:" << stddev();
+                   << "stddev:" << stddev() << "p99:" << percentile(99)
+                   << "jitter:" << jitter();
 #endif
   }
 }
 
-uint PingHelper::latency() const {
-  int recvCount = 0;
-  qint64 totalMsec = 0;
-
-  for (const PingSendData& data : m_pingData) {
-    if (data.latency < 0) {
-      continue;
-    }
-    recvCount++;
-    totalMsec += data.latency;
+void PingHelper::checkLoss(qint64 now) {
+  if (m_sequence < PING_LOSS_DISTANCE) {
+    return;
   }
 
-  if (recvCount <= 0) {
-    return 0.0;
+  const quint16 sequence = m_sequence - PING_LOSS_DISTANCE;
+  PingSendData& data = m_pingData[sequence % PING_STATS_WINDOW];
+  if (data.sequence != sequence || data.latency != -1 || data.timestamp < 0) {
+    return;
   }
 
-  // Add half the denominator to produce nearest-integer rounding.
-  totalMsec += recvCount / 2;
-  return static_cast<uint>(totalMsec / recvCount);
+  data.latency = PING_LOST;
+  m_stats.addLoss(now);
+  emit lossChanged(loss());
 }
 
-uint PingHelper::stddev() const {
-  int recvCount = 0;
-  qint64 totalVariance = 0;
-  uint average = PingHelper::latency();
-
-  for (const PingSendData& data : m_pingData) {
-    if (data.latency < 0) {
-      continue;
-    }
-    recvCount++;
-    totalVariance += (average - data.latency) * (average - data.latency);
-  }
+void PingHelper::setStatsWindow(qint64 msec) { m_stats.setWindow(msec); }
 
-  if (recvCount <= 0) {
-    return 0.0;
-  }
+uint PingHelper::latency() const {
+  return static_cast<uint>(std::lround(m_stats.mean()));
+}
 
-  return std::sqrt((double)totalVariance / recvCount);
+uint PingHelper::stddev() const {
+  return static_cast<uint>(m_stats.stddev());
 }
 
 uint PingHelper::maximum() const {
-  uint maxRtt = 0;
-
-  for (const PingSendData& data : m_pingData) {
-    if (data.latency < 0) {
-      continue;
-    }
-    if (data.latency > maxRtt &&
-        data.latency < std::numeric_limits<uint>::max()) {
-      maxRtt = static_cast<uint>(data.latency);
-    }
-  }
-  return maxRtt;
+  return static_cast<uint>(
+      qMin<qint64>(m_stats.maximum(), std::numeric_limits<uint>::max()));
 }
 
-double PingHelper::loss() const {
-  int sendCount = 0;
-  int recvCount = 0;
-  // Don't count pings that are possibly still in flight as losses.
-  qint64 sendBefore =
-      QDateTime::currentMSecsSinceEpoch() - (PING_TIMEOUT_SEC * 1000);
-
-  for (const PingSendData& data : m_pingData) {
-    if (data.latency >= 0) {
-      recvCount++;
-      sendCount++;
-    } else if ((data.timestamp > 0) && (data.timestamp < sendBefore)) {
-      sendCount++;
-    }
-  }
+double PingHelper::loss() const { return m_stats.loss(); }
 
-  if (sendCount <= 0) {
-    return 0.0;
-  }
-  return (double)(sendCount - recvCount) / PING_STATS_WINDOW;
+uint PingHelper::percentile(double p) const {
+  return static_cast<uint>(
+      qMin<qint64>(m_stats.percentile(p), std::numeric_limits<uint>::max()));
 }
+
+double PingHelper::jitter() const { return m_stats.jitter(); }
@@ -11,6 +11,8 @@
 #include <QTimer>
 #include <QVector>
 
+#include "pingstats.h"
+
 class PingSender;
 
 class PingHelper final : public QObject {
@@ -30,14 +32,24 @@ class PingHelper final : public QObject {
   uint stddev() const;
   uint maximum() const;
   double loss() const;
+  uint percentile(double p) const;
+  double jitter() const;
+
+  // Time span the statistics cover, PingStats::DEFAULT_WINDOW_MSEC unless
+  // set.
+  void setStatsWindow(qint64 msec);
 
  signals:
   void pingSentAndReceived(qint64 msec);
+  void latencyChanged(uint average, uint p50, uint p90, uint p99);
+  void jitterChanged(double msec);
+  void lossChanged(double ratio);
 
  private:
   void nextPing();
 
   void pingReceived(quint16 sequence);
+  void checkLoss(qint64 now);
 
  private:
   QHostAddress m_gateway;
@@ -52,10 +64,12 @@ class PingHelper final : public QObject {
       sequence = 0;
     }
     qint64 timestamp;
+    // -1 while in flight, PING_LOST once counted as lost.
     qint64 latency;
     quint16 sequence;
   };
   QVector<PingSendData> m_pingData;
+  PingStats m_stats;
 
   QTimer m_pingTimer;
   PingSender* m_pingSender = nullptr;
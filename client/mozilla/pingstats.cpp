@@ -0,0 +1,165 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "pingstats.h"
+
+#include <cmath>
+
+namespace {
+// Values below this get a bucket each, above it every power of two is split
+// into SUB_BUCKETS buckets.
+constexpr int LINEAR_BUCKETS = 16;
+constexpr int SUB_BUCKET_BITS = 3;
+constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+// Covers round trips up to 2^20 ms, slower ones land in the last bucket.
+constexpr int MAX_EXPONENT = 20;
+constexpr int BUCKET_COUNT =
+    LINEAR_BUCKETS + (MAX_EXPONENT - 4 + 1) * SUB_BUCKETS;
+
+// RFC 3550 section 6.4.1 smoothing.
+constexpr double JITTER_GAIN = 1.0 / 16.0;
+}  // namespace
+
+PingStats::PingStats(qint64 windowMsec) : m_window(windowMsec) {
+  m_buckets.resize(BUCKET_COUNT);
+}
+
+void PingStats::setWindow(qint64 windowMsec) {
+  m_window = windowMsec;
+  if (!m_samples.isEmpty()) {
+    expire(m_samples.last().timestamp);
+  }
+}
+
+void PingStats::reset() {
+  m_samples.clear();
+  m_maxima.clear();
+  m_buckets.fill(0);
+  m_count = 0;
+  m_mean = 0;
+  m_m2 = 0;
+  m_jitter = 0;
+  m_lastRtt = -1;
+  m_loss = 0;
+  m_lastOutcome = -1;
+}
+
+// static
+int PingStats::bucketFor(qint64 rtt) {
+  if (rtt < LINEAR_BUCKETS) {
+    return rtt < 0 ? 0 : int(rtt);
+  }
+  const int exponent = qMin(int(std::log2(double(rtt))), MAX_EXPONENT);
+  const int sub = int(rtt >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+  return qMin(LINEAR_BUCKETS + (exponent - 4) * SUB_BUCKETS + sub,
+              BUCKET_COUNT - 1);
+}
+
+// static
+qint64 PingStats::bucketValue(int bucket) {
+  if (bucket < LINEAR_BUCKETS) {
+    return bucket;
+  }
+  const int exponent = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 4;
+  const int sub = (bucket - LINEAR_BUCKETS) % SUB_BUCKETS;
+  const qint64 width = qint64(1) << (exponent - SUB_BUCKET_BITS);
+  // Middle of the bucket.
+  return (qint64(1) << exponent) + sub * width + width / 2;
+}
+
+void PingStats::addReply(qint64 now, qint64 rttMsec) {
+  expire(now);
+
+  m_samples.append({now, rttMsec});
+  ++m_buckets[bucketFor(rttMsec)];
+
+  ++m_count;
+  const double delta = rttMsec - m_mean;
+  m_mean += delta / m_count;
+  m_m2 += delta * (rttMsec - m_mean);
+
+  while (!m_maxima.isEmpty() && m_maxima.last().rtt <= rttMsec) {
+    m_maxima.removeLast();
+  }
+  m_maxima.append({now, rttMsec});
+
+  // The round trip difference stands in for the transit time difference.
+  if (m_lastRtt >= 0) {
+    m_jitter += (std::abs(double(rttMsec - m_lastRtt)) - m_jitter) * JITTER_GAIN;
+  }
+  m_lastRtt = rttMsec;
+
+  updateLoss(now, 0.0);
+}
+
+void PingStats::addLoss(qint64 now) {
+  expire(now);
+  updateLoss(now, 1.0);
+}
+
+void PingStats::updateLoss(qint64 now, double lost) {
+  if (m_lastOutcome < 0) {
+    m_loss = lost;
+  } else {
+    // Weight the outcome by the time since the previous one, so the
+    // average spans roughly one window whatever the ping interval.
+    const double elapsed = qMax<qint64>(now - m_lastOutcome, 1);
+    const double alpha = 1.0 - std::exp(-elapsed / double(m_window));
+    m_loss += (lost - m_loss) * alpha;
+  }
+  m_lastOutcome = now;
+}
+
+void PingStats::expire(qint64 now) {
+  const qint64 cutoff = now - m_window;
+  while (!m_samples.isEmpty() && m_samples.first().timestamp <= cutoff) {
+    const qint64 rtt = m_samples.first().rtt;
+    m_samples.removeFirst();
+    --m_buckets[bucketFor(rtt)];
+
+    // Welford in reverse.
+    if (--m_count == 0) {
+      m_mean = 0;
+      m_m2 = 0;
+    } else {
+      const double oldMean = m_mean;
+      m_mean = (oldMean * (m_count + 1) - rtt) / m_count;
+      m_m2 -= (rtt - oldMean) * (rtt - m_mean);
+      if (m_m2 < 0) {
+        m_m2 = 0;
+      }
+    }
+  }
+
+  while (!m_maxima.isEmpty() && m_maxima.first().timestamp <= cutoff) {
+    m_maxima.removeFirst();
+  }
+}
+
+double PingStats::stddev() const {
+  if (m_count <= 0) {
+    return 0.0;
+  }
+  return std::sqrt(m_m2 / m_count);
+}
+
+qint64 PingStats::maximum() const {
+  return m_maxima.isEmpty() ? 0 : m_maxima.first().rtt;
+}
+
+qint64 PingStats::percentile(double p) const {
+  if (m_count <= 0) {
+    return 0;
+  }
+
+  const qint64 rank = qMax<qint64>(1, qint64(std::ceil(p / 100.0 * m_count)));
+  qint64 seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i) {
+    seen += m_buckets.at(i);
+    if (seen >= rank) {
+      return bucketValue(i);
+    }
+  }
+  return bucketValue(BUCKET_COUNT - 1);
+}
@@ -0,0 +1,70 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef PINGSTATS_H
+#define PINGSTATS_H
+
+#include <QList>
+#include <QVector>
+
+// Incremental ping statistics over a sliding time window. Every update is
+// O(1) amortized: mean and variance are kept with Welford's method, the
+// maximum with a monotonic queue and the percentiles in a log-bucket
+// histogram, all of which can also take samples out again once they leave
+// the window. Jitter (RFC 3550) and loss are exponentially weighted.
+class PingStats final {
+ public:
+  static constexpr qint64 DEFAULT_WINDOW_MSEC = 32000;
+
+  explicit PingStats(qint64 windowMsec = DEFAULT_WINDOW_MSEC);
+
+  void setWindow(qint64 windowMsec);
+  qint64 window() const { return m_window; }
+  void reset();
+
+  // Outcome of one ping at time now (ms).
+  void addReply(qint64 now, qint64 rttMsec);
+  void addLoss(qint64 now);
+
+  int count() const { return m_count; }
+  double mean() const { return m_mean; }
+  double stddev() const;
+  qint64 maximum() const;
+  // Latency below which p percent of the replies fall, p in [0, 100]. The
+  // result is exact below 16 ms and within 1/8 of the value above.
+  qint64 percentile(double p) const;
+  double jitter() const { return m_jitter; }
+  double loss() const { return m_loss; }
+
+ private:
+  struct Sample {
+    qint64 timestamp;
+    qint64 rtt;
+  };
+
+  void expire(qint64 now);
+  void updateLoss(qint64 now, double lost);
+
+  static int bucketFor(qint64 rtt);
+  static qint64 bucketValue(int bucket);
+
+  qint64 m_window;
+
+  QList<Sample> m_samples;
+  // Candidates for the maximum, decreasing rtt.
+  QList<Sample> m_maxima;
+  QVector<int> m_buckets;
+
+  int m_count = 0;
+  double m_mean = 0;
+  double m_m2 = 0;
+
+  double m_jitter = 0;
+  qint64 m_lastRtt = -1;
+
+  double m_loss = 0;
+  qint64 m_lastOutcome = -1;
+};
+
+#endif  // PINGSTATS_H
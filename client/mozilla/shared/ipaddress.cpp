@@ -6,6 +6,7 @@
 
 #include <QtMath>
 
+#include "ipprefixset.h"
 #include "leakdetector.h"
 
 IPAddress::IPAddress() { MZ_COUNT_CTOR(IPAddress); }
@@ -235,24 +236,13 @@ QList<IPAddress> IPAddress::subnets() const {
 // static
 QList<IPAddress> IPAddress::excludeAddresses(
     const QList<IPAddress>& sourceList, const QList<IPAddress>& excludeList) {
-  QList<IPAddress> results = sourceList;
-
+  // Each exclusion only splits the trie along its own path, instead of
+  // rebuilding the whole result list for every excluded address.
+  IpPrefixSet results(sourceList);
   for (const IPAddress& exclude : excludeList) {
-    QList<IPAddress> newResults;
-
-    for (const IPAddress& ip : results) {
-      if (!ip.overlaps(exclude)) {
-        newResults.append(ip);
-      } else if (exclude.subnetOf(ip) && exclude != ip) {
-        QList<IPAddress> range = ip.excludeAddresses(exclude);
-        newResults.append(range);
-      }
-    }
-
-    results = newResults;
+    results.remove(exclude);
   }
-
-  return results;
+  return results.prefixes();
 }
 
 QList<IPAddress> IPAddress::excludeAddresses(const IPAddress& ip) const {
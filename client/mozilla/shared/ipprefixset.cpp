@@ -0,0 +1,394 @@
+#include "ipprefixset.h"
+
+#include <QtAlgorithms>
+
+#include <utility>
+
+namespace {
+
+// Nodes 0 and 1 are the 0.0.0.0/0 and ::/0 roots of the two families.
+constexpr int IPV4_ROOT = 0;
+constexpr int IPV6_ROOT = 1;
+
+int rootWidth(int root) { return root == IPV4_ROOT ? 32 : 128; }
+
+quint64 maskHi(int length) {
+  return length <= 0 ? 0 : (length >= 64 ? ~0ULL : ~0ULL << (64 - length));
+}
+
+quint64 maskLo(int length) {
+  return length <= 64 ? 0
+                      : (length >= 128 ? ~0ULL : ~0ULL << (128 - length));
+}
+
+}  // namespace
+
+IpPrefixSet::IpPrefixSet() { clear(); }
+
+IpPrefixSet::IpPrefixSet(const QList<IPAddress>& list) {
+  clear();
+  insert(list);
+}
+
+void IpPrefixSet::clear() {
+  m_nodes.clear();
+  m_freeNodes.clear();
+  allocNode(Prefix(), false);
+  allocNode(Prefix(), false);
+}
+
+bool IpPrefixSet::isEmpty() const {
+  for (int root : {IPV4_ROOT, IPV6_ROOT}) {
+    const Node& node = m_nodes.at(root);
+    if (node.terminal || node.child[0] >= 0 || node.child[1] >= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// static
+bool IpPrefixSet::toPrefix(const IPAddress& ip, Prefix* prefix, int* root) {
+  const QHostAddress& address = ip.address();
+  if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+    *root = IPV4_ROOT;
+    prefix->hi = quint64(address.toIPv4Address()) << 32;
+    prefix->lo = 0;
+  } else if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+    *root = IPV6_ROOT;
+    Q_IPV6ADDR raw = address.toIPv6Address();
+    prefix->hi = 0;
+    prefix->lo = 0;
+    for (int i = 0; i < 8; ++i) {
+      prefix->hi = (prefix->hi << 8) | raw[i];
+      prefix->lo = (prefix->lo << 8) | raw[i + 8];
+    }
+  } else {
+    return false;
+  }
+
+  prefix->length = qBound(0, ip.prefixLength(), rootWidth(*root));
+  prefix->hi &= maskHi(prefix->length);
+  prefix->lo &= maskLo(prefix->length);
+  return true;
+}
+
+// static
+IPAddress IpPrefixSet::toIPAddress(const Prefix& prefix, int root) {
+  if (root == IPV4_ROOT) {
+    return IPAddress(QHostAddress(quint32(prefix.hi >> 32)), prefix.length);
+  }
+
+  Q_IPV6ADDR raw;
+  for (int i = 0; i < 8; ++i) {
+    raw[i] = quint8(prefix.hi >> (56 - 8 * i));
+    raw[i + 8] = quint8(prefix.lo >> (56 - 8 * i));
+  }
+  return IPAddress(QHostAddress(raw), prefix.length);
+}
+
+// static
+IpPrefixSet::Prefix IpPrefixSet::supernet(const Prefix& prefix, int length) {
+  Prefix net;
+  net.hi = prefix.hi & maskHi(length);
+  net.lo = prefix.lo & maskLo(length);
+  net.length = length;
+  return net;
+}
+
+// static
+bool IpPrefixSet::prefixContains(const Prefix& net, const Prefix& prefix) {
+  return net.length <= prefix.length &&
+         (prefix.hi & maskHi(net.length)) == net.hi &&
+         (prefix.lo & maskLo(net.length)) == net.lo;
+}
+
+// static
+int IpPrefixSet::commonLength(const Prefix& a, const Prefix& b) {
+  int length;
+  if (a.hi != b.hi) {
+    length = qCountLeadingZeroBits(a.hi ^ b.hi);
+  } else {
+    length = 64 + (a.lo != b.lo ? qCountLeadingZeroBits(a.lo ^ b.lo) : 64);
+  }
+  return qMin(length, qMin(a.length, b.length));
+}
+
+// static
+int IpPrefixSet::bitAt(const Prefix& prefix, int pos) {
+  return pos < 64 ? int((prefix.hi >> (63 - pos)) & 1)
+                  : int((prefix.lo >> (127 - pos)) & 1);
+}
+
+int IpPrefixSet::allocNode(const Prefix& prefix, bool terminal) {
+  Node node;
+  node.prefix = prefix;
+  node.terminal = terminal;
+
+  if (!m_freeNodes.isEmpty()) {
+    int index = m_freeNodes.takeLast();
+    m_nodes[index] = node;
+    return index;
+  }
+
+  m_nodes.append(node);
+  return m_nodes.size() - 1;
+}
+
+void IpPrefixSet::freeSubtree(int index) {
+  QVector<qint32> stack{index};
+  while (!stack.isEmpty()) {
+    int i = stack.takeLast();
+    for (qint32 child : m_nodes.at(i).child) {
+      if (child >= 0) {
+        stack.append(child);
+      }
+    }
+    m_nodes[i] = Node();
+    m_freeNodes.append(i);
+  }
+}
+
+int IpPrefixSet::findOrCreate(int root, const Prefix& prefix) {
+  int current = root;
+  while (true) {
+    const Node& node = m_nodes.at(current);
+    if (node.terminal) {
+      // Already covered by a wider prefix.
+      return -1;
+    }
+    if (node.prefix.length == prefix.length) {
+      return current;
+    }
+
+    const int bit = bitAt(prefix, node.prefix.length);
+    const int childIndex = node.child[bit];
+    if (childIndex < 0) {
+      const int leaf = allocNode(prefix, false);
+      m_nodes[current].child[bit] = leaf;
+      return leaf;
+    }
+
+    const Prefix child = m_nodes.at(childIndex).prefix;
+    if (prefixContains(child, prefix)) {
+      current = childIndex;
+      continue;
+    }
+
+    const int common = commonLength(child, prefix);
+    if (common == prefix.length) {
+      // The new prefix sits between the current node and its child.
+      const int inner = allocNode(prefix, false);
+      m_nodes[inner].child[bitAt(child, common)] = childIndex;
+      m_nodes[current].child[bit] = inner;
+      return inner;
+    }
+
+    // Branch at the first bit where the child and the new prefix differ.
+    const int branch = allocNode(supernet(prefix, common), false);
+    const int leaf = allocNode(prefix, false);
+    m_nodes[branch].child[bitAt(child, common)] = childIndex;
+    m_nodes[branch].child[bitAt(prefix, common)] = leaf;
+    m_nodes[current].child[bit] = branch;
+    return leaf;
+  }
+}
+
+void IpPrefixSet::insert(const IPAddress& ip) {
+  Prefix prefix;
+  int root;
+  if (!toPrefix(ip, &prefix, &root)) {
+    return;
+  }
+
+  const int index = findOrCreate(root, prefix);
+  if (index < 0) {
+    return;
+  }
+
+  // Everything below the new prefix is now redundant.
+  for (int bit : {0, 1}) {
+    const int child = m_nodes.at(index).child[bit];
+    if (child >= 0) {
+      freeSubtree(child);
+      m_nodes[index].child[bit] = -1;
+    }
+  }
+  m_nodes[index].terminal = true;
+}
+
+void IpPrefixSet::insert(const QList<IPAddress>& list) {
+  for (const IPAddress& ip : list) {
+    insert(ip);
+  }
+}
+
+void IpPrefixSet::remove(const IPAddress& ip) {
+  Prefix prefix;
+  int root;
+  if (!toPrefix(ip, &prefix, &root)) {
+    return;
+  }
+
+  int parent = -1;
+  int parentBit = 0;
+  int current = root;
+  while (true) {
+    const Node& node = m_nodes.at(current);
+
+    if (node.prefix.length == prefix.length) {
+      // The node is the removed prefix itself.
+      for (int bit : {0, 1}) {
+        const int child = m_nodes.at(current).child[bit];
+        if (child >= 0) {
+          freeSubtree(child);
+          m_nodes[current].child[bit] = -1;
+        }
+      }
+      m_nodes[current].terminal = false;
+      break;
+    }
+
+    if (node.terminal) {
+      // Split the covering prefix: keep the sibling of each level between
+      // the covering prefix and the removed one.
+      m_nodes[current].terminal = false;
+      int level = current;
+      for (int length = node.prefix.length; length < prefix.length; ++length) {
+        const int bit = bitAt(prefix, length);
+
+        Prefix sibling = supernet(prefix, length + 1);
+        if (length < 64) {
+          sibling.hi ^= 1ULL << (63 - length);
+        } else {
+          sibling.lo ^= 1ULL << (127 - length);
+        }
+        const int siblingIndex = allocNode(sibling, true);
+        const int next = length + 1 < prefix.length
+                             ? allocNode(supernet(prefix, length + 1), false)
+                             : -1;
+
+        m_nodes[level].child[!bit] = siblingIndex;
+        m_nodes[level].child[bit] = next;
+        level = next;
+      }
+      return;
+    }
+
+    const int bit = bitAt(prefix, node.prefix.length);
+    const int childIndex = node.child[bit];
+    if (childIndex < 0) {
+      return;
+    }
+
+    const Prefix child = m_nodes.at(childIndex).prefix;
+    if (prefixContains(prefix, child)) {
+      freeSubtree(childIndex);
+      m_nodes[current].child[bit] = -1;
+      break;
+    }
+    if (!prefixContains(child, prefix)) {
+      return;
+    }
+
+    parent = current;
+    parentBit = bit;
+    current = childIndex;
+  }
+
+  // Keep the trie path-compressed: drop the node if it lost its purpose.
+  if (parent < 0 || m_nodes.at(current).terminal) {
+    return;
+  }
+  const qint32* children = m_nodes.at(current).child;
+  if (children[0] >= 0 && children[1] >= 0) {
+    return;
+  }
+  m_nodes[parent].child[parentBit] = children[0] >= 0 ? children[0] : children[1];
+  m_nodes[current] = Node();
+  m_freeNodes.append(current);
+}
+
+void IpPrefixSet::subtract(const IpPrefixSet& other) {
+  for (int root : {IPV4_ROOT, IPV6_ROOT}) {
+    QList<Prefix> list;
+    other.collectTerminals(root, list);
+    for (const Prefix& prefix : list) {
+      remove(toIPAddress(prefix, root));
+    }
+  }
+}
+
+bool IpPrefixSet::contains(const QHostAddress& address) const {
+  Prefix prefix;
+  int root;
+  if (!toPrefix(IPAddress(address), &prefix, &root)) {
+    return false;
+  }
+
+  int current = root;
+  while (current >= 0) {
+    const Node& node = m_nodes.at(current);
+    if (node.terminal) {
+      return true;
+    }
+    if (node.prefix.length == prefix.length) {
+      return false;
+    }
+    current = node.child[bitAt(prefix, node.prefix.length)];
+    if (current >= 0 && !prefixContains(m_nodes.at(current).prefix, prefix)) {
+      return false;
+    }
+  }
+  return false;
+}
+
+void IpPrefixSet::collectTerminals(int root, QList<Prefix>& list) const {
+  QVector<qint32> stack{root};
+  while (!stack.isEmpty()) {
+    const Node& node = m_nodes.at(stack.takeLast());
+    if (node.terminal) {
+      list.append(node.prefix);
+      continue;
+    }
+    // Push the "1" branch first so that the "0" branch is visited first.
+    for (int bit : {1, 0}) {
+      if (node.child[bit] >= 0) {
+        stack.append(node.child[bit]);
+      }
+    }
+  }
+}
+
+QList<IPAddress> IpPrefixSet::prefixes() const {
+  QList<IPAddress> result;
+
+  for (int root : {IPV4_ROOT, IPV6_ROOT}) {
+    QList<Prefix> terminals;
+    collectTerminals(root, terminals);
+
+    // Terminals are disjoint and sorted, collapse complete sibling pairs.
+    QList<Prefix> merged;
+    merged.reserve(terminals.size());
+    for (const Prefix& prefix : std::as_const(terminals)) {
+      merged.append(prefix);
+      while (merged.size() >= 2) {
+        const Prefix& a = merged.at(merged.size() - 2);
+        const Prefix& b = merged.last();
+        if (a.length != b.length || a.length == 0 ||
+            commonLength(a, b) != a.length - 1) {
+          break;
+        }
+        const Prefix parent = supernet(a, a.length - 1);
+        merged.removeLast();
+        merged.last() = parent;
+      }
+    }
+
+    for (const Prefix& prefix : std::as_const(merged)) {
+      result.append(toIPAddress(prefix, root));
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,60 @@
+#ifndef IPPREFIXSET_H
+#define IPPREFIXSET_H
+
+#include <QList>
+#include <QVector>
+
+#include "ipaddress.h"
+
+// A set of IPv4/IPv6 addresses stored as a path-compressed binary trie of
+// prefixes. Inserting or removing a prefix costs O(prefix length), so large
+// exclusion lists can be subtracted from a range without splitting it into
+// intermediate lists.
+class IpPrefixSet final {
+ public:
+  IpPrefixSet();
+  IpPrefixSet(const QList<IPAddress>& list);
+
+  void insert(const IPAddress& prefix);
+  void insert(const QList<IPAddress>& list);
+  void remove(const IPAddress& prefix);
+  void subtract(const IpPrefixSet& other);
+
+  void clear();
+  bool isEmpty() const;
+  bool contains(const QHostAddress& address) const;
+
+  // Returns the minimal list of prefixes covering the set, IPv4 prefixes
+  // first, each family in ascending address order.
+  QList<IPAddress> prefixes() const;
+
+ private:
+  struct Prefix {
+    quint64 hi = 0;
+    quint64 lo = 0;
+    int length = 0;
+  };
+
+  struct Node {
+    Prefix prefix;
+    bool terminal = false;
+    qint32 child[2] = {-1, -1};
+  };
+
+  static bool toPrefix(const IPAddress& ip, Prefix* prefix, int* root);
+  static IPAddress toIPAddress(const Prefix& prefix, int root);
+  static Prefix supernet(const Prefix& prefix, int length);
+  static bool prefixContains(const Prefix& net, const Prefix& prefix);
+  static int commonLength(const Prefix& a, const Prefix& b);
+  static int bitAt(const Prefix& prefix, int pos);
+
+  int allocNode(const Prefix& prefix, bool terminal);
+  void freeSubtree(int index);
+  int findOrCreate(int root, const Prefix& prefix);
+  void collectTerminals(int root, QList<Prefix>& list) const;
+
+  QVector<Node> m_nodes;
+  QVector<qint32> m_freeNodes;
+};
+
+#endif  // IPPREFIXSET_H
@@ -0,0 +1,247 @@
+#include "defaultroutecache.h"
+
+#include <QSocketNotifier>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "leakdetector.h"
+#include "logger.h"
+
+namespace {
+Logger logger("DefaultRouteCache");
+
+constexpr int DUMP_TIMEOUT_MSEC = 1000;
+}  // namespace
+
+DefaultRouteCache::DefaultRouteCache(QObject* parent, bool subscribe)
+    : QObject(parent) {
+  MZ_COUNT_CTOR(DefaultRouteCache);
+
+  if (!subscribe) {
+    m_stale = false;
+    return;
+  }
+
+  m_nlsock = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    NETLINK_ROUTE);
+  if (m_nlsock < 0) {
+    logger.warning() << "Failed to create netlink socket:" << strerror(errno);
+    return;
+  }
+
+  // Let the kernel pick the port id, LinuxRouteMonitor already binds getpid().
+  struct sockaddr_nl nladdr;
+  memset(&nladdr, 0, sizeof(nladdr));
+  nladdr.nl_family = AF_NETLINK;
+  nladdr.nl_groups = RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+  if (bind(m_nlsock, (struct sockaddr*)&nladdr, sizeof(nladdr)) != 0) {
+    logger.warning() << "Failed to bind netlink socket:" << strerror(errno);
+    close(m_nlsock);
+    m_nlsock = -1;
+    return;
+  }
+
+  m_notifier = new QSocketNotifier(m_nlsock, QSocketNotifier::Read, this);
+  connect(m_notifier, &QSocketNotifier::activated, this,
+          &DefaultRouteCache::nlsockReady);
+
+  refresh();
+}
+
+DefaultRouteCache::~DefaultRouteCache() {
+  MZ_COUNT_DTOR(DefaultRouteCache);
+  if (m_nlsock >= 0) {
+    close(m_nlsock);
+  }
+}
+
+const DefaultRouteCache::Route& DefaultRouteCache::route(
+    QAbstractSocket::NetworkLayerProtocol protocol) {
+  // A removed default route may have uncovered another one, which is only
+  // known after a new dump.
+  if (m_stale && m_nlsock >= 0) {
+    refresh();
+  }
+  return protocol == QAbstractSocket::IPv6Protocol ? m_ipv6 : m_ipv4;
+}
+
+bool DefaultRouteCache::refresh() {
+  struct {
+    struct nlmsghdr nh;
+    struct rtmsg rtm;
+  } req;
+
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+  req.nh.nlmsg_type = RTM_GETROUTE;
+  req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.nh.nlmsg_seq = ++m_nlseq;
+  req.rtm.rtm_family = AF_UNSPEC;
+
+  if (send(m_nlsock, &req, req.nh.nlmsg_len, 0) < 0) {
+    logger.warning() << "Failed to request routing table:" << strerror(errno);
+    return false;
+  }
+
+  // The dump replaces the cache. Routes deleted while notifications were
+  // dropped must not survive it, and a route with a higher metric than the
+  // cached one would otherwise never be taken.
+  const Route ipv4 = m_ipv4;
+  const Route ipv6 = m_ipv6;
+  m_ipv4 = Route();
+  m_ipv6 = Route();
+
+  // Set again by an overrun or a deletion during the dump.
+  m_stale = false;
+  m_dumpSeq = req.nh.nlmsg_seq;
+  m_dumpPending = true;
+  while (m_dumpPending) {
+    if (!readMessages(DUMP_TIMEOUT_MSEC)) {
+      logger.warning() << "Routing table dump timed out";
+      m_dumpPending = false;
+      // Keep the previous routes, the next lookup tries again.
+      m_ipv4 = ipv4;
+      m_ipv6 = ipv6;
+      m_stale = true;
+      return false;
+    }
+  }
+
+  if (!sameRoute(m_ipv4, ipv4)) {
+    emit defaultRouteChanged(QAbstractSocket::IPv4Protocol);
+  }
+  if (!sameRoute(m_ipv6, ipv6)) {
+    emit defaultRouteChanged(QAbstractSocket::IPv6Protocol);
+  }
+  return true;
+}
+
+// static
+bool DefaultRouteCache::sameRoute(const Route& a, const Route& b) {
+  return a.valid == b.valid && a.gateway == b.gateway &&
+         a.ifindex == b.ifindex && a.priority == b.priority;
+}
+
+bool DefaultRouteCache::readMessages(int timeoutMsec) {
+  struct pollfd pfd;
+  pfd.fd = m_nlsock;
+  pfd.events = POLLIN;
+  if (poll(&pfd, 1, timeoutMsec) <= 0) {
+    return false;
+  }
+
+  // Large enough for a full dump batch of the kernel.
+  char buf[32768];
+  for (;;) {
+    ssize_t len = recv(m_nlsock, buf, sizeof(buf), 0);
+    if (len < 0) {
+      if (errno == ENOBUFS) {
+        // Notifications were dropped, the cache can't be trusted anymore.
+        logger.warning() << "Route notifications overrun";
+        m_stale = true;
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    processMessages(buf, len);
+  }
+}
+
+void DefaultRouteCache::nlsockReady() { readMessages(0); }
+
+void DefaultRouteCache::processMessages(const char* buf, size_t len) {
+  int remaining = static_cast<int>(len);
+  for (const struct nlmsghdr* nh = reinterpret_cast<const struct nlmsghdr*>(buf);
+       NLMSG_OK(nh, remaining); nh = NLMSG_NEXT(nh, remaining)) {
+    if (nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR) {
+      if (m_dumpPending && nh->nlmsg_seq == m_dumpSeq) {
+        m_dumpPending = false;
+      }
+      continue;
+    }
+    if (nh->nlmsg_type != RTM_NEWROUTE && nh->nlmsg_type != RTM_DELROUTE) {
+      continue;
+    }
+
+    const struct rtmsg* rtm =
+        static_cast<const struct rtmsg*>(NLMSG_DATA(nh));
+    if (rtm->rtm_dst_len != 0 || rtm->rtm_type != RTN_UNICAST ||
+        (rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6)) {
+      continue;
+    }
+
+    Route route;
+    quint32 table = rtm->rtm_table;
+    int attrlen = RTM_PAYLOAD(nh);
+    for (const struct rtattr* attr = RTM_RTA(rtm); RTA_OK(attr, attrlen);
+         attr = RTA_NEXT(attr, attrlen)) {
+      switch (attr->rta_type) {
+        case RTA_GATEWAY:
+          if (rtm->rtm_family == AF_INET &&
+              RTA_PAYLOAD(attr) == sizeof(quint32)) {
+            quint32 addr;
+            memcpy(&addr, RTA_DATA(attr), sizeof(addr));
+            route.gateway = QHostAddress(ntohl(addr));
+          } else if (rtm->rtm_family == AF_INET6 &&
+                     RTA_PAYLOAD(attr) == sizeof(Q_IPV6ADDR)) {
+            route.gateway =
+                QHostAddress(static_cast<const quint8*>(RTA_DATA(attr)));
+          }
+          break;
+        case RTA_OIF:
+          route.ifindex = *static_cast<const int*>(RTA_DATA(attr));
+          break;
+        case RTA_PRIORITY:
+          route.priority = *static_cast<const quint32*>(RTA_DATA(attr));
+          break;
+        case RTA_TABLE:
+          table = *static_cast<const quint32*>(RTA_DATA(attr));
+          break;
+        default:
+          break;
+      }
+    }
+
+    if (table != RT_TABLE_MAIN || route.gateway.isNull()) {
+      continue;
+    }
+
+    const QAbstractSocket::NetworkLayerProtocol protocol =
+        rtm->rtm_family == AF_INET6 ? QAbstractSocket::IPv6Protocol
+                                    : QAbstractSocket::IPv4Protocol;
+    Route& current = rtm->rtm_family == AF_INET6 ? m_ipv6 : m_ipv4;
+    route.valid = true;
+    const bool same = sameRoute(current, route);
+
+    if (nh->nlmsg_type == RTM_NEWROUTE) {
+      // Several default routes may coexist, the lowest metric wins. A route
+      // with the same metric is a replacement, `ip route replace` sends no
+      // RTM_DELROUTE for the old one. Dump replies come in kernel order,
+      // where the first of equal routes is the one used.
+      const bool notification = !(nh->nlmsg_flags & NLM_F_MULTI);
+      const bool replaces =
+          route.priority == current.priority &&
+          ((nh->nlmsg_flags & NLM_F_REPLACE) || notification);
+      if (!same && (!current.valid || route.priority < current.priority ||
+                    replaces)) {
+        current = route;
+        if (!m_dumpPending) {
+          emit defaultRouteChanged(protocol);
+        }
+      }
+    } else if (same) {
+      current = Route();
+      m_stale = true;
+      if (!m_dumpPending) {
+        emit defaultRouteChanged(protocol);
+      }
+    }
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef DEFAULTROUTECACHE_H
+#define DEFAULTROUTECACHE_H
+
+#include <QHostAddress>
+#include <QObject>
+
+class QSocketNotifier;
+
+// Keeps the default gateway of the main routing table in memory. The cache
+// subscribes to the rtnetlink route multicast groups once and is only
+// updated by kernel notifications, so lookups never touch the kernel.
+class DefaultRouteCache final : public QObject {
+  Q_OBJECT
+
+ public:
+  struct Route {
+    QHostAddress gateway;
+    int ifindex = 0;
+    quint32 priority = 0;
+    bool valid = false;
+  };
+
+  // With subscribe set to false no netlink socket is opened and the cache is
+  // only fed through processMessages().
+  explicit DefaultRouteCache(QObject* parent = nullptr, bool subscribe = true);
+  ~DefaultRouteCache();
+
+  const Route& route(QAbstractSocket::NetworkLayerProtocol protocol);
+  QHostAddress gateway(QAbstractSocket::NetworkLayerProtocol protocol =
+                           QAbstractSocket::IPv4Protocol) {
+    return route(protocol).gateway;
+  }
+  int ifindex(QAbstractSocket::NetworkLayerProtocol protocol =
+                  QAbstractSocket::IPv4Protocol) {
+    return route(protocol).ifindex;
+  }
+
+  // Applies a buffer of RTM_NEWROUTE/RTM_DELROUTE messages, either dump
+  // replies or multicast notifications.
+  void processMessages(const char* buf, size_t len);
+
+ signals:
+  void defaultRouteChanged(QAbstractSocket::NetworkLayerProtocol protocol);
+
+ private slots:
+  void nlsockReady();
+
+ private:
+  bool refresh();
+  bool readMessages(int timeoutMsec);
+  static bool sameRoute(const Route& a, const Route& b);
+
+  int m_nlsock = -1;
+  quint32 m_nlseq = 0;
+  quint32 m_dumpSeq = 0;
+  bool m_dumpPending = false;
+  bool m_stale = true;
+  QSocketNotifier* m_notifier = nullptr;
+
+  Route m_ipv4;
+  Route m_ipv6;
+};
+
+#endif  // DEFAULTROUTECACHE_H
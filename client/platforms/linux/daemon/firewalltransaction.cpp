@@ -0,0 +1,228 @@
+#include "firewalltransaction.h"
+
+#include <QProcess>
+
+#include "logger.h"
+
+namespace {
+Logger logger("FirewallTransaction");
+
+QString restoreCommand(LinuxFirewall::IPVersion ip)
+{
+    return ip == LinuxFirewall::IPv6 ? QStringLiteral("ip6tables-restore") : QStringLiteral("iptables-restore");
+}
+
+QString saveCommand(LinuxFirewall::IPVersion ip)
+{
+    return ip == LinuxFirewall::IPv6 ? QStringLiteral("ip6tables-save") : QStringLiteral("iptables-save");
+}
+
+QString ruleKey(const QString& chain, const QString& rule)
+{
+    return chain + QLatin1Char(' ') + rule.simplified();
+}
+
+int runProcess(QProcess& process)
+{
+    if (!process.waitForFinished() || process.error() == QProcess::FailedToStart)
+        return -2;
+    else if (process.exitStatus() != QProcess::NormalExit)
+        return -1;
+    else
+        return process.exitCode();
+}
+}  // namespace
+
+void FirewallTransaction::addCommand(IPVersion ip, const QString& table, const QString& command)
+{
+    if (ip == LinuxFirewall::Both)
+    {
+        addCommand(LinuxFirewall::IPv4, table, command);
+        addCommand(LinuxFirewall::IPv6, table, command);
+        return;
+    }
+    m_tables[family(ip)][table].commands.append(command);
+}
+
+void FirewallTransaction::declareChain(IPVersion ip, const QString& table, const QString& chain)
+{
+    if (ip == LinuxFirewall::Both)
+    {
+        declareChain(LinuxFirewall::IPv4, table, chain);
+        declareChain(LinuxFirewall::IPv6, table, chain);
+        return;
+    }
+    // With --noflush a declared chain is created, or flushed if it exists.
+    QStringList& chains = m_tables[family(ip)][table].chains;
+    if (!chains.contains(chain))
+        chains.append(chain);
+}
+
+void FirewallTransaction::deleteChain(IPVersion ip, const QString& table, const QString& chain)
+{
+    if (ip == LinuxFirewall::Both)
+    {
+        deleteChain(LinuxFirewall::IPv4, table, chain);
+        deleteChain(LinuxFirewall::IPv6, table, chain);
+        return;
+    }
+    flushChain(ip, table, chain);
+    m_tables[family(ip)][table].deletedChains.append(chain);
+}
+
+void FirewallTransaction::flushChain(IPVersion ip, const QString& table, const QString& chain)
+{
+    addCommand(ip, table, QStringLiteral("-F %1").arg(chain));
+}
+
+void FirewallTransaction::appendRule(IPVersion ip, const QString& table, const QString& chain, const QString& rule)
+{
+    addCommand(ip, table, QStringLiteral("-A %1 %2").arg(chain, rule));
+}
+
+void FirewallTransaction::insertRule(IPVersion ip, const QString& table, const QString& chain, const QString& rule, int position)
+{
+    addCommand(ip, table, QStringLiteral("-I %1 %2 %3").arg(chain).arg(position).arg(rule));
+}
+
+void FirewallTransaction::deleteRule(IPVersion ip, const QString& table, const QString& chain, const QString& rule)
+{
+    addCommand(ip, table, QStringLiteral("-D %1 %2").arg(chain, rule));
+}
+
+bool FirewallTransaction::declaresChain(IPVersion ip, const QString& table, const QString& chain) const
+{
+    return m_tables[family(ip)].value(table).chains.contains(chain);
+}
+
+bool FirewallTransaction::isEmpty() const
+{
+    return m_tables[0].isEmpty() && m_tables[1].isEmpty();
+}
+
+void FirewallTransaction::clear()
+{
+    m_tables[0].clear();
+    m_tables[1].clear();
+}
+
+QByteArray FirewallTransaction::script(IPVersion ip) const
+{
+    QByteArray out;
+    const QMap<QString, Table>& tables = m_tables[family(ip)];
+    for (auto it = tables.constBegin(); it != tables.constEnd(); ++it)
+    {
+        const Table& table = it.value();
+        out += '*' + it.key().toLatin1() + '\n';
+        for (const QString& chain : table.chains)
+            out += ':' + chain.toLatin1() + " - [0:0]\n";
+        for (const QString& command : table.commands)
+            out += command.toLatin1() + '\n';
+        for (const QString& chain : table.deletedChains)
+            out += "-X " + chain.toLatin1() + '\n';
+        out += "COMMIT\n";
+    }
+    return out;
+}
+
+int FirewallTransaction::restore(IPVersion ip) const
+{
+    const QByteArray input = script(ip);
+    const QString cmd = restoreCommand(ip);
+
+    QProcess p;
+    p.start(cmd, {QStringLiteral("--noflush")});
+    p.write(input);
+    p.closeWriteChannel();
+
+    int exitCode = runProcess(p);
+    auto err = p.readAllStandardError().trimmed();
+    if (exitCode != 0)
+    {
+        logger.warning() << "(" << exitCode << ") $ " << cmd << "--noflush";
+        for (const QByteArray& line : input.split('\n'))
+            logger.debug() << line;
+    }
+    if (!err.isEmpty())
+        logger.warning() << err;
+    return exitCode;
+}
+
+int FirewallTransaction::commit()
+{
+    int result = 0;
+    for (IPVersion ip : {LinuxFirewall::IPv4, LinuxFirewall::IPv6})
+    {
+        if (m_tables[family(ip)].isEmpty())
+            continue;
+        int exitCode = restore(ip);
+        if (!result)
+            result = exitCode;
+    }
+    clear();
+    return result;
+}
+
+bool FirewallTransaction::loadState(IPVersion ip)
+{
+    if (ip == LinuxFirewall::Both)
+    {
+        bool result4 = loadState(LinuxFirewall::IPv4);
+        bool result6 = loadState(LinuxFirewall::IPv6);
+        return result4 && result6;
+    }
+
+    QHash<QString, TableState>& state = m_state[family(ip)];
+    state.clear();
+
+    QProcess p;
+    p.start(saveCommand(ip), {}, QProcess::ReadOnly);
+    p.closeWriteChannel();
+    int exitCode = runProcess(p);
+    if (exitCode != 0)
+    {
+        logger.warning() << "(" << exitCode << ") $ " << saveCommand(ip);
+        return false;
+    }
+
+    QString table;
+    const QByteArray output = p.readAllStandardOutput();
+    for (const QByteArray& rawLine : output.split('\n'))
+    {
+        const QString line = QString::fromLatin1(rawLine).trimmed();
+        if (line.startsWith(QLatin1Char('*')))
+        {
+            table = line.mid(1);
+        }
+        else if (table.isEmpty())
+        {
+            continue;
+        }
+        else if (line.startsWith(QLatin1Char(':')))
+        {
+            state[table].chains.insert(line.mid(1).section(QLatin1Char(' '), 0, 0));
+        }
+        else if (line.startsWith(QLatin1String("-A ")))
+        {
+            const QString chain = line.section(QLatin1Char(' '), 1, 1);
+            const QString rule = line.section(QLatin1Char(' '), 2);
+            ++state[table].rules[ruleKey(chain, rule)];
+        }
+    }
+    return true;
+}
+
+QStringList FirewallTransaction::existingChains(IPVersion ip, const QString& table) const
+{
+    return m_state[family(ip)].value(table).chains.values();
+}
+
+bool FirewallTransaction::hasChain(IPVersion ip, const QString& table, const QString& chain) const
+{
+    return m_state[family(ip)].value(table).chains.contains(chain);
+}
+
+int FirewallTransaction::ruleCount(IPVersion ip, const QString& table, const QString& chain, const QString& rule) const
+{
+    return m_state[family(ip)].value(table).rules.value(ruleKey(chain, rule));
+}
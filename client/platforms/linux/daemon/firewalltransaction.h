@@ -0,0 +1,77 @@
+#ifndef FIREWALLTRANSACTION_H
+#define FIREWALLTRANSACTION_H
+
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include "linuxfirewall.h"
+
+// Collects chain and rule changes for the filter, nat, mangle and raw tables
+// and applies them with a single iptables-restore --noflush (ip6tables-restore
+// for IPv6) per address family. Every table is committed as a whole, so an
+// interrupted update never leaves a half-built ruleset behind.
+//
+// Unlike the iptables command line, iptables-restore aborts the whole table on
+// the first failing command, so deletions must only be queued for chains and
+// rules which exist. loadState() takes a snapshot of the current ruleset that
+// can be queried for this.
+class FirewallTransaction
+{
+public:
+    using IPVersion = LinuxFirewall::IPVersion;
+
+    // Creates the chain, or flushes it if it already exists.
+    void declareChain(IPVersion ip, const QString& table, const QString& chain);
+    // Flushes and removes the chain. The chain must exist and must not be
+    // referenced anymore once the transaction is applied.
+    void deleteChain(IPVersion ip, const QString& table, const QString& chain);
+    void flushChain(IPVersion ip, const QString& table, const QString& chain);
+    void appendRule(IPVersion ip, const QString& table, const QString& chain, const QString& rule);
+    void insertRule(IPVersion ip, const QString& table, const QString& chain, const QString& rule, int position = 1);
+    void deleteRule(IPVersion ip, const QString& table, const QString& chain, const QString& rule);
+
+    bool declaresChain(IPVersion ip, const QString& table, const QString& chain) const;
+    bool isEmpty() const;
+    void clear();
+
+    // The iptables-restore input for one address family.
+    QByteArray script(IPVersion ip) const;
+
+    // Applies and clears the queued changes. Returns 0 on success, otherwise
+    // the first non-zero exit code, like LinuxFirewall::execute().
+    int commit();
+
+    // Snapshot of the current ruleset, taken with iptables-save.
+    bool loadState(IPVersion ip = LinuxFirewall::Both);
+    QStringList existingChains(IPVersion ip, const QString& table) const;
+    bool hasChain(IPVersion ip, const QString& table, const QString& chain) const;
+    int ruleCount(IPVersion ip, const QString& table, const QString& chain, const QString& rule) const;
+
+private:
+    struct Table
+    {
+        QStringList chains;
+        QStringList commands;
+        // Chains to remove, deleted once all other commands of the table ran.
+        QStringList deletedChains;
+    };
+
+    struct TableState
+    {
+        QSet<QString> chains;
+        QHash<QString, int> rules;
+    };
+
+    static int family(IPVersion ip) { return ip == LinuxFirewall::IPv6 ? 1 : 0; }
+    void addCommand(IPVersion ip, const QString& table, const QString& command);
+    int restore(IPVersion ip) const;
+
+    // Keyed by table name, one map per address family.
+    QMap<QString, Table> m_tables[2];
+    QHash<QString, TableState> m_state[2];
+};
+
+#endif // FIREWALLTRANSACTION_H
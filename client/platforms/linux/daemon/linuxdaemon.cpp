@@ -28,7 +28,9 @@ LinuxDaemon::LinuxDaemon() : Daemon(nullptr) {
 
     logger.debug() << "Daemon created";
 
-    m_wgutils = new WireguardUtilsLinux(this);
+    m_wgutilsUserspace = new WireguardUtilsLinux(this);
+    m_wgutilsKernel = new WireguardUtilsLinuxKernel(this);
+    m_wgutils = m_wgutilsUserspace;
     m_dnsutils = new DnsUtilsLinux(this);
     m_iputils = new IPUtilsLinux(this);
 
@@ -50,3 +52,21 @@ LinuxDaemon* LinuxDaemon::instance() {
     Q_ASSERT(s_daemon);
     return s_daemon;
 }
+
+void LinuxDaemon::prepareActivation(const InterfaceConfig& config, int inetAdapterIndex) {
+    Q_UNUSED(inetAdapterIndex);
+
+    // Switching is only possible while no interface is up.
+    if (m_wgutils->interfaceExists()) {
+        return;
+    }
+
+    if (WireguardUtilsLinuxKernel::isSupported() &&
+        !WireguardUtilsLinuxKernel::needsUserspace(config)) {
+        logger.debug() << "Using the kernel WireGuard backend";
+        m_wgutils = m_wgutilsKernel;
+    } else {
+        logger.debug() << "Using the userspace WireGuard backend";
+        m_wgutils = m_wgutilsUserspace;
+    }
+}
@@ -10,6 +10,7 @@
 #include "dnsutilslinux.h"
 #include "iputilslinux.h"
 #include "wireguardutilslinux.h"
+#include "wireguardutilslinuxkernel.h"
 
 class LinuxDaemon final : public Daemon {
   friend class IPUtilsMacos;
@@ -20,6 +21,8 @@ class LinuxDaemon final : public Daemon {
 
   static LinuxDaemon* instance();
 
+  void prepareActivation(const InterfaceConfig& config, int inetAdapterIndex = 0) override;
+
  protected:
   WireguardUtils* wgutils() const override { return m_wgutils; }
   bool supportDnsUtils() const override { return true; }
@@ -28,7 +31,11 @@ class LinuxDaemon final : public Daemon {
   IPUtils* iputils() override { return m_iputils; }
 
  private:
-  WireguardUtilsLinux* m_wgutils = nullptr;
+  // Backend of the current session, the kernel one unless AmneziaWG
+  // parameters are in use or the module is missing.
+  WireguardUtils* m_wgutils = nullptr;
+  WireguardUtilsLinux* m_wgutilsUserspace = nullptr;
+  WireguardUtilsLinuxKernel* m_wgutilsKernel = nullptr;
   DnsUtilsLinux* m_dnsutils = nullptr;
   IPUtilsLinux* m_iputils = nullptr;
 };
@@ -31,7 +31,9 @@
 // along with this file. If not, see <https://www.gnu.org/licenses/>.
 
 #include "linuxfirewall.h"
+#include "firewalltransaction.h"
 #include "logger.h"
+#include "core/networkUtilities.h"
 #include <QProcess>
 
 #define BRAND_CODE "amn"
@@ -49,6 +51,9 @@ const QString enabledKeyTemplate = "enabled:%1:%2";
 const QString disabledKeyTemplate = "disabled:%1:%2";
 const QString kVpnGroupName = BRAND_CODE "vpn";
 QHash<QString, LinuxFirewall::FilterCallbackFunc> anchorCallbacks;
+// Rules currently in the chains we rewrite at run-time, by chain name. A
+// chain without an entry is in an unknown state and gets rebuilt.
+QHash<QString, QStringList> installedRules;
 }
 
 QString LinuxFirewall::kRtableName = QStringLiteral("%1rt").arg(kAnchorName);
@@ -61,33 +66,26 @@ QString LinuxFirewall::kNatTable = QStringLiteral("nat");
 QString LinuxFirewall::kRawTable = QStringLiteral("raw");
 QString LinuxFirewall::kMangleTable = QStringLiteral("mangle");
 
-static QString getCommand(LinuxFirewall::IPVersion ip)
+QList<LinuxFirewall::RootLink> LinuxFirewall::rootLinks()
 {
-    return ip == LinuxFirewall::IPv6 ? QStringLiteral("ip6tables") : QStringLiteral("iptables");
+    return {
+        {kFilterTable, kOutputChain},
+        {kNatTable, kPostRoutingChain},
+        {kMangleTable, kOutputChain},
+        {kRawTable, kPreRoutingChain},
+    };
 }
 
-int LinuxFirewall::createChain(LinuxFirewall::IPVersion ip, const QString& chain, const QString& tableName)
+static QString getCommand(LinuxFirewall::IPVersion ip)
 {
-    if (ip == Both)
-    {
-        int result4 = createChain(IPv4, chain, tableName);
-        int result6 = createChain(IPv6, chain, tableName);
-        return result4 ? result4 : result6;
-    }
-    const QString cmd = getCommand(ip);
-    return execute(QStringLiteral("%1 -N %2 -t %3 || %1 -F %2 -t %3").arg(cmd, chain, tableName));
+    return ip == LinuxFirewall::IPv6 ? QStringLiteral("ip6tables") : QStringLiteral("iptables");
 }
 
-int LinuxFirewall::deleteChain(LinuxFirewall::IPVersion ip, const QString& chain, const QString& tableName)
+static QString ipVersionName(LinuxFirewall::IPVersion ip)
 {
-    if (ip == Both)
-    {
-        int result4 = deleteChain(IPv4, chain, tableName);
-        int result6 = deleteChain(IPv6, chain, tableName);
-        return result4 ? result4 : result6;
-    }
-    const QString cmd = getCommand(ip);
-    return execute(QStringLiteral("if %1 -L %2 -n -t %3 > /dev/null 2> /dev/null ; then %1 -F %2 -t %3 && %1 -X %2 -t %3; fi").arg(cmd, chain, tableName));
+    if (ip == LinuxFirewall::Both)
+        return QStringLiteral("(IPv4, IPv6)");
+    return ip == LinuxFirewall::IPv6 ? QStringLiteral("(IPv6)") : QStringLiteral("(IPv4)");
 }
 
 int LinuxFirewall::linkChain(LinuxFirewall::IPVersion ip, const QString& chain, const QString& parent, bool mustBeFirst, const QString& tableName)
@@ -114,42 +112,22 @@ int LinuxFirewall::linkChain(LinuxFirewall::IPVersion ip, const QString& chain,
         return execute(QStringLiteral("if ! %1 -C %2 -j %3 -t %4 2> /dev/null ; then %1 -A %2 -j %3 -t %4; fi").arg(cmd, parent, chain, tableName));
 }
 
-int LinuxFirewall::unlinkChain(LinuxFirewall::IPVersion ip, const QString& chain, const QString& parent, const QString& tableName)
-{
-    if (ip == Both)
-    {
-        int result4 = unlinkChain(IPv4, chain, parent, tableName);
-        int result6 = unlinkChain(IPv6, chain, parent, tableName);
-        return result4 ? result4 : result6;
-    }
-    const QString cmd = getCommand(ip);
-    return execute(QStringLiteral("if %1 -C %2 -j %3 -t %4 2> /dev/null ; then %1 -D %2 -j %3 -t %4; fi").arg(cmd, parent, chain, tableName));
-}
-
 void LinuxFirewall::ensureRootAnchorPriority(LinuxFirewall::IPVersion ip)
 {
     linkChain(ip, kRootChain, kOutputChain, true);
 }
 
-void LinuxFirewall::installAnchor(LinuxFirewall::IPVersion ip, const QString& anchor, const QStringList& rules, const QString& tableName,
+void LinuxFirewall::installAnchor(FirewallTransaction& tx, LinuxFirewall::IPVersion ip, const QString& anchor, const QStringList& rules, const QString& tableName,
                                      const FilterCallbackFunc& enableFunc, const FilterCallbackFunc& disableFunc)
 {
-    if (ip == Both)
-    {
-        installAnchor(IPv4, anchor, rules, tableName, enableFunc, disableFunc);
-        installAnchor(IPv6, anchor, rules, tableName, enableFunc, disableFunc);
-        return;
-    }
-
-    const QString cmd = getCommand(ip);
     const QString anchorChain = QStringLiteral("%1.a.%2").arg(kAnchorName, anchor);
     const QString actualChain = QStringLiteral("%1.%2").arg(kAnchorName, anchor);
 
     // Start by defining a placeholder chain, which stays locked into place
     // in the root chain without being removed or recreated, ensuring the
     // intended precedence order.
-    createChain(ip, anchorChain, tableName);
-    linkChain(ip, anchorChain, kRootChain, false, tableName);
+    tx.declareChain(ip, tableName, anchorChain);
+    tx.appendRule(ip, tableName, kRootChain, QStringLiteral("-j %1").arg(anchorChain));
 
     if(enableFunc)
     {
@@ -164,27 +142,36 @@ void LinuxFirewall::installAnchor(LinuxFirewall::IPVersion ip, const QString& an
 
     // Create the actual rule chain, which we'll insert or remove from the
     // placeholder anchor when needed.
-    createChain(ip, actualChain, tableName);
+    tx.declareChain(ip, tableName, actualChain);
     for (const QString& rule : rules)
-        execute(QStringLiteral("%1 -A %2 %3 -t %4").arg(cmd, actualChain, rule, tableName));
+        tx.appendRule(ip, tableName, actualChain, rule);
 }
 
-void LinuxFirewall::uninstallAnchor(LinuxFirewall::IPVersion ip, const QString& anchor, const QString& tableName)
+void LinuxFirewall::removeStaleChains(FirewallTransaction& tx)
 {
-    if (ip == Both)
+    const QString rootJump = QStringLiteral("-j %1").arg(kRootChain);
+    const QString chainPrefix = kAnchorName + QLatin1Char('.');
+
+    for (IPVersion ip : {IPv4, IPv6})
     {
-        uninstallAnchor(IPv4, anchor, tableName);
-        uninstallAnchor(IPv6, anchor, tableName);
-        return;
+        for (const RootLink& link : rootLinks())
+        {
+            int count = tx.ruleCount(ip, link.table, link.parent, rootJump);
+            for (int i = 0; i < count; ++i)
+                tx.deleteRule(ip, link.table, link.parent, rootJump);
+        }
+
+        // Anything of ours that the transaction doesn't (re)declare goes away,
+        // this also catches anchors left behind by older versions.
+        for (const QString& table : {kFilterTable, kNatTable, kMangleTable, kRawTable})
+        {
+            for (const QString& chain : tx.existingChains(ip, table))
+            {
+                if (chain.startsWith(chainPrefix) && !tx.declaresChain(ip, table, chain))
+                    tx.deleteChain(ip, table, chain);
+            }
+        }
     }
-
-    const QString cmd = getCommand(ip);
-    const QString anchorChain = QStringLiteral("%1.a.%2").arg(kAnchorName, anchor);
-    const QString actualChain = QStringLiteral("%1.%2").arg(kAnchorName, anchor);
-
-    unlinkChain(ip, anchorChain, kRootChain, tableName);
-    deleteChain(ip, anchorChain, tableName);
-    deleteChain(ip, actualChain, tableName);
 }
 
 QStringList LinuxFirewall::getDNSRules(const QStringList& servers)
@@ -221,35 +208,37 @@ QStringList LinuxFirewall::getBlockRule(const QStringList& servers)
 }
 
 
-void LinuxFirewall::install()
+bool LinuxFirewall::install()
 {
-    // Clean up any existing rules if they exist.
-    uninstall();
-
-    // Create a root filter chain to hold all our other anchors in order.
-    createChain(Both, kRootChain, kFilterTable);
-
-    // Create a root raw chain
-    createChain(Both, kRootChain, kRawTable);
+    // Everything below is queued and applied with one iptables-restore per
+    // address family, existing chains are flushed when declared again.
+    FirewallTransaction tx;
+    // Without the current rules stale chains can't be found, and the root
+    // jumps would be inserted a second time.
+    if (!tx.loadState())
+    {
+        logger.error() << "LinuxFirewall::install() failed to read the current firewall rules";
+        return false;
+    }
 
-    // Create a root NAT chain
-    createChain(Both, kRootChain, kNatTable);
+    teardownTrafficSplitting();
 
-    // Create a root Mangle chain
-    createChain(Both, kRootChain, kMangleTable);
+    // Create a root chain in each table to hold all our other anchors in order.
+    for (const RootLink& link : rootLinks())
+        tx.declareChain(Both, link.table, kRootChain);
 
     // Install our filter rulesets in each corresponding anchor chain.
-    installAnchor(Both, QStringLiteral("000.allowLoopback"), {
+    installAnchor(tx, Both, QStringLiteral("000.allowLoopback"), {
                                                                  QStringLiteral("-o lo+ -j ACCEPT"),
                                                              });
 
-    installAnchor(IPv4, QStringLiteral("320.allowDNS"), {});
+    installAnchor(tx, IPv4, QStringLiteral("320.allowDNS"), {});
 
-    installAnchor(Both, QStringLiteral("310.blockDNS"), {
+    installAnchor(tx, Both, QStringLiteral("310.blockDNS"), {
                                                             QStringLiteral("-p udp --dport 53 -j REJECT"),
                                                             QStringLiteral("-p tcp --dport 53 -j REJECT"),
                                                         });
-    installAnchor(IPv4, QStringLiteral("300.allowLAN"), {
+    installAnchor(tx, IPv4, QStringLiteral("300.allowLAN"), {
                                                             QStringLiteral("-d 10.0.0.0/8 -j ACCEPT"),
                                                             QStringLiteral("-d 169.254.0.0/16 -j ACCEPT"),
                                                             QStringLiteral("-d 172.16.0.0/12 -j ACCEPT"),
@@ -257,37 +246,37 @@ void LinuxFirewall::install()
                                                             QStringLiteral("-d 224.0.0.0/4 -j ACCEPT"),
                                                             QStringLiteral("-d 255.255.255.255/32 -j ACCEPT"),
                                                         });
-    installAnchor(IPv6, QStringLiteral("300.allowLAN"), {
+    installAnchor(tx, IPv6, QStringLiteral("300.allowLAN"), {
                                                             QStringLiteral("-d fc00::/7 -j ACCEPT"),
                                                             QStringLiteral("-d fe80::/10 -j ACCEPT"),
                                                             QStringLiteral("-d ff00::/8 -j ACCEPT"),
                                                         });
 
 
-    installAnchor(IPv4, QStringLiteral("290.allowDHCP"), {
+    installAnchor(tx, IPv4, QStringLiteral("290.allowDHCP"), {
                                                              QStringLiteral("-p udp -d 255.255.255.255 --sport 68 --dport 67 -j ACCEPT"),
                                                          });
-    installAnchor(IPv6, QStringLiteral("290.allowDHCP"), {
+    installAnchor(tx, IPv6, QStringLiteral("290.allowDHCP"), {
                                                              QStringLiteral("-p udp -d ff00::/8 --sport 546 --dport 547 -j ACCEPT"),
                                                          });
-    installAnchor(IPv6, QStringLiteral("250.blockIPv6"), {
+    installAnchor(tx, IPv6, QStringLiteral("250.blockIPv6"), {
                                                              QStringLiteral("! -o lo+ -j REJECT"),
                                                          });
 
-    installAnchor(Both, QStringLiteral("200.allowVPN"), {
+    installAnchor(tx, Both, QStringLiteral("200.allowVPN"), {
                                                             QStringLiteral("-o amn0+ -j ACCEPT"),
                                                             QStringLiteral("-o tun0+ -j ACCEPT"),
                                                         });
 
-    installAnchor(IPv4, QStringLiteral("120.blockNets"), {});
+    installAnchor(tx, IPv4, QStringLiteral("120.blockNets"), {});
 
-    installAnchor(IPv4, QStringLiteral("110.allowNets"), {});
+    installAnchor(tx, IPv4, QStringLiteral("110.allowNets"), {});
 
-    installAnchor(Both, QStringLiteral("100.blockAll"), {
+    installAnchor(tx, Both, QStringLiteral("100.blockAll"), {
                                                             QStringLiteral("-j REJECT"),
                                                         });
     // NAT rules
-    installAnchor(Both, QStringLiteral("100.transIp"), {
+    installAnchor(tx, Both, QStringLiteral("100.transIp"), {
 
                                                            // Only need the original interface, not the IP.
                                                            // The interface should remain much more stable/unchangeable than the IP
@@ -299,77 +288,60 @@ void LinuxFirewall::install()
                                                        }, kNatTable);
 
     // Mangle rules
-    installAnchor(Both, QStringLiteral("100.tagPkts"), {
+    installAnchor(tx, Both, QStringLiteral("100.tagPkts"), {
                                                            QStringLiteral("-m cgroup --cgroup %1 -j MARK --set-mark %2").arg(kCGroupId, kPacketTag)
                                                        }, kMangleTable, setupTrafficSplitting, teardownTrafficSplitting);
 
     // A rule to mitigate CVE-2019-14899 - drop packets addressed to the local
     // VPN IP but that are not actually received on the VPN interface.
     // See here: https://seclists.org/oss-sec/2019/q4/122
-    installAnchor(Both, QStringLiteral("100.vpnTunOnly"), {
+    installAnchor(tx, Both, QStringLiteral("100.vpnTunOnly"), {
                                                               // To be replaced at runtime
                                                               QStringLiteral("-j ACCEPT")
                                                           }, kRawTable);
 
 
-    // Insert our fitler root chain at the top of the OUTPUT chain.
-    linkChain(Both, kRootChain, kOutputChain, true, kFilterTable);
-
-    // Insert our NAT root chain at the top of the POSTROUTING chain.
-    linkChain(Both, kRootChain, kPostRoutingChain, true, kNatTable);
+    // Clean up any existing rules if they exist.
+    removeStaleChains(tx);
 
-    // Insert our Mangle root chain at the top of the OUTPUT chain.
-    linkChain(Both, kRootChain, kOutputChain, true, kMangleTable);
+    // Insert our root chains at the top of the filter and mangle OUTPUT, the
+    // NAT POSTROUTING and the raw PREROUTING chains.
+    for (const RootLink& link : rootLinks())
+        tx.insertRule(Both, link.table, link.parent, QStringLiteral("-j %1").arg(kRootChain));
 
-    // Insert our Raw root chain at the top of the PREROUTING chain.
-    linkChain(Both, kRootChain, kPreRoutingChain, true, kRawTable);
+    // Nothing of the transaction was applied, so there are no chains the
+    // anchors could be enabled in.
+    if (tx.commit() != 0)
+    {
+        logger.error() << "LinuxFirewall::install() failed to create the firewall chains";
+        return false;
+    }
+    installedRules.clear();
 
     setupTrafficSplitting();
+    return true;
 }
 
-void LinuxFirewall::uninstall()
+bool LinuxFirewall::uninstall()
 {
-    // Filter chain
-    unlinkChain(Both, kRootChain, kOutputChain, kFilterTable);
-    deleteChain(Both, kRootChain, kFilterTable);
-
-    // Raw chain
-    unlinkChain(Both, kRootChain, kPreRoutingChain, kRawTable);
-    deleteChain(Both, kRootChain, kRawTable);
-
-    // NAT chain
-    unlinkChain(Both, kRootChain, kPostRoutingChain, kNatTable);
-    deleteChain(Both, kRootChain, kNatTable);
-
-    // Mangle chain
-    unlinkChain(Both, kRootChain, kOutputChain, kMangleTable);
-    deleteChain(Both, kRootChain, kMangleTable);
-
-    // Remove filter anchors
-    uninstallAnchor(Both, QStringLiteral("000.allowLoopback"));
-    uninstallAnchor(Both, QStringLiteral("400.allowPIA"));
-    uninstallAnchor(IPv4, QStringLiteral("320.allowDNS"));
-    uninstallAnchor(Both, QStringLiteral("310.blockDNS"));
-    uninstallAnchor(Both, QStringLiteral("300.allowLAN"));
-    uninstallAnchor(Both, QStringLiteral("290.allowDHCP"));
-    uninstallAnchor(IPv6, QStringLiteral("250.blockIPv6"));
-    uninstallAnchor(Both, QStringLiteral("200.allowVPN"));
-    uninstallAnchor(IPv4, QStringLiteral("120.blockNets"));
-    uninstallAnchor(IPv4, QStringLiteral("110.allowNets"));
-    uninstallAnchor(Both, QStringLiteral("100.blockAll"));
-
-    // Remove Nat anchors
-    uninstallAnchor(Both, QStringLiteral("100.transIp"), kNatTable);
-
-    // Remove Mangle anchors
-    uninstallAnchor(Both, QStringLiteral("100.tagPkts"), kMangleTable);
-
-    // Remove Raw anchors
-    uninstallAnchor(Both, QStringLiteral("100.vpnTunOnly"), kRawTable);
+    FirewallTransaction tx;
+    if (!tx.loadState())
+    {
+        logger.error() << "LinuxFirewall::uninstall() failed to read the current firewall rules";
+        teardownTrafficSplitting();
+        return false;
+    }
+    removeStaleChains(tx);
+    const bool removed = tx.commit() == 0;
+    if (removed)
+        installedRules.clear();
+    else
+        logger.error() << "LinuxFirewall::uninstall() failed to remove the firewall chains";
 
     teardownTrafficSplitting();
 
     logger.debug() << "LinuxFirewall::uninstall() complete";
+    return removed;
 }
 
 bool LinuxFirewall::isInstalled()
@@ -379,16 +351,16 @@ bool LinuxFirewall::isInstalled()
 
 void LinuxFirewall::enableAnchor(LinuxFirewall::IPVersion ip, const QString &anchor, const QString& tableName)
 {
-    if (ip == Both)
-    {
-        enableAnchor(IPv4, anchor, tableName);
-        enableAnchor(IPv6, anchor, tableName);
-        return;
-    }
-    const QString cmd = getCommand(ip);
-    const QString ipStr = ip == IPv6 ? QStringLiteral("(IPv6)") : QStringLiteral("(IPv4)");
+    const QString anchorChain = QStringLiteral("%1.a.%2").arg(kAnchorName, anchor);
+    const QString actualChain = QStringLiteral("%1.%2").arg(kAnchorName, anchor);
 
-    execute(QStringLiteral("if %1 -C %5.a.%2 -j %5.%2 -t %4 2> /dev/null ; then echo '%2%3: ON' ; else echo '%2%3: OFF -> ON' ; %1 -A %5.a.%2 -j %5.%2 -t %4; fi").arg(cmd, anchor, ipStr, tableName, kAnchorName));
+    // The placeholder chain holds nothing but the jump to the actual chain, so
+    // flushing it first makes this idempotent without checking for the rule.
+    FirewallTransaction tx;
+    tx.flushChain(ip, tableName, anchorChain);
+    tx.appendRule(ip, tableName, anchorChain, QStringLiteral("-j %1").arg(actualChain));
+    if (tx.commit() == 0)
+        logger.info() << anchor << ipVersionName(ip) << ": ON";
 }
 
 void LinuxFirewall::replaceAnchor(LinuxFirewall::IPVersion ip, const QString &anchor, const QString &newRule, const QString& tableName)
@@ -407,15 +379,10 @@ void LinuxFirewall::replaceAnchor(LinuxFirewall::IPVersion ip, const QString &an
 
 void LinuxFirewall::disableAnchor(LinuxFirewall::IPVersion ip, const QString &anchor, const QString& tableName)
 {
-    if (ip == Both)
-    {
-        disableAnchor(IPv4, anchor, tableName);
-        disableAnchor(IPv6, anchor, tableName);
-        return;
-    }
-    const QString cmd = getCommand(ip);
-    const QString ipStr = ip == IPv6 ? QStringLiteral("(IPv6)") : QStringLiteral("(IPv4)");
-    execute(QStringLiteral("if ! %1 -C %5.a.%2 -j %5.%2 -t %4 2> /dev/null ; then echo '%2%3: OFF' ; else echo '%2%3: ON -> OFF' ; %1 -F %5.a.%2 -t %4; fi").arg(cmd, anchor, ipStr, tableName, kAnchorName));
+    FirewallTransaction tx;
+    tx.flushChain(ip, tableName, QStringLiteral("%1.a.%2").arg(kAnchorName, anchor));
+    if (tx.commit() == 0)
+        logger.info() << anchor << ipVersionName(ip) << ": OFF";
 }
 
 bool LinuxFirewall::isAnchorEnabled(LinuxFirewall::IPVersion ip, const QString &anchor, const QString& tableName)
@@ -442,32 +409,67 @@ void LinuxFirewall::setAnchorEnabled(LinuxFirewall::IPVersion ip, const QString
 
 void LinuxFirewall::updateDNSServers(const QStringList& servers)
 {
-    static QStringList existingServers {};
-
-    existingServers = servers;
-    execute(QStringLiteral("iptables -F %1.320.allowDNS").arg(kAnchorName));
-    for (const QString& rule : getDNSRules(servers))
-        execute(QStringLiteral("iptables -A %1.320.allowDNS %2").arg(kAnchorName, rule));
+    replaceRules(QStringLiteral("%1.320.allowDNS").arg(kAnchorName), getDNSRules(servers));
 }
 
 void LinuxFirewall::updateAllowNets(const QStringList& servers)
 {
-    static QStringList existingServers {};
-
-    existingServers = servers;
-    execute(QStringLiteral("iptables -F %1.110.allowNets").arg(kAnchorName));
-    for (const QString& rule : getAllowRule(servers))
-        execute(QStringLiteral("iptables -A %1.110.allowNets %2").arg(kAnchorName, rule));
+    replaceRules(QStringLiteral("%1.110.allowNets").arg(kAnchorName), getAllowRule(NetworkUtilities::summarizeRoutes(servers)));
 }
 
 void LinuxFirewall::updateBlockNets(const QStringList& servers)
 {
-    static QStringList existingServers {};
+    replaceRules(QStringLiteral("%1.120.blockNets").arg(kAnchorName), getBlockRule(NetworkUtilities::summarizeRoutes(servers)));
+}
+
+void LinuxFirewall::replaceRules(const QString& chain, const QStringList& rules)
+{
+    FirewallTransaction tx;
+    QStringList wanted;
+    QSet<QString> next;
+    wanted.reserve(rules.size());
+    next.reserve(rules.size());
+    for (const QString& rule : rules)
+    {
+        if (!next.contains(rule))
+        {
+            next.insert(rule);
+            wanted.append(rule);
+        }
+    }
+
+    auto installed = installedRules.constFind(chain);
+    if (installed == installedRules.constEnd())
+    {
+        tx.flushChain(IPv4, kFilterTable, chain);
+        for (const QString& rule : std::as_const(wanted))
+            tx.appendRule(IPv4, kFilterTable, chain, rule);
+    }
+    else
+    {
+        // All rules of a chain share the same target, so their order doesn't
+        // matter and only the difference has to be applied. New rules go in
+        // first so that nothing which stays allowed is ever missing.
+        const QSet<QString> current(installed->cbegin(), installed->cend());
+        for (const QString& rule : std::as_const(wanted))
+        {
+            if (!current.contains(rule))
+                tx.appendRule(IPv4, kFilterTable, chain, rule);
+        }
+        for (const QString& rule : *installed)
+        {
+            if (!next.contains(rule))
+                tx.deleteRule(IPv4, kFilterTable, chain, rule);
+        }
+    }
 
-    existingServers = servers;
-    execute(QStringLiteral("iptables -F %1.120.blockNets").arg(kAnchorName));
-    for (const QString& rule : getBlockRule(servers))
-        execute(QStringLiteral("iptables -A %1.120.blockNets %2").arg(kAnchorName, rule));
+    if (tx.isEmpty())
+        return;
+
+    if (tx.commit() == 0)
+        installedRules[chain] = wanted;
+    else
+        installedRules.remove(chain);
 }
 
 int waitForExitCode(QProcess& process)
@@ -37,6 +37,8 @@
 #include <QString>
 #include <QStringList>
 
+class FirewallTransaction;
+
 // Descriptor for a set of firewall rules to be appled.
 //
 struct FirewallParams
@@ -73,12 +75,12 @@ public:
 public:
     using FilterCallbackFunc = std::function<void()>;
 private:
-    static int createChain(IPVersion ip, const QString& chain, const QString& tableName = kFilterTable);
-    static int deleteChain(IPVersion ip, const QString& chain, const QString& tableName = kFilterTable);
     static int linkChain(IPVersion ip, const QString& chain, const QString& parent, bool mustBeFirst = false, const QString& tableName = kFilterTable);
-    static int unlinkChain(IPVersion ip, const QString& chain, const QString& parent, const QString& tableName = kFilterTable);
-    static void installAnchor(IPVersion ip, const QString& anchor, const QStringList& rules, const QString& tableName = kFilterTable, const FilterCallbackFunc& enableFunc = {}, const FilterCallbackFunc& disableFunc = {});
-    static void uninstallAnchor(IPVersion ip, const QString& anchor, const QString& tableName = kFilterTable);
+    static void installAnchor(FirewallTransaction& tx, IPVersion ip, const QString& anchor, const QStringList& rules, const QString& tableName = kFilterTable, const FilterCallbackFunc& enableFunc = {}, const FilterCallbackFunc& disableFunc = {});
+    static void removeStaleChains(FirewallTransaction& tx);
+    // Brings an IPv4 filter chain to the given rules, applying only the
+    // rules added or removed since the last call.
+    static void replaceRules(const QString& chain, const QStringList& rules);
     static QStringList getDNSRules(const QStringList& servers);
     static QStringList getAllowRule(const QStringList& servers);
     static QStringList getBlockRule(const QStringList& servers);
@@ -89,9 +91,17 @@ private:
     // Chain names
     static QString kOutputChain, kRootChain, kPostRoutingChain, kPreRoutingChain;
 
+    // Built-in chain of each table that jumps to our root chain.
+    struct RootLink
+    {
+        QString table;
+        QString parent;
+    };
+    static QList<RootLink> rootLinks();
+
 public:
-    static void install();
-    static void uninstall();
+    static bool install();
+    static bool uninstall();
     static bool isInstalled();
     static void ensureRootAnchorPriority(IPVersion ip = Both);
     static void enableAnchor(IPVersion ip, const QString& anchor, const QString& tableName = kFilterTable);
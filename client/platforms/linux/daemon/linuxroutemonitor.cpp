@@ -20,9 +20,9 @@
 #include <sys/socket.h>
 
 #include "../utilities.h"
+#include "defaultroutecache.h"
 #include "leakdetector.h"
 #include "logger.h"
-#include "core/networkUtilities.h"
 
 namespace {
 Logger logger("LinuxRouteMonitor");
@@ -71,6 +71,8 @@ LinuxRouteMonitor::LinuxRouteMonitor(const QString& ifname, QObject* parent)
   m_notifier = new QSocketNotifier(m_nlsock, QSocketNotifier::Read, this);
   connect(m_notifier, &QSocketNotifier::activated, this,
           &LinuxRouteMonitor::nlsockReady);
+
+  m_defaultRoute = new DefaultRouteCache(this);
 }
 
 LinuxRouteMonitor::~LinuxRouteMonitor() {
@@ -164,9 +166,18 @@ bool LinuxRouteMonitor::rtmSendRoute(int action, int flags, int type,
     }
 
     if (rtm->rtm_type == RTN_THROW) {
-    struct in_addr ip4;
-    inet_pton(AF_INET, NetworkUtilities::getGatewayAndIface().toUtf8(), &ip4);
-    nlmsg_append_attr(nlmsg, sizeof(buf), RTA_GATEWAY, &ip4, sizeof(ip4));
+    const QHostAddress gateway = m_defaultRoute->gateway(prefix.type());
+    if (gateway.isNull()) {
+        logger.warning() << "No default gateway for exclusion route";
+        return false;
+    }
+    if (prefix.type() == QAbstractSocket::IPv6Protocol) {
+        Q_IPV6ADDR ip6 = gateway.toIPv6Address();
+        nlmsg_append_attr(nlmsg, sizeof(buf), RTA_GATEWAY, &ip6, sizeof(ip6));
+    } else {
+        quint32 ip4 = htonl(gateway.toIPv4Address());
+        nlmsg_append_attr(nlmsg, sizeof(buf), RTA_GATEWAY, &ip4, sizeof(ip4));
+    }
     nlmsg_append_attr32(nlmsg, sizeof(buf), RTA_PRIORITY, 0);
     rtm->rtm_type = RTN_UNICAST;
     }
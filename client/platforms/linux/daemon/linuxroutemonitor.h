@@ -13,6 +13,7 @@
 
 #include "ipaddress.h"
 
+class DefaultRouteCache;
 
 class LinuxRouteMonitor final : public QObject {
   Q_OBJECT
@@ -36,6 +37,7 @@ class LinuxRouteMonitor final : public QObject {
   int m_nlsock = -1;
   int m_nlseq = 0;
   QSocketNotifier* m_notifier = nullptr;
+  DefaultRouteCache* m_defaultRoute = nullptr;
 
  private slots:
     void nlsockReady();
@@ -0,0 +1,162 @@
+#include "uapiparser.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+namespace {
+
+int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+}  // namespace
+
+QHostAddress PeerStats::endpoint() const {
+  if (endpointFamily == AF_INET) {
+    quint32 addr;
+    memcpy(&addr, endpointAddr, sizeof(addr));
+    return QHostAddress(ntohl(addr));
+  }
+  if (endpointFamily == AF_INET6) {
+    return QHostAddress(endpointAddr);
+  }
+  return QHostAddress();
+}
+
+// static
+bool UapiParser::parseHexKey(QByteArrayView value, quint8* key) {
+  if (value.size() != 64) {
+    return false;
+  }
+  for (int i = 0; i < 32; ++i) {
+    const int hi = hexValue(value[2 * i]);
+    const int lo = hexValue(value[2 * i + 1]);
+    if (hi < 0 || lo < 0) {
+      return false;
+    }
+    key[i] = quint8((hi << 4) | lo);
+  }
+  return true;
+}
+
+// static
+bool UapiParser::parseUnsigned(QByteArrayView value, quint64* number) {
+  if (value.isEmpty() || value.size() > 20) {
+    return false;
+  }
+  quint64 result = 0;
+  for (char c : value) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    result = result * 10 + quint64(c - '0');
+  }
+  *number = result;
+  return true;
+}
+
+// static
+bool UapiParser::parseEndpoint(QByteArrayView value, PeerStats& peer) {
+  // Either "1.2.3.4:51820" or "[fd00::1]:51820".
+  const qsizetype colon = value.lastIndexOf(':');
+  if (colon <= 0) {
+    return false;
+  }
+  QByteArrayView host = value.first(colon);
+  quint64 port;
+  if (!parseUnsigned(value.sliced(colon + 1), &port) || port > 0xffff) {
+    return false;
+  }
+
+  int family = AF_INET;
+  if (host.startsWith('[') && host.endsWith(']')) {
+    host = host.sliced(1, host.size() - 2);
+    family = AF_INET6;
+  }
+
+  // inet_pton() wants a terminated string, copy the host to the stack.
+  char buf[INET6_ADDRSTRLEN];
+  if (host.size() >= qsizetype(sizeof(buf))) {
+    return false;
+  }
+  memcpy(buf, host.data(), host.size());
+  buf[host.size()] = '\0';
+  if (inet_pton(family, buf, peer.endpointAddr) != 1) {
+    return false;
+  }
+
+  peer.endpointFamily = family;
+  peer.endpointPort = quint16(port);
+  return true;
+}
+
+// static
+int UapiParser::parsePeers(QByteArrayView reply, QList<PeerStats>& peers) {
+  peers.clear();
+
+  int err = EINVAL;
+  PeerStats* peer = nullptr;
+  const char* pos = reply.data();
+  const char* const end = pos + reply.size();
+
+  while (pos < end) {
+    const char* nl = static_cast<const char*>(memchr(pos, '\n', end - pos));
+    if (!nl) {
+      nl = end;
+    }
+    const QByteArrayView line(pos, nl - pos);
+    pos = nl + 1;
+
+    const qsizetype eq = line.indexOf('=');
+    if (eq <= 0) {
+      continue;
+    }
+    const QByteArrayView key = line.first(eq);
+    const QByteArrayView value = line.sliced(eq + 1);
+
+    if (key == "public_key") {
+      // Every peer section starts with its public key.
+      peer = &peers.emplace_back();
+      if (!parseHexKey(value, peer->publicKey)) {
+        peers.removeLast();
+        peer = nullptr;
+      }
+      continue;
+    }
+    if (key == "errno") {
+      quint64 number;
+      err = parseUnsigned(value, &number) ? int(number) : EINVAL;
+      continue;
+    }
+    if (!peer) {
+      // Interface settings come before the first peer.
+      continue;
+    }
+
+    quint64 number;
+    if (key == "rx_bytes") {
+      if (parseUnsigned(value, &number)) peer->rxBytes = number;
+    } else if (key == "tx_bytes") {
+      if (parseUnsigned(value, &number)) peer->txBytes = number;
+    } else if (key == "last_handshake_time_sec") {
+      if (parseUnsigned(value, &number)) peer->handshakeSec = qint64(number);
+    } else if (key == "last_handshake_time_nsec") {
+      if (parseUnsigned(value, &number)) peer->handshakeNsec = qint64(number);
+    } else if (key == "endpoint") {
+      parseEndpoint(value, *peer);
+    }
+  }
+
+  return err;
+}
@@ -0,0 +1,43 @@
+#ifndef UAPIPARSER_H
+#define UAPIPARSER_H
+
+#include <QByteArrayView>
+#include <QHostAddress>
+#include <QList>
+
+// Per-peer counters of a UAPI "get=1" dump, stored without any heap data so
+// that a list of them can be refilled without allocating.
+struct PeerStats {
+  quint8 publicKey[32] = {};
+  quint64 rxBytes = 0;
+  quint64 txBytes = 0;
+  qint64 handshakeSec = 0;
+  qint64 handshakeNsec = 0;
+
+  // Raw endpoint address in network order, endpointFamily is AF_UNSPEC when
+  // the peer has no endpoint.
+  int endpointFamily = 0;
+  quint8 endpointAddr[16] = {};
+  quint16 endpointPort = 0;
+
+  qint64 handshakeMsec() const {
+    return handshakeSec * 1000 + handshakeNsec / 1000000;
+  }
+  QHostAddress endpoint() const;
+};
+
+class UapiParser final {
+ public:
+  // Parses the reply to "get=1" in a single pass. The peers list is cleared
+  // but keeps its capacity, so polling with the same list does not allocate
+  // once it has grown to the number of peers. Returns the errno of the reply,
+  // EINVAL if it has none.
+  static int parsePeers(QByteArrayView reply, QList<PeerStats>& peers);
+
+ private:
+  static bool parseHexKey(QByteArrayView value, quint8* key);
+  static bool parseUnsigned(QByteArrayView value, quint64* number);
+  static bool parseEndpoint(QByteArrayView value, PeerStats& peer);
+};
+
+#endif  // UAPIPARSER_H
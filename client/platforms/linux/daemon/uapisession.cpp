@@ -0,0 +1,167 @@
+#include "uapisession.h"
+
+#include <QDeadlineTimer>
+#include <QLocalSocket>
+
+#include <errno.h>
+
+#include "leakdetector.h"
+#include "logger.h"
+
+namespace {
+Logger logger("UapiSession");
+
+constexpr int UAPI_CONNECT_TIMEOUT_MSEC = 5000;
+}  // namespace
+
+UapiSession::UapiSession(const QString& socketPath, QObject* parent)
+    : QObject(parent), m_socketPath(socketPath) {
+  MZ_COUNT_CTOR(UapiSession);
+
+  m_socket = new QLocalSocket(this);
+  connect(m_socket, &QLocalSocket::readyRead, this, &UapiSession::readyRead);
+  connect(m_socket, &QLocalSocket::disconnected, this,
+          &UapiSession::disconnected);
+}
+
+UapiSession::~UapiSession() {
+  MZ_COUNT_DTOR(UapiSession);
+  m_socket->disconnect(this);
+  failPending();
+}
+
+bool UapiSession::isConnected() const {
+  return m_socket->state() == QLocalSocket::ConnectedState;
+}
+
+bool UapiSession::ensureConnected(int timeoutMsec) {
+  if (isConnected()) {
+    return true;
+  }
+
+  m_socket->abort();
+  m_socket->connectToServer(m_socketPath, QIODevice::ReadWrite);
+  if (!m_socket->waitForConnected(timeoutMsec)) {
+    logger.error() << "Failed to connect to" << m_socketPath << ":"
+                   << m_socket->errorString();
+    return false;
+  }
+  return true;
+}
+
+bool UapiSession::sendRequest(const QByteArray& request,
+                              const Callback& callback) {
+  if (!ensureConnected(UAPI_CONNECT_TIMEOUT_MSEC)) {
+    return false;
+  }
+
+  // A request ends with an empty line.
+  QByteArray message = request;
+  while (!message.endsWith("\n\n")) {
+    message.append('\n');
+  }
+  if (m_socket->write(message) != message.size()) {
+    logger.error() << "Failed to send UAPI request:" << m_socket->errorString();
+    return false;
+  }
+
+  m_pending.append(callback);
+  return true;
+}
+
+QByteArray UapiSession::request(const QByteArray& request, int timeoutMsec) {
+  QDeadlineTimer deadline(timeoutMsec);
+
+  QByteArray reply;
+  bool done = false;
+  if (!sendRequest(request, [&](const QByteArray& data) {
+        reply = data;
+        done = true;
+      })) {
+    return QByteArray();
+  }
+
+  m_socket->flush();
+  while (!done) {
+    if (deadline.hasExpired() ||
+        !m_socket->waitForReadyRead(deadline.remainingTime())) {
+      if (done) {
+        break;
+      }
+      // Later replies can't be matched to their requests anymore, start
+      // over with a new connection on the next request.
+      logger.error() << "UAPI request timed out";
+      failPending();
+      m_socket->abort();
+      return QByteArray();
+    }
+  }
+  return reply;
+}
+
+void UapiSession::readyRead() {
+  m_buffer.append(m_socket->readAll());
+  processReplies();
+}
+
+void UapiSession::processReplies() {
+  while (!m_pending.isEmpty()) {
+    // Only look at what arrived since the last scan, backing up by one byte
+    // in case the first newline of the terminator was already seen.
+    const qsizetype end = m_buffer.indexOf("\n\n", qMax<qsizetype>(0, m_scanned - 1));
+    if (end < 0) {
+      m_scanned = m_buffer.size();
+      return;
+    }
+
+    // Consume the reply before running the callback, which may send the
+    // next request and wait for it.
+    const QByteArray reply = m_buffer.left(end + 1);
+    m_buffer.remove(0, end + 2);
+    m_scanned = 0;
+
+    const Callback callback = m_pending.takeFirst();
+    if (callback) {
+      callback(reply);
+    }
+  }
+
+  if (!m_buffer.isEmpty()) {
+    logger.warning() << "Dropping unexpected UAPI data";
+    m_buffer.clear();
+    m_scanned = 0;
+  }
+}
+
+void UapiSession::disconnected() {
+  logger.debug() << "UAPI connection closed";
+  failPending();
+}
+
+void UapiSession::failPending() {
+  m_buffer.clear();
+  m_scanned = 0;
+
+  QList<Callback> pending;
+  pending.swap(m_pending);
+  for (const Callback& callback : pending) {
+    if (callback) {
+      callback(QByteArray());
+    }
+  }
+}
+
+// static
+int UapiSession::replyErrno(const QByteArray& reply) {
+  // The errno line is the last line of every reply.
+  qsizetype pos = reply.lastIndexOf("errno=");
+  if (pos < 0 || (pos > 0 && reply.at(pos - 1) != '\n')) {
+    return EINVAL;
+  }
+  pos += 6;
+
+  bool ok = false;
+  qsizetype end = reply.indexOf('\n', pos);
+  int err = reply.mid(pos, end < 0 ? -1 : end - pos).toInt(&ok);
+  return ok ? err : EINVAL;
+}
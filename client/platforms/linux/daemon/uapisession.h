@@ -0,0 +1,60 @@
+#ifndef UAPISESSION_H
+#define UAPISESSION_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+#include <functional>
+
+class QLocalSocket;
+
+// A long-lived connection to the wireguard-go UAPI socket. wireguard-go
+// serves any number of operations on one connection, so requests are
+// pipelined and matched to their replies in order. Every reply ends with an
+// "errno=" line followed by an empty line. The connection is re-established
+// on the next request after it was lost.
+class UapiSession final : public QObject {
+  Q_OBJECT
+
+ public:
+  // Called with the reply without its terminating empty line, or with an
+  // empty buffer if the connection was lost before the reply arrived.
+  using Callback = std::function<void(const QByteArray& reply)>;
+
+  explicit UapiSession(const QString& socketPath, QObject* parent = nullptr);
+  ~UapiSession();
+
+  bool isConnected() const;
+
+  // Queues a request without waiting for the reply.
+  bool sendRequest(const QByteArray& request, const Callback& callback = {});
+
+  // Sends a request and blocks until its reply arrived. Replies to requests
+  // queued before are dispatched to their callbacks on the way.
+  QByteArray request(const QByteArray& request, int timeoutMsec);
+
+  // Extracts the errno value from a reply, EINVAL if there is none.
+  static int replyErrno(const QByteArray& reply);
+
+ private slots:
+  void readyRead();
+  void disconnected();
+
+ private:
+  bool ensureConnected(int timeoutMsec);
+  void processReplies();
+  void failPending();
+
+  QString m_socketPath;
+  QLocalSocket* m_socket = nullptr;
+
+  QByteArray m_buffer;
+  // Start of the not yet scanned part of m_buffer.
+  qsizetype m_scanned = 0;
+
+  QList<Callback> m_pending;
+};
+
+#endif  // UAPISESSION_H
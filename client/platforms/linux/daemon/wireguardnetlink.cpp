@@ -0,0 +1,402 @@
+#include "wireguardnetlink.h"
+
+#include <arpa/inet.h>
+#include <linux/genetlink.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/wireguard.h>
+#include <netinet/in.h>
+#include <string.h>
+
+namespace {
+
+constexpr const char* WG_KIND = "wireguard";
+
+// Builds one netlink message in place, attributes are padded to NLA_ALIGNTO.
+class NetlinkMessage {
+ public:
+  NetlinkMessage(quint16 type, quint16 flags, quint32 seq) {
+    struct nlmsghdr nh;
+    memset(&nh, 0, sizeof(nh));
+    nh.nlmsg_type = type;
+    nh.nlmsg_flags = flags;
+    nh.nlmsg_seq = seq;
+    append(&nh, sizeof(nh));
+  }
+
+  void appendGenlHeader(quint8 cmd, quint8 version) {
+    struct genlmsghdr genl;
+    memset(&genl, 0, sizeof(genl));
+    genl.cmd = cmd;
+    genl.version = version;
+    append(&genl, sizeof(genl));
+  }
+
+  void append(const void* data, size_t len) {
+    m_buffer.append(static_cast<const char*>(data), len);
+    m_buffer.append(NLMSG_ALIGN(len) - len, '\0');
+  }
+
+  void put(quint16 type, const void* data, size_t len) {
+    struct nlattr attr;
+    attr.nla_len = NLA_HDRLEN + len;
+    attr.nla_type = type;
+    append(&attr, sizeof(attr));
+    append(data, len);
+  }
+  void putU8(quint16 type, quint8 value) { put(type, &value, sizeof(value)); }
+  void putU16(quint16 type, quint16 value) {
+    put(type, &value, sizeof(value));
+  }
+  void putU32(quint16 type, quint32 value) {
+    put(type, &value, sizeof(value));
+  }
+  void putString(quint16 type, const QString& value) {
+    QByteArray data = value.toLocal8Bit();
+    put(type, data.constData(), data.size() + 1);
+  }
+
+  qsizetype beginNest(quint16 type) {
+    qsizetype offset = m_buffer.size();
+    struct nlattr attr;
+    attr.nla_len = 0;
+    attr.nla_type = NLA_F_NESTED | type;
+    append(&attr, sizeof(attr));
+    return offset;
+  }
+  void endNest(qsizetype offset) {
+    quint16 len = quint16(m_buffer.size() - offset);
+    memcpy(m_buffer.data() + offset, &len, sizeof(len));
+  }
+
+  qsizetype size() const { return m_buffer.size(); }
+
+  QByteArray finish() {
+    quint32 len = quint32(m_buffer.size());
+    memcpy(m_buffer.data(), &len, sizeof(len));
+    return m_buffer;
+  }
+
+ private:
+  QByteArray m_buffer;
+};
+
+// Iterates the attributes in [data, data + len).
+template <typename F>
+bool forEachAttr(const char* data, size_t len, F&& func) {
+  while (len >= NLA_HDRLEN) {
+    struct nlattr attr;
+    memcpy(&attr, data, sizeof(attr));
+    if (attr.nla_len < NLA_HDRLEN || attr.nla_len > len) {
+      return false;
+    }
+    if (!func(attr.nla_type & NLA_TYPE_MASK, data + NLA_HDRLEN,
+              size_t(attr.nla_len - NLA_HDRLEN))) {
+      return false;
+    }
+    const size_t step = NLA_ALIGN(attr.nla_len);
+    if (step >= len) {
+      break;
+    }
+    data += step;
+    len -= step;
+  }
+  return true;
+}
+
+template <typename T>
+T readValue(const char* data, size_t len) {
+  T value = 0;
+  memcpy(&value, data, qMin(len, sizeof(T)));
+  return value;
+}
+
+void putSockaddr(NetlinkMessage& msg, quint16 type,
+                 const QHostAddress& address, quint16 port) {
+  if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    sin.sin_addr.s_addr = htonl(address.toIPv4Address());
+    msg.put(type, &sin, sizeof(sin));
+  } else if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+    struct sockaddr_in6 sin6;
+    memset(&sin6, 0, sizeof(sin6));
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_port = htons(port);
+    Q_IPV6ADDR raw = address.toIPv6Address();
+    memcpy(&sin6.sin6_addr, &raw, sizeof(raw));
+    msg.put(type, &sin6, sizeof(sin6));
+  }
+}
+
+void putAllowedIP(NetlinkMessage& msg, const IPAddress& ip) {
+  const QHostAddress& address = ip.address();
+  qsizetype nest = msg.beginNest(0);
+  if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+    quint32 raw = htonl(address.toIPv4Address());
+    msg.putU16(WGALLOWEDIP_A_FAMILY, AF_INET);
+    msg.put(WGALLOWEDIP_A_IPADDR, &raw, sizeof(raw));
+  } else {
+    Q_IPV6ADDR raw = address.toIPv6Address();
+    msg.putU16(WGALLOWEDIP_A_FAMILY, AF_INET6);
+    msg.put(WGALLOWEDIP_A_IPADDR, &raw, sizeof(raw));
+  }
+  msg.putU8(WGALLOWEDIP_A_CIDR_MASK, quint8(ip.prefixLength()));
+  msg.endNest(nest);
+}
+
+void parseEndpoint(const char* data, size_t len, PeerStats& peer) {
+  sa_family_t family = 0;
+  if (len < sizeof(family)) {
+    return;
+  }
+  memcpy(&family, data, sizeof(family));
+  if (family == AF_INET && len >= sizeof(struct sockaddr_in)) {
+    struct sockaddr_in sin;
+    memcpy(&sin, data, sizeof(sin));
+    peer.endpointFamily = AF_INET;
+    memcpy(peer.endpointAddr, &sin.sin_addr, sizeof(sin.sin_addr));
+    peer.endpointPort = ntohs(sin.sin_port);
+  } else if (family == AF_INET6 && len >= sizeof(struct sockaddr_in6)) {
+    struct sockaddr_in6 sin6;
+    memcpy(&sin6, data, sizeof(sin6));
+    peer.endpointFamily = AF_INET6;
+    memcpy(peer.endpointAddr, &sin6.sin6_addr, sizeof(sin6.sin6_addr));
+    peer.endpointPort = ntohs(sin6.sin6_port);
+  }
+}
+
+}  // namespace
+
+// static
+QByteArray WireguardNetlink::getFamilyRequest(quint32 seq) {
+  NetlinkMessage msg(GENL_ID_CTRL, NLM_F_REQUEST | NLM_F_ACK, seq);
+  msg.appendGenlHeader(CTRL_CMD_GETFAMILY, 1);
+  msg.put(CTRL_ATTR_FAMILY_NAME, WG_GENL_NAME, strlen(WG_GENL_NAME) + 1);
+  return msg.finish();
+}
+
+// static
+int WireguardNetlink::parseFamilyReply(const char* buf, size_t len) {
+  int remaining = int(len);
+  for (const struct nlmsghdr* nh = reinterpret_cast<const struct nlmsghdr*>(buf);
+       NLMSG_OK(nh, remaining); nh = NLMSG_NEXT(nh, remaining)) {
+    if (nh->nlmsg_type != GENL_ID_CTRL ||
+        nh->nlmsg_len < NLMSG_LENGTH(GENL_HDRLEN)) {
+      continue;
+    }
+    const char* attrs =
+        static_cast<const char*>(NLMSG_DATA(nh)) + GENL_HDRLEN;
+    const size_t attrlen = nh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+
+    int family = -1;
+    forEachAttr(attrs, attrlen, [&](quint16 type, const char* data, size_t size) {
+      if (type == CTRL_ATTR_FAMILY_ID && size >= sizeof(quint16)) {
+        family = readValue<quint16>(data, size);
+      }
+      return true;
+    });
+    if (family >= 0) {
+      return family;
+    }
+  }
+  return -1;
+}
+
+// static
+QByteArray WireguardNetlink::newLinkRequest(quint32 seq,
+                                            const QString& ifname) {
+  NetlinkMessage msg(RTM_NEWLINK,
+                     NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE | NLM_F_EXCL,
+                     seq);
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  ifi.ifi_family = AF_UNSPEC;
+  msg.append(&ifi, sizeof(ifi));
+  msg.putString(IFLA_IFNAME, ifname);
+  qsizetype nest = msg.beginNest(IFLA_LINKINFO);
+  msg.put(IFLA_INFO_KIND, WG_KIND, strlen(WG_KIND));
+  msg.endNest(nest);
+  return msg.finish();
+}
+
+// static
+QByteArray WireguardNetlink::deleteLinkRequest(quint32 seq,
+                                               const QString& ifname) {
+  NetlinkMessage msg(RTM_DELLINK, NLM_F_REQUEST | NLM_F_ACK, seq);
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  ifi.ifi_family = AF_UNSPEC;
+  msg.append(&ifi, sizeof(ifi));
+  msg.putString(IFLA_IFNAME, ifname);
+  return msg.finish();
+}
+
+// static
+QByteArray WireguardNetlink::setDeviceRequest(quint16 family, quint32 seq,
+                                              const QString& ifname,
+                                              const QByteArray& privateKey) {
+  NetlinkMessage msg(family, NLM_F_REQUEST | NLM_F_ACK, seq);
+  msg.appendGenlHeader(WG_CMD_SET_DEVICE, WG_GENL_VERSION);
+  msg.putString(WGDEVICE_A_IFNAME, ifname);
+  msg.put(WGDEVICE_A_PRIVATE_KEY, privateKey.constData(), privateKey.size());
+  msg.putU32(WGDEVICE_A_FLAGS, WGDEVICE_F_REPLACE_PEERS);
+  return msg.finish();
+}
+
+// static
+QList<QByteArray> WireguardNetlink::setPeerRequests(quint16 family,
+                                                    quint32 seq,
+                                                    const QString& ifname,
+                                                    const Peer& peer) {
+  QList<QByteArray> requests;
+  qsizetype next = 0;
+  do {
+    NetlinkMessage msg(family, NLM_F_REQUEST | NLM_F_ACK, seq++);
+    msg.appendGenlHeader(WG_CMD_SET_DEVICE, WG_GENL_VERSION);
+    msg.putString(WGDEVICE_A_IFNAME, ifname);
+
+    qsizetype peers = msg.beginNest(WGDEVICE_A_PEERS);
+    qsizetype entry = msg.beginNest(0);
+    msg.put(WGPEER_A_PUBLIC_KEY, peer.publicKey.constData(),
+            peer.publicKey.size());
+
+    if (peer.remove) {
+      msg.putU32(WGPEER_A_FLAGS, WGPEER_F_REMOVE_ME);
+    } else if (next == 0) {
+      // The peer settings only go into the first message.
+      msg.putU32(WGPEER_A_FLAGS, WGPEER_F_REPLACE_ALLOWEDIPS);
+      if (!peer.presharedKey.isEmpty()) {
+        msg.put(WGPEER_A_PRESHARED_KEY, peer.presharedKey.constData(),
+                peer.presharedKey.size());
+      }
+      putSockaddr(msg, WGPEER_A_ENDPOINT, peer.endpointAddress,
+                  peer.endpointPort);
+      msg.putU16(WGPEER_A_PERSISTENT_KEEPALIVE_INTERVAL, peer.keepalive);
+    }
+
+    if (!peer.remove) {
+      const qsizetype last =
+          qMin(next + MAX_ALLOWED_IPS_PER_MESSAGE, peer.allowedIPs.size());
+      qsizetype ips = msg.beginNest(WGPEER_A_ALLOWEDIPS);
+      for (; next < last; ++next) {
+        putAllowedIP(msg, peer.allowedIPs.at(next));
+      }
+      msg.endNest(ips);
+    }
+
+    msg.endNest(entry);
+    msg.endNest(peers);
+    requests.append(msg.finish());
+  } while (!peer.remove && next < peer.allowedIPs.size());
+
+  return requests;
+}
+
+// static
+QByteArray WireguardNetlink::getDeviceRequest(quint16 family, quint32 seq,
+                                              const QString& ifname) {
+  NetlinkMessage msg(family, NLM_F_REQUEST | NLM_F_ACK | NLM_F_DUMP, seq);
+  msg.appendGenlHeader(WG_CMD_GET_DEVICE, WG_GENL_VERSION);
+  msg.putString(WGDEVICE_A_IFNAME, ifname);
+  return msg.finish();
+}
+
+// static
+bool WireguardNetlink::parseDeviceReply(quint16 family, const char* buf,
+                                        size_t len, QList<PeerStats>& peers) {
+  int remaining = int(len);
+  for (const struct nlmsghdr* nh = reinterpret_cast<const struct nlmsghdr*>(buf);
+       NLMSG_OK(nh, remaining); nh = NLMSG_NEXT(nh, remaining)) {
+    if (nh->nlmsg_type != family) {
+      continue;
+    }
+    if (nh->nlmsg_len < NLMSG_LENGTH(GENL_HDRLEN)) {
+      return false;
+    }
+
+    const char* attrs =
+        static_cast<const char*>(NLMSG_DATA(nh)) + GENL_HDRLEN;
+    const size_t attrlen = nh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+
+    auto parsePeer = [&](quint16, const char* data, size_t size) {
+      PeerStats peer;
+      bool hasKey = false;
+      bool ok = forEachAttr(data, size, [&](quint16 type, const char* value,
+                                            size_t valueLen) {
+        switch (type) {
+          case WGPEER_A_PUBLIC_KEY:
+            if (valueLen != sizeof(peer.publicKey)) {
+              return false;
+            }
+            memcpy(peer.publicKey, value, valueLen);
+            hasKey = true;
+            break;
+          case WGPEER_A_RX_BYTES:
+            peer.rxBytes = readValue<quint64>(value, valueLen);
+            break;
+          case WGPEER_A_TX_BYTES:
+            peer.txBytes = readValue<quint64>(value, valueLen);
+            break;
+          case WGPEER_A_LAST_HANDSHAKE_TIME:
+            if (valueLen >= 2 * sizeof(qint64)) {
+              peer.handshakeSec = readValue<qint64>(value, sizeof(qint64));
+              peer.handshakeNsec =
+                  readValue<qint64>(value + sizeof(qint64), sizeof(qint64));
+            }
+            break;
+          case WGPEER_A_ENDPOINT:
+            parseEndpoint(value, valueLen, peer);
+            break;
+          default:
+            break;
+        }
+        return true;
+      });
+      if (!ok || !hasKey) {
+        return false;
+      }
+
+      // A peer with many allowed IPs continues in the next message, only the
+      // first part carries the statistics.
+      if (!peers.isEmpty() &&
+          memcmp(peers.last().publicKey, peer.publicKey,
+                 sizeof(peer.publicKey)) == 0) {
+        return true;
+      }
+      peers.append(peer);
+      return true;
+    };
+
+    bool ok = forEachAttr(attrs, attrlen,
+                          [&](quint16 type, const char* data, size_t size) {
+                            if (type != WGDEVICE_A_PEERS) {
+                              return true;
+                            }
+                            return forEachAttr(data, size, parsePeer);
+                          });
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// static
+int WireguardNetlink::parseAck(const char* buf, size_t len, quint32 seq) {
+  int remaining = int(len);
+  for (const struct nlmsghdr* nh = reinterpret_cast<const struct nlmsghdr*>(buf);
+       NLMSG_OK(nh, remaining); nh = NLMSG_NEXT(nh, remaining)) {
+    if (nh->nlmsg_type != NLMSG_ERROR || nh->nlmsg_seq != seq ||
+        nh->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+      continue;
+    }
+    const struct nlmsgerr* err =
+        static_cast<const struct nlmsgerr*>(NLMSG_DATA(nh));
+    return -err->error;
+  }
+  return -1;
+}
@@ -0,0 +1,66 @@
+#ifndef WIREGUARDNETLINK_H
+#define WIREGUARDNETLINK_H
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QList>
+#include <QString>
+
+#include "ipaddress.h"
+#include "uapiparser.h"
+
+// Encoding and decoding of the messages spoken with the in-kernel WireGuard
+// module: the "wireguard" generic netlink family and the rtnetlink requests
+// creating and removing its links. Everything here is pure buffer work, the
+// sockets live in WireguardUtilsLinuxKernel.
+class WireguardNetlink final {
+ public:
+  struct Peer {
+    // Raw 32 byte keys, an empty preshared key is left unset.
+    QByteArray publicKey;
+    QByteArray presharedKey;
+    QHostAddress endpointAddress;
+    quint16 endpointPort = 0;
+    quint16 keepalive = 0;
+    QList<IPAddress> allowedIPs;
+    bool remove = false;
+  };
+
+  // Allowed IPs per message, longer lists are split over several requests.
+  static constexpr int MAX_ALLOWED_IPS_PER_MESSAGE = 512;
+
+  // CTRL_CMD_GETFAMILY for the "wireguard" family, and the family id from
+  // its reply or -1.
+  static QByteArray getFamilyRequest(quint32 seq);
+  static int parseFamilyReply(const char* buf, size_t len);
+
+  // RTM_NEWLINK/RTM_DELLINK for a link of kind "wireguard".
+  static QByteArray newLinkRequest(quint32 seq, const QString& ifname);
+  static QByteArray deleteLinkRequest(quint32 seq, const QString& ifname);
+
+  // WG_CMD_SET_DEVICE setting the private key and dropping all peers.
+  static QByteArray setDeviceRequest(quint16 family, quint32 seq,
+                                     const QString& ifname,
+                                     const QByteArray& privateKey);
+
+  // WG_CMD_SET_DEVICE for one peer. The first message replaces the allowed
+  // IPs, the following ones append the rest of them.
+  static QList<QByteArray> setPeerRequests(quint16 family, quint32 seq,
+                                           const QString& ifname,
+                                           const Peer& peer);
+
+  // WG_CMD_GET_DEVICE dump request.
+  static QByteArray getDeviceRequest(quint16 family, quint32 seq,
+                                     const QString& ifname);
+
+  // Appends the peers of one WG_CMD_GET_DEVICE reply buffer to the list. A
+  // peer split over several messages is merged into one entry. Returns false
+  // on malformed input.
+  static bool parseDeviceReply(quint16 family, const char* buf, size_t len,
+                               QList<PeerStats>& peers);
+
+  // Error code of an NLMSG_ERROR message, 0 for an ack.
+  static int parseAck(const char* buf, size_t len, quint32 seq);
+};
+
+#endif  // WIREGUARDNETLINK_H
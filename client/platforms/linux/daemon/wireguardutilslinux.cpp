@@ -14,6 +14,8 @@
 #include <QThread>
 
 #include "linuxfirewall.h"
+#include "uapiparser.h"
+#include "uapisession.h"
 #include "leakdetector.h"
 #include "logger.h"
 
@@ -96,6 +98,9 @@ bool WireguardUtilsLinux::addInterface(const InterfaceConfig& config) {
     // Start the routing table monitor.
     m_rtmonitor = new LinuxRouteMonitor(m_ifname, this);
 
+    // Keep one UAPI connection open for the lifetime of the interface.
+    m_uapi = new UapiSession(wgRuntimeDir.filePath(m_ifname + ".sock"), this);
+
     // Send a UAPI command to configure the interface
     QString message("set=1\n");
     QByteArray privateKey = QByteArray::fromBase64(config.m_privateKey.toUtf8());
@@ -135,26 +140,8 @@ bool WireguardUtilsLinux::addInterface(const InterfaceConfig& config) {
     int err = uapiErrno(uapiCommand(message));
     if (err != 0) {
         logger.error() << "Interface configuration failed:" << strerror(err);
-    } else {
-        if (config.m_killSwitchEnabled) {
-            FirewallParams params { };
-            params.dnsServers.append(config.m_dnsServer);
-            if (config.m_allowedIPAddressRanges.contains(IPAddress("0.0.0.0/0"))) {
-                params.blockAll = true;
-                if (config.m_excludedAddresses.size()) {
-                    params.allowNets = true;
-                    foreach (auto net, config.m_excludedAddresses) {
-                        params.allowAddrs.append(net.toUtf8());
-                    }
-                }
-            } else {
-                params.blockNets = true;
-                foreach (auto net, config.m_allowedIPAddressRanges) {
-                    params.blockAddrs.append(net.toString());
-                }
-            }
-            applyFirewallRules(params);
-        }
+    } else if (config.m_killSwitchEnabled) {
+        applyKillSwitch(config);
     }
 
     return (err == 0);
@@ -165,6 +152,10 @@ bool WireguardUtilsLinux::deleteInterface() {
         delete m_rtmonitor;
         m_rtmonitor = nullptr;
     }
+    if (m_uapi) {
+        delete m_uapi;
+        m_uapi = nullptr;
+    }
 
     if (m_tunnel.state() == QProcess::NotRunning) {
         return false;
@@ -258,50 +249,67 @@ bool WireguardUtilsLinux::deletePeer(const InterfaceConfig& config) {
 }
 
 QList<WireguardUtils::PeerStatus> WireguardUtilsLinux::getPeerStatus() {
-    QString reply = uapiCommand("get=1");
-    PeerStatus status;
-    QList<PeerStatus> peerList;
-    for (const QString& line : reply.split('\n')) {
-        int eq = line.indexOf('=');
-        if (eq <= 0) {
-            continue;
-        }
-        QString name = line.left(eq);
-        QString value = line.mid(eq + 1);
-
-        if (name == "public_key") {
-            if (!status.m_pubkey.isEmpty()) {
-                peerList.append(status);
-            }
-            QByteArray pubkey = QByteArray::fromHex(value.toUtf8());
-            status = PeerStatus(pubkey.toBase64());
-        }
+    if (!m_uapi) {
+        return QList<PeerStatus>();
+    }
 
-        if (name == "tx_bytes") {
-            status.m_txBytes = value.toDouble();
-        }
-        if (name == "rx_bytes") {
-            status.m_rxBytes = value.toDouble();
-        }
-        if (name == "last_handshake_time_sec") {
-            status.m_handshake += value.toLongLong() * 1000;
-        }
-        if (name == "last_handshake_time_nsec") {
-            status.m_handshake += value.toLongLong() / 1000000;
-        }
+    QByteArray reply = m_uapi->request("get=1", WG_TUN_PROC_TIMEOUT);
+    int err = UapiParser::parsePeers(reply, m_peerStats);
+    if (err != 0) {
+        logger.warning() << "Peer status query failed:" << strerror(err);
     }
-    if (!status.m_pubkey.isEmpty()) {
+
+    return peerStatusList(m_peerStats);
+}
+
+// static
+QList<WireguardUtils::PeerStatus> WireguardUtilsLinux::peerStatusList(
+    const QList<PeerStats>& stats) {
+    QList<PeerStatus> peerList;
+    peerList.reserve(stats.size());
+    for (const PeerStats& peer : stats) {
+        QByteArray pubkey(reinterpret_cast<const char*>(peer.publicKey),
+                          sizeof(peer.publicKey));
+        PeerStatus status(pubkey.toBase64());
+        status.m_rxBytes = qint64(peer.rxBytes);
+        status.m_txBytes = qint64(peer.txBytes);
+        status.m_handshake = peer.handshakeMsec();
         peerList.append(status);
     }
-
     return peerList;
 }
 
 
+// static
+void WireguardUtilsLinux::applyKillSwitch(const InterfaceConfig& config)
+{
+    FirewallParams params { };
+    params.dnsServers.append(config.m_dnsServer);
+    if (config.m_allowedIPAddressRanges.contains(IPAddress("0.0.0.0/0"))) {
+        params.blockAll = true;
+        if (config.m_excludedAddresses.size()) {
+            params.allowNets = true;
+            foreach (auto net, config.m_excludedAddresses) {
+                params.allowAddrs.append(net.toUtf8());
+            }
+        }
+    } else {
+        params.blockNets = true;
+        foreach (auto net, config.m_allowedIPAddressRanges) {
+            params.blockAddrs.append(net.toString());
+        }
+    }
+    applyFirewallRules(params);
+}
+
+// static
 void WireguardUtilsLinux::applyFirewallRules(FirewallParams& params)
 {
     // double-check + ensure our firewall is installed and enabled
-    if (!LinuxFirewall::isInstalled()) LinuxFirewall::install();
+    if (!LinuxFirewall::isInstalled() && !LinuxFirewall::install()) {
+        logger.error() << "Firewall is not installed, rules not applied";
+        return;
+    }
 
     // Note: rule precedence is handled inside IpTablesFirewall
     LinuxFirewall::ensureRootAnchorPriority();
@@ -319,7 +327,6 @@ void WireguardUtilsLinux::applyFirewallRules(FirewallParams& params)
     LinuxFirewall::setAnchorEnabled(LinuxFirewall::IPv4, QStringLiteral("310.blockDNS"), true);
     LinuxFirewall::updateDNSServers(params.dnsServers);
     LinuxFirewall::setAnchorEnabled(LinuxFirewall::IPv4, QStringLiteral("320.allowDNS"), true);
-    LinuxFirewall::setAnchorEnabled(LinuxFirewall::Both, QStringLiteral("400.allowPIA"), true);
 }
 
 bool WireguardUtilsLinux::updateRoutePrefix(const IPAddress& prefix) {
@@ -378,38 +385,12 @@ bool WireguardUtilsLinux::deleteExclusionRoute(const IPAddress& prefix) {
 }
 
 QString WireguardUtilsLinux::uapiCommand(const QString& command) {
-    QLocalSocket socket;
-    QTimer uapiTimeout;
-    QDir wgRuntimeDir(WG_RUNTIME_DIR);
-    QString wgSocketFile = wgRuntimeDir.filePath(m_ifname + ".sock");
-
-    uapiTimeout.setSingleShot(true);
-    uapiTimeout.start(WG_TUN_PROC_TIMEOUT);
-
-    socket.connectToServer(wgSocketFile, QIODevice::ReadWrite);
-    if (!socket.waitForConnected(WG_TUN_PROC_TIMEOUT)) {
-        logger.error() << "QLocalSocket::waitForConnected() failed:"
-                       << socket.errorString();
+    if (!m_uapi) {
+        logger.error() << "UAPI command without an interface";
         return QString();
     }
 
-    // Send the message to the UAPI socket.
-    QByteArray message = command.toLocal8Bit();
-    while (!message.endsWith("\n\n")) {
-        message.append('\n');
-    }
-    socket.write(message);
-
-    QByteArray reply;
-    while (!reply.contains("\n\n")) {
-        if (!uapiTimeout.isActive()) {
-            logger.error() << "UAPI command timed out";
-            return QString();
-        }
-        QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
-        reply.append(socket.readAll());
-    }
-
+    QByteArray reply = m_uapi->request(command.toLocal8Bit(), WG_TUN_PROC_TIMEOUT);
     return QString::fromUtf8(reply).trimmed();
 }
 
@@ -12,7 +12,9 @@
 #include "daemon/wireguardutils.h"
 #include "linuxroutemonitor.h"
 #include "linuxfirewall.h"
+#include "uapiparser.h"
 
+class UapiSession;
 
 class WireguardUtilsLinux final : public WireguardUtils {
     Q_OBJECT
@@ -37,7 +39,10 @@ public:
 
     bool addExclusionRoute(const IPAddress& prefix) override;
     bool deleteExclusionRoute(const IPAddress& prefix) override;
-    void applyFirewallRules(FirewallParams& params);
+    static void applyFirewallRules(FirewallParams& params);
+    // Shared with WireguardUtilsLinuxKernel.
+    static void applyKillSwitch(const InterfaceConfig& config);
+    static QList<PeerStatus> peerStatusList(const QList<PeerStats>& stats);
 signals:
     void backendFailure();
 
@@ -53,6 +58,9 @@ private:
     QString m_ifname;
     QProcess m_tunnel;
     LinuxRouteMonitor* m_rtmonitor = nullptr;
+    UapiSession* m_uapi = nullptr;
+    // Reused between status polls to avoid reallocating.
+    QList<PeerStats> m_peerStats;
 };
 
 #endif  // WIREGUARDUTILSLINUX_H
@@ -0,0 +1,386 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wireguardutilslinuxkernel.h"
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <net/if.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "leakdetector.h"
+#include "linuxfirewall.h"
+#include "logger.h"
+#include "wireguardnetlink.h"
+#include "wireguardutilslinux.h"
+
+namespace {
+Logger logger("WireguardUtilsLinuxKernel");
+
+constexpr int NETLINK_TIMEOUT_SEC = 5;
+// Large enough for the biggest dump message the kernel sends.
+constexpr int NETLINK_RECV_SIZE = 32768;
+
+// Family id of the "wireguard" generic netlink family, -2 until resolved.
+int s_family = -2;
+}  // namespace
+
+WireguardUtilsLinuxKernel::WireguardUtilsLinuxKernel(QObject* parent)
+    : WireguardUtils(parent), m_ifname(WG_INTERFACE) {
+    MZ_COUNT_CTOR(WireguardUtilsLinuxKernel);
+    m_recvbuf.resize(NETLINK_RECV_SIZE);
+}
+
+WireguardUtilsLinuxKernel::~WireguardUtilsLinuxKernel() {
+    MZ_COUNT_DTOR(WireguardUtilsLinuxKernel);
+    if (m_genlsock >= 0) {
+        close(m_genlsock);
+    }
+}
+
+// static
+int WireguardUtilsLinuxKernel::openSocket(int protocol) {
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, protocol);
+    if (sock < 0) {
+        logger.warning() << "Failed to create netlink socket:" << strerror(errno);
+        return -1;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = NETLINK_TIMEOUT_SEC;
+    tv.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_nl nladdr;
+    memset(&nladdr, 0, sizeof(nladdr));
+    nladdr.nl_family = AF_NETLINK;
+    if (bind(sock, (struct sockaddr*)&nladdr, sizeof(nladdr)) != 0) {
+        logger.warning() << "Failed to bind netlink socket:" << strerror(errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// static
+int WireguardUtilsLinuxKernel::resolveFamily() {
+    if (s_family != -2) {
+        return s_family;
+    }
+    s_family = -1;
+
+    int sock = openSocket(NETLINK_GENERIC);
+    if (sock < 0) {
+        return s_family;
+    }
+
+    // Asking for the family loads the wireguard module if needed.
+    QByteArray message = WireguardNetlink::getFamilyRequest(1);
+    if (send(sock, message.constData(), message.size(), 0) < 0) {
+        logger.warning() << "Failed to query the wireguard family:"
+                         << strerror(errno);
+    } else {
+        char buf[4096];
+        ssize_t len = recv(sock, buf, sizeof(buf), 0);
+        if (len > 0) {
+            s_family = WireguardNetlink::parseFamilyReply(buf, len);
+        }
+    }
+    close(sock);
+
+    logger.debug() << "Kernel WireGuard family:" << s_family;
+    return s_family;
+}
+
+// static
+bool WireguardUtilsLinuxKernel::isSupported() { return resolveFamily() >= 0; }
+
+// static
+bool WireguardUtilsLinuxKernel::needsUserspace(const InterfaceConfig& config) {
+    // Values which leave the protocol identical to plain WireGuard.
+    auto isDefault = [](const QString& value, int plain) {
+        return value.isEmpty() || value.toLongLong() == plain;
+    };
+    return !isDefault(config.m_junkPacketCount, 0) ||
+           !isDefault(config.m_junkPacketMinSize, 0) ||
+           !isDefault(config.m_junkPacketMaxSize, 0) ||
+           !isDefault(config.m_initPacketJunkSize, 0) ||
+           !isDefault(config.m_responsePacketJunkSize, 0) ||
+           !isDefault(config.m_initPacketMagicHeader, 1) ||
+           !isDefault(config.m_responsePacketMagicHeader, 2) ||
+           !isDefault(config.m_underloadPacketMagicHeader, 3) ||
+           !isDefault(config.m_transportPacketMagicHeader, 4);
+}
+
+int WireguardUtilsLinuxKernel::request(int sock, const QByteArray& message) {
+    struct nlmsghdr nh;
+    memcpy(&nh, message.constData(), sizeof(nh));
+
+    if (send(sock, message.constData(), message.size(), 0) < 0) {
+        return errno;
+    }
+
+    for (;;) {
+        ssize_t len = recv(sock, m_recvbuf.data(), m_recvbuf.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        int err = WireguardNetlink::parseAck(m_recvbuf.constData(), len,
+                                             nh.nlmsg_seq);
+        if (err >= 0) {
+            return err;
+        }
+    }
+}
+
+bool WireguardUtilsLinuxKernel::genlRequest(const QByteArray& message) {
+    int err = request(m_genlsock, message);
+    if (err != 0) {
+        logger.error() << "WireGuard netlink request failed:" << strerror(err);
+    }
+    return err == 0;
+}
+
+bool WireguardUtilsLinuxKernel::rtnlRequest(const QByteArray& message) {
+    int sock = openSocket(NETLINK_ROUTE);
+    if (sock < 0) {
+        return false;
+    }
+    int err = request(sock, message);
+    close(sock);
+    if (err != 0) {
+        logger.error() << "Link request failed:" << strerror(err);
+    }
+    return err == 0;
+}
+
+bool WireguardUtilsLinuxKernel::interfaceExists() {
+    return m_genlsock >= 0 && if_nametoindex(qPrintable(m_ifname)) != 0;
+}
+
+bool WireguardUtilsLinuxKernel::addInterface(const InterfaceConfig& config) {
+    if (m_genlsock >= 0) {
+        logger.warning() << "Unable to start: interface already exists";
+        return false;
+    }
+
+    m_family = resolveFamily();
+    if (m_family < 0) {
+        logger.error() << "Kernel WireGuard is not available";
+        return false;
+    }
+
+    // Remove a link left behind by an earlier run.
+    if (if_nametoindex(qPrintable(m_ifname)) != 0) {
+        rtnlRequest(WireguardNetlink::deleteLinkRequest(++m_nlseq, m_ifname));
+    }
+    if (!rtnlRequest(WireguardNetlink::newLinkRequest(++m_nlseq, m_ifname))) {
+        return false;
+    }
+
+    m_genlsock = openSocket(NETLINK_GENERIC);
+    if (m_genlsock < 0) {
+        rtnlRequest(WireguardNetlink::deleteLinkRequest(++m_nlseq, m_ifname));
+        return false;
+    }
+    logger.debug() << "Created kernel wireguard interface" << m_ifname;
+
+    // Start the routing table monitor.
+    m_rtmonitor = new LinuxRouteMonitor(m_ifname, this);
+
+    QByteArray privateKey = QByteArray::fromBase64(config.m_privateKey.toUtf8());
+    if (!genlRequest(WireguardNetlink::setDeviceRequest(
+            m_family, ++m_nlseq, m_ifname, privateKey))) {
+        logger.error() << "Interface configuration failed";
+        return false;
+    }
+
+    if (config.m_killSwitchEnabled) {
+        WireguardUtilsLinux::applyKillSwitch(config);
+    }
+    return true;
+}
+
+bool WireguardUtilsLinuxKernel::deleteInterface() {
+    if (m_rtmonitor) {
+        delete m_rtmonitor;
+        m_rtmonitor = nullptr;
+    }
+
+    if (m_genlsock < 0) {
+        return false;
+    }
+    close(m_genlsock);
+    m_genlsock = -1;
+
+    rtnlRequest(WireguardNetlink::deleteLinkRequest(++m_nlseq, m_ifname));
+
+    // double-check + ensure our firewall is installed and enabled
+    LinuxFirewall::uninstall();
+    return true;
+}
+
+bool WireguardUtilsLinuxKernel::updatePeer(const InterfaceConfig& config) {
+    WireguardNetlink::Peer peer;
+    peer.publicKey = QByteArray::fromBase64(qPrintable(config.m_serverPublicKey));
+    if (!config.m_serverPskKey.isNull()) {
+        peer.presharedKey = QByteArray::fromBase64(qPrintable(config.m_serverPskKey));
+    }
+
+    logger.debug() << "Configuring peer" << config.m_serverPublicKey << "via" << config.m_serverIpv4AddrIn;
+
+    if (!config.m_serverIpv4AddrIn.isNull()) {
+        peer.endpointAddress = QHostAddress(config.m_serverIpv4AddrIn);
+    } else if (!config.m_serverIpv6AddrIn.isNull()) {
+        peer.endpointAddress = QHostAddress(config.m_serverIpv6AddrIn);
+    } else {
+        logger.warning() << "Failed to create peer with no endpoints";
+        return false;
+    }
+    peer.endpointPort = quint16(config.m_serverPort);
+    peer.keepalive = WG_KEEPALIVE_PERIOD;
+    peer.allowedIPs = config.m_allowedIPAddressRanges;
+
+    // Exclude the server address, except for multihop exit servers.
+    if ((config.m_hopType != InterfaceConfig::MultiHopExit) &&
+        (m_rtmonitor != nullptr)) {
+        m_rtmonitor->addExclusionRoute(IPAddress(config.m_serverIpv4AddrIn));
+        m_rtmonitor->addExclusionRoute(IPAddress(config.m_serverIpv6AddrIn));
+    }
+
+    const QList<QByteArray> requests =
+        WireguardNetlink::setPeerRequests(m_family, m_nlseq + 1, m_ifname, peer);
+    m_nlseq += requests.size();
+    for (const QByteArray& message : requests) {
+        if (!genlRequest(message)) {
+            logger.error() << "Peer configuration failed";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WireguardUtilsLinuxKernel::deletePeer(const InterfaceConfig& config) {
+    // Clear exclustion routes for this peer.
+    if ((config.m_hopType != InterfaceConfig::MultiHopExit) &&
+        (m_rtmonitor != nullptr)) {
+        m_rtmonitor->deleteExclusionRoute(IPAddress(config.m_serverIpv4AddrIn));
+        m_rtmonitor->deleteExclusionRoute(IPAddress(config.m_serverIpv6AddrIn));
+    }
+
+    WireguardNetlink::Peer peer;
+    peer.publicKey = QByteArray::fromBase64(qPrintable(config.m_serverPublicKey));
+    peer.remove = true;
+
+    const QList<QByteArray> requests =
+        WireguardNetlink::setPeerRequests(m_family, ++m_nlseq, m_ifname, peer);
+    if (!genlRequest(requests.first())) {
+        logger.error() << "Peer deletion failed";
+        return false;
+    }
+    return true;
+}
+
+QList<WireguardUtils::PeerStatus> WireguardUtilsLinuxKernel::getPeerStatus() {
+    m_peerStats.clear();
+    if (m_genlsock < 0) {
+        return QList<PeerStatus>();
+    }
+
+    const quint32 seq = ++m_nlseq;
+    QByteArray message = WireguardNetlink::getDeviceRequest(m_family, seq, m_ifname);
+    if (send(m_genlsock, message.constData(), message.size(), 0) < 0) {
+        logger.warning() << "Peer status query failed:" << strerror(errno);
+        return QList<PeerStatus>();
+    }
+
+    bool done = false;
+    while (!done) {
+        ssize_t len = recv(m_genlsock, m_recvbuf.data(), m_recvbuf.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logger.warning() << "Peer status query failed:" << strerror(errno);
+            break;
+        }
+
+        int remaining = int(len);
+        for (const struct nlmsghdr* nh =
+                 reinterpret_cast<const struct nlmsghdr*>(m_recvbuf.constData());
+             NLMSG_OK(nh, remaining); nh = NLMSG_NEXT(nh, remaining)) {
+            if (nh->nlmsg_seq == seq && (nh->nlmsg_type == NLMSG_DONE ||
+                                         nh->nlmsg_type == NLMSG_ERROR)) {
+                done = true;
+            }
+        }
+        if (!WireguardNetlink::parseDeviceReply(m_family, m_recvbuf.constData(),
+                                                len, m_peerStats)) {
+            logger.warning() << "Malformed peer status reply";
+        }
+    }
+
+    return WireguardUtilsLinux::peerStatusList(m_peerStats);
+}
+
+bool WireguardUtilsLinuxKernel::updateRoutePrefix(const IPAddress& prefix) {
+    if (!m_rtmonitor) {
+        return false;
+    }
+    if (prefix.prefixLength() > 0) {
+        return m_rtmonitor->insertRoute(prefix);
+    }
+
+    // Ensure that we do not replace the default route.
+    if (prefix.type() == QAbstractSocket::IPv4Protocol) {
+        return m_rtmonitor->insertRoute(IPAddress("0.0.0.0/1")) &&
+               m_rtmonitor->insertRoute(IPAddress("128.0.0.0/1"));
+    }
+    if (prefix.type() == QAbstractSocket::IPv6Protocol) {
+        return m_rtmonitor->insertRoute(IPAddress("::/1")) &&
+               m_rtmonitor->insertRoute(IPAddress("8000::/1"));
+    }
+
+    return false;
+}
+
+bool WireguardUtilsLinuxKernel::deleteRoutePrefix(const IPAddress& prefix) {
+    if (!m_rtmonitor) {
+        return false;
+    }
+    if (prefix.prefixLength() > 0) {
+        return m_rtmonitor->deleteRoute(prefix);
+    }
+
+    // Ensure that we do not replace the default route.
+    if (prefix.type() == QAbstractSocket::IPv4Protocol) {
+        return m_rtmonitor->deleteRoute(IPAddress("0.0.0.0/1")) &&
+               m_rtmonitor->deleteRoute(IPAddress("128.0.0.0/1"));
+    } else if (prefix.type() == QAbstractSocket::IPv6Protocol) {
+        return m_rtmonitor->deleteRoute(IPAddress("::/1")) &&
+               m_rtmonitor->deleteRoute(IPAddress("8000::/1"));
+    } else {
+        return false;
+    }
+}
+
+bool WireguardUtilsLinuxKernel::addExclusionRoute(const IPAddress& prefix) {
+    if (!m_rtmonitor) {
+        return false;
+    }
+    return m_rtmonitor->addExclusionRoute(prefix);
+}
+
+bool WireguardUtilsLinuxKernel::deleteExclusionRoute(const IPAddress& prefix) {
+    if (!m_rtmonitor) {
+        return false;
+    }
+    return m_rtmonitor->deleteExclusionRoute(prefix);
+}
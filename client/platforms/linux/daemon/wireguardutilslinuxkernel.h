@@ -0,0 +1,60 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef WIREGUARDUTILSLINUXKERNEL_H
+#define WIREGUARDUTILSLINUXKERNEL_H
+
+#include <QObject>
+
+#include "daemon/wireguardutils.h"
+#include "linuxroutemonitor.h"
+#include "uapiparser.h"
+
+// WireGuard backend driving the in-kernel module over generic netlink
+// instead of a wireguard-go process. The kernel does not implement the
+// AmneziaWG obfuscation, configurations using it need WireguardUtilsLinux.
+class WireguardUtilsLinuxKernel final : public WireguardUtils {
+    Q_OBJECT
+
+public:
+    WireguardUtilsLinuxKernel(QObject* parent);
+    ~WireguardUtilsLinuxKernel();
+
+    // Whether the kernel provides the "wireguard" generic netlink family.
+    static bool isSupported();
+    // Whether the configuration uses AmneziaWG parameters.
+    static bool needsUserspace(const InterfaceConfig& config);
+
+    bool interfaceExists() override;
+    QString interfaceName() override { return m_ifname; }
+    bool addInterface(const InterfaceConfig& config) override;
+    bool deleteInterface() override;
+
+    bool updatePeer(const InterfaceConfig& config) override;
+    bool deletePeer(const InterfaceConfig& config) override;
+    QList<PeerStatus> getPeerStatus() override;
+
+    bool updateRoutePrefix(const IPAddress& prefix) override;
+    bool deleteRoutePrefix(const IPAddress& prefix) override;
+
+    bool addExclusionRoute(const IPAddress& prefix) override;
+    bool deleteExclusionRoute(const IPAddress& prefix) override;
+
+private:
+    static int resolveFamily();
+    static int openSocket(int protocol);
+    int request(int sock, const QByteArray& message);
+    bool genlRequest(const QByteArray& message);
+    bool rtnlRequest(const QByteArray& message);
+
+    QString m_ifname;
+    int m_genlsock = -1;
+    int m_family = -1;
+    quint32 m_nlseq = 0;
+    QByteArray m_recvbuf;
+    QList<PeerStats> m_peerStats;
+    LinuxRouteMonitor* m_rtmonitor = nullptr;
+};
+
+#endif  // WIREGUARDUTILSLINUXKERNEL_H
@@ -0,0 +1,201 @@
+#include "rotatinglogfile.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QMap>
+
+namespace
+{
+    const char *SEGMENT_STAMP_FORMAT = "yyyyMMdd-hhmmss-zzz";
+    const char *ARCHIVE_SUFFIX = ".z";
+    constexpr qint64 COPY_CHUNK_SIZE = 64 * 1024;
+
+    // Segment names keyed by timestamp, so the map is in chronological order.
+    QMap<QString, QString> segmentsByStamp(const QString &fileName)
+    {
+        const QFileInfo info(fileName);
+        const QString prefix = info.completeBaseName() + ".";
+        const QString suffix = "." + info.suffix();
+
+        QMap<QString, QString> result;
+        const QStringList names = info.dir().entryList({ prefix + "*" + suffix, prefix + "*" + suffix + ARCHIVE_SUFFIX },
+                                                       QDir::Files, QDir::Name);
+        for (const QString &name : names) {
+            const bool archived = name.endsWith(ARCHIVE_SUFFIX);
+            QString stamp = name.mid(prefix.size());
+            stamp.chop(suffix.size() + (archived ? qstrlen(ARCHIVE_SUFFIX) : 0));
+
+            // Prefer the plain file while its archive is being written.
+            if (!archived || !result.contains(stamp)) {
+                result.insert(stamp, info.dir().filePath(name));
+            }
+        }
+        return result;
+    }
+
+    bool copyFile(QFile &file, QIODevice *out)
+    {
+        while (!file.atEnd()) {
+            const QByteArray chunk = file.read(COPY_CHUNK_SIZE);
+            if (chunk.isEmpty() || out->write(chunk) != chunk.size()) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+RotatingLogFile::RotatingLogFile(qint64 maxSize, int maxSegments) : m_maxSize(maxSize), m_maxSegments(maxSegments)
+{
+    m_archiver.setMaxThreadCount(1);
+}
+
+RotatingLogFile::~RotatingLogFile()
+{
+    close();
+}
+
+bool RotatingLogFile::open(const QString &fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::Append)) {
+        return false;
+    }
+    m_file.setTextModeEnabled(true);
+
+    // An existing file belongs to the day it was last written.
+    const QFileInfo info(m_file);
+    m_size = m_file.size();
+    m_date = m_size > 0 ? info.lastModified().date() : QDate::currentDate();
+    return true;
+}
+
+void RotatingLogFile::close()
+{
+    m_file.close();
+    m_archiver.waitForDone();
+}
+
+qint64 RotatingLogFile::write(const QByteArray &data)
+{
+    if (m_size > 0 && (m_size + data.size() > m_maxSize || QDate::currentDate() != m_date)) {
+        rotate();
+    }
+
+    const qint64 written = m_file.write(data);
+    if (written > 0) {
+        m_size += written;
+    }
+    return written;
+}
+
+bool RotatingLogFile::flush()
+{
+    return m_file.flush();
+}
+
+void RotatingLogFile::rotate()
+{
+    const QString fileName = m_file.fileName();
+    const QFileInfo info(fileName);
+    const QString segment = info.dir().filePath(QString("%1.%2.%3").arg(
+            info.completeBaseName(), QDateTime::currentDateTime().toString(SEGMENT_STAMP_FORMAT), info.suffix()));
+
+    m_file.close();
+    if (!QFile::rename(fileName, segment)) {
+        // Keep appending to the old file rather than losing records.
+        m_file.open(QIODevice::Append);
+        m_file.setTextModeEnabled(true);
+        m_date = QDate::currentDate();
+        return;
+    }
+
+    m_file.open(QIODevice::Append);
+    m_file.setTextModeEnabled(true);
+    m_size = 0;
+    m_date = QDate::currentDate();
+
+    const int maxSegments = m_maxSegments;
+    m_archiver.start([segment, fileName, maxSegments]() { archive(segment, fileName, maxSegments); });
+}
+
+// static
+void RotatingLogFile::archive(const QString &segment, const QString &fileName, int maxSegments)
+{
+    QFile plain(segment);
+    if (plain.open(QIODevice::ReadOnly)) {
+        const QString archiveName = segment + ARCHIVE_SUFFIX;
+        QFile archive(archiveName + ".tmp");
+        if (archive.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            const bool ok = archive.write(qCompress(plain.readAll())) >= 0;
+            archive.close();
+            plain.close();
+            // The plain file goes away only once the archive is complete.
+            if (ok && archive.rename(archiveName)) {
+                QFile::remove(segment);
+            } else {
+                archive.remove();
+            }
+        }
+    }
+
+    const QStringList all = segments(fileName);
+    for (int i = 0; i < all.size() - maxSegments; ++i) {
+        QFile::remove(all.at(i));
+    }
+}
+
+// static
+QStringList RotatingLogFile::segments(const QString &fileName)
+{
+    return segmentsByStamp(fileName).values();
+}
+
+// static
+bool RotatingLogFile::exportTo(const QString &fileName, QIODevice *out)
+{
+    for (const QString &segment : segments(fileName)) {
+        QFile file(segment);
+        if (!file.open(QIODevice::ReadOnly)) {
+            // Archived meanwhile, read the compressed copy instead.
+            file.setFileName(segment + ARCHIVE_SUFFIX);
+            if (!file.open(QIODevice::ReadOnly)) {
+                continue;
+            }
+        }
+
+        if (file.fileName().endsWith(ARCHIVE_SUFFIX)) {
+            const QByteArray data = qUncompress(file.readAll());
+            if (out->write(data) != data.size()) {
+                return false;
+            }
+        } else if (!copyFile(file, out)) {
+            return false;
+        }
+    }
+
+    QFile live(fileName);
+    if (!live.open(QIODevice::ReadOnly)) {
+        return true;
+    }
+    return copyFile(live, out);
+}
+
+// static
+void RotatingLogFile::remove(const QString &fileName)
+{
+    const QFileInfo info(fileName);
+    const QString prefix = info.completeBaseName() + ".*." + info.suffix();
+    const QStringList names = info.dir().entryList({ prefix, prefix + ARCHIVE_SUFFIX, prefix + ARCHIVE_SUFFIX + ".tmp" },
+                                                   QDir::Files);
+    for (const QString &name : names) {
+        QFile::remove(info.dir().filePath(name));
+    }
+
+    QFile file(fileName);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.close();
+    }
+}
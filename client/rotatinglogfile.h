@@ -0,0 +1,58 @@
+#ifndef ROTATINGLOGFILE_H
+#define ROTATINGLOGFILE_H
+
+#include <QDate>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+class QIODevice;
+
+// Log file that rolls over once it grows past a size limit or a day
+// boundary. A closed segment is renamed to <name>.<timestamp>.log and
+// compressed in the background to <name>.<timestamp>.log.z, only the most
+// recent segments are kept.
+class RotatingLogFile
+{
+public:
+    static constexpr qint64 DEFAULT_MAX_SIZE = 10 * 1024 * 1024;
+    static constexpr int DEFAULT_MAX_SEGMENTS = 5;
+
+    explicit RotatingLogFile(qint64 maxSize = DEFAULT_MAX_SIZE, int maxSegments = DEFAULT_MAX_SEGMENTS);
+    ~RotatingLogFile();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+    QString fileName() const { return m_file.fileName(); }
+
+    // Only one thread may write at a time.
+    qint64 write(const QByteArray &data);
+    bool flush();
+
+    // Closed segments of the log, oldest first. A segment still being
+    // compressed is listed under its uncompressed name.
+    static QStringList segments(const QString &fileName);
+    // Copies all segments and then the live file into out, one segment at a
+    // time.
+    static bool exportTo(const QString &fileName, QIODevice *out);
+    // Deletes all segments and truncates the live file.
+    static void remove(const QString &fileName);
+
+private:
+    void rotate();
+    static void archive(const QString &segment, const QString &fileName, int maxSegments);
+
+    QFile m_file;
+    qint64 m_size = 0;
+    QDate m_date;
+
+    const qint64 m_maxSize;
+    const int m_maxSegments;
+
+    // Single thread, so archiving and pruning never race each other.
+    QThreadPool m_archiver;
+};
+
+#endif // ROTATINGLOGFILE_H
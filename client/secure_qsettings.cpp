@@ -11,34 +11,74 @@
 #include <QJsonObject>
 #include <QRandomGenerator>
 #include <QSharedPointer>
+#include <QThread>
 #include <QTimer>
 
+#if defined(Q_OS_WIN)
+    #include <windows.h>
+#elif defined(Q_OS_UNIX)
+    #include <sys/mman.h>
+#endif
+
 using namespace QKeychain;
 
+namespace
+{
+    // Keeps the key material out of swap, best effort.
+    void lockMemory(const QByteArray &data)
+    {
+        if (data.isEmpty()) {
+            return;
+        }
+#if defined(Q_OS_WIN)
+        VirtualLock(const_cast<char *>(data.constData()), data.size());
+#elif defined(Q_OS_UNIX)
+        mlock(data.constData(), data.size());
+#endif
+    }
+}
+
 SecureQSettings::SecureQSettings(const QString &organization, const QString &application, QObject *parent)
-    : QObject { parent }, m_settings(organization, application, parent), encryptedKeys({ "Servers/serversList" })
+    : QObject { parent },
+      m_settings(organization, application, parent),
+      encryptedKeys({ "Servers/serversList" }),
+      encryptedKeyPrefixes({ "Servers/server/" })
 {
+    m_syncTimer.setSingleShot(true);
+    m_syncTimer.setInterval(SYNC_DELAY_MSEC);
+    connect(&m_syncTimer, &QTimer::timeout, this, &SecureQSettings::sync);
+
     bool encrypted = m_settings.value("Conf/encrypted").toBool();
 
     // convert settings to encrypted for if updated to >= 2.1.0
     if (encryptionRequired() && !encrypted) {
         for (const QString &key : m_settings.allKeys()) {
-            if (encryptedKeys.contains(key)) {
+            if (isEncryptedKey(key)) {
                 const QVariant &val = value(key);
                 setValue(key, val);
             }
         }
         m_settings.setValue("Conf/encrypted", true);
-        m_settings.sync();
+        sync();
     }
 }
 
+SecureQSettings::~SecureQSettings()
+{
+    sync();
+}
+
 QVariant SecureQSettings::value(const QString &key, const QVariant &defaultValue) const
 {
     QMutexLocker locker(&mutex);
 
-    if (m_cache.contains(key)) {
-        return m_cache.value(key);
+    auto pending = m_pending.constFind(key);
+    if (pending != m_pending.constEnd()) {
+        return pending.value();
+    }
+
+    if (const QVariant *cached = m_cache.object(key)) {
+        return *cached;
     }
 
     if (!m_settings.contains(key))
@@ -73,7 +113,7 @@ QVariant SecureQSettings::value(const QString &key, const QVariant &defaultValue
         retVal = QVariant();
     }
 
-    m_cache.insert(key, retVal);
+    m_cache.insert(key, new QVariant(retVal));
     return retVal;
 }
 
@@ -81,8 +121,23 @@ void SecureQSettings::setValue(const QString &key, const QVariant &value)
 {
     QMutexLocker locker(&mutex);
 
-    if (encryptionRequired() && encryptedKeys.contains(key)) {
-        if (!getEncKey().isEmpty() && !getEncIv().isEmpty()) {
+    if (encryptionRequired() && isEncryptedKey(key) && (getEncKey().isEmpty() || getEncIv().isEmpty())) {
+        qCritical() << "SecureQSettings::setValue Encryption required, but key is empty";
+        return;
+    }
+
+    m_pending.insert(key, value);
+    m_cache.remove(key);
+    scheduleSync();
+}
+
+void SecureQSettings::writePending()
+{
+    for (auto it = m_pending.constBegin(); it != m_pending.constEnd(); ++it) {
+        const QString &key = it.key();
+        const QVariant &value = it.value();
+
+        if (encryptionRequired() && isEncryptedKey(key)) {
             QByteArray decryptedValue;
             {
                 QDataStream ds(&decryptedValue, QIODevice::WriteOnly);
@@ -92,30 +147,53 @@ void SecureQSettings::setValue(const QString &key, const QVariant &value)
             QByteArray encryptedValue = encryptText(decryptedValue);
             m_settings.setValue(key, magicString + encryptedValue);
         } else {
-            qCritical() << "SecureQSettings::setValue Encryption required, but key is empty";
-            return;
+            m_settings.setValue(key, value);
         }
 
+        m_cache.insert(key, new QVariant(value));
+    }
+    m_pending.clear();
+}
+
+// A timer that fires with nothing pending just syncs again, so sync() never
+// needs to stop it.
+void SecureQSettings::scheduleSync()
+{
+    if (QThread::currentThread() == m_syncTimer.thread()) {
+        m_syncTimer.start();
     } else {
-        m_settings.setValue(key, value);
+        QMetaObject::invokeMethod(&m_syncTimer, qOverload<>(&QTimer::start), Qt::QueuedConnection);
     }
+}
 
-    m_cache.insert(key, value);
-    sync();
+bool SecureQSettings::isEncryptedKey(const QString &key) const
+{
+    if (encryptedKeys.contains(key)) {
+        return true;
+    }
+    for (const QString &prefix : encryptedKeyPrefixes) {
+        if (key.startsWith(prefix)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void SecureQSettings::remove(const QString &key)
 {
     QMutexLocker locker(&mutex);
 
+    m_pending.remove(key);
     m_settings.remove(key);
     m_cache.remove(key);
 
-    sync();
+    scheduleSync();
 }
 
 void SecureQSettings::sync()
 {
+    QMutexLocker locker(&mutex);
+    writePending();
     m_settings.sync();
 }
 
@@ -140,7 +218,17 @@ QByteArray SecureQSettings::backupAppConfig() const
       return false;
     };
 
-    for (const QString &key : m_settings.allKeys()) {
+    QStringList keys = m_settings.allKeys();
+    {
+        QMutexLocker locker(&mutex);
+        for (const QString &key : m_pending.keys()) {
+            if (!keys.contains(key)) {
+                keys.append(key);
+            }
+        }
+    }
+
+    for (const QString &key : keys) {
 
         if (!needToBackup(key))
         {
@@ -194,6 +282,10 @@ bool SecureQSettings::encryptionRequired() const
 
 QByteArray SecureQSettings::getEncKey() const
 {
+    if (!m_key.isEmpty()) {
+        return m_key;
+    }
+
     // load keys from system key storage
     m_key = getSecTag(settingsKeyTag);
 
@@ -211,15 +303,21 @@ QByteArray SecureQSettings::getEncKey() const
         m_key = getSecTag(settingsKeyTag);
         if (key != m_key) {
             qCritical() << "SecureQSettings::getEncKey Unable to store key in keychain" << key.size() << m_key.size();
+            m_key.clear();
             return {};
         }
     }
 
+    lockMemory(m_key);
     return m_key;
 }
 
 QByteArray SecureQSettings::getEncIv() const
 {
+    if (!m_iv.isEmpty()) {
+        return m_iv;
+    }
+
     // load keys from system key storage
     m_iv = getSecTag(settingsIvTag);
 
@@ -236,10 +334,12 @@ QByteArray SecureQSettings::getEncIv() const
         m_iv = getSecTag(settingsIvTag);
         if (iv != m_iv) {
             qCritical() << "SecureQSettings::getEncIv Unable to store IV in keychain" << iv.size() << m_iv.size();
+            m_iv.clear();
             return {};
         }
     }
 
+    lockMemory(m_iv);
     return m_iv;
 }
 
@@ -280,7 +380,8 @@ void SecureQSettings::setSecTag(const QString &tag, const QByteArray &data)
 void SecureQSettings::clearSettings()
 {
     QMutexLocker locker(&mutex);
+    m_pending.clear();
     m_settings.clear();
     m_cache.clear();
-    sync();
+    m_settings.sync();
 }
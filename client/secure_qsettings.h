@@ -1,10 +1,12 @@
 #ifndef SECUREQSETTINGS_H
 #define SECUREQSETTINGS_H
 
+#include <QCache>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QObject>
 #include <QSettings>
+#include <QTimer>
 
 #include "keychain.h"
 
@@ -12,17 +14,27 @@ constexpr const char *settingsKeyTag = "settingsKeyTag";
 constexpr const char *settingsIvTag = "settingsIvTag";
 constexpr const char *keyChainName = "AmneziaVPN-Keychain";
 
+// Writes are buffered and reach QSettings, encrypted where required, at
+// most SYNC_DELAY_MSEC later or on sync(); several writes to a key in that
+// window cost one encryption and one disk sync. The keychain key and IV are
+// read once per process and kept in locked memory, recently read values are
+// kept decrypted.
 class SecureQSettings : public QObject
 {
     Q_OBJECT
 
 public:
+    static constexpr int SYNC_DELAY_MSEC = 200;
+    static constexpr int VALUE_CACHE_SIZE = 256;
+
     explicit SecureQSettings(const QString &organization, const QString &application = QString(),
                              QObject *parent = nullptr);
+    ~SecureQSettings();
 
     Q_INVOKABLE QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
     Q_INVOKABLE void setValue(const QString &key, const QVariant &value);
-    void remove(const QString &key);
+    Q_INVOKABLE void remove(const QString &key);
+    // Writes the buffered values and syncs QSettings now.
     void sync();
 
     QByteArray backupAppConfig() const;
@@ -42,11 +54,21 @@ public:
     void clearSettings();
 
 private:
+    bool isEncryptedKey(const QString &key) const;
+    // Both expect the mutex to be held.
+    void writePending();
+    void scheduleSync();
+
     QSettings m_settings;
 
-    mutable QMap<QString, QVariant> m_cache;
+    // Written values not yet handed to m_settings.
+    QMap<QString, QVariant> m_pending;
+    QTimer m_syncTimer;
+
+    mutable QCache<QString, QVariant> m_cache { VALUE_CACHE_SIZE };
 
     QStringList encryptedKeys; // encode only key listed here
+    QStringList encryptedKeyPrefixes; // and keys starting with one of these
     // only this fields need for backup
     QStringList m_fieldsToBackup = {
         "Conf/", "Servers/",
@@ -0,0 +1,220 @@
+#include "serverstore.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QUuid>
+
+ServerStore::ServerStore(const Backend &backend) : m_backend(backend)
+{
+}
+
+void ServerStore::load(bool reimportLegacy)
+{
+    const QStringList ids = m_backend.read(MANIFEST_KEY).toStringList();
+
+    QList<Record> records;
+    QStringList unreadableIds;
+    for (const QString &id : ids) {
+        const QJsonDocument doc = QJsonDocument::fromJson(m_backend.read(RECORD_PREFIX + id).toByteArray());
+        if (!doc.isObject()) {
+            qWarning() << "ServerStore::load unreadable server record" << id;
+            unreadableIds.append(id);
+            continue;
+        }
+        records.append({ id, doc.object(), false });
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_records = records;
+        // A record reads as garbage while the encryption key is unavailable,
+        // it must still be there once the key is back.
+        m_unreadableIds = unreadableIds;
+        m_removedIds.clear();
+        m_manifestDirty = false;
+    }
+
+    // Unchanged since the last import, the records are newer.
+    const QByteArray legacy = m_backend.read(LEGACY_KEY).toByteArray();
+    const bool legacyChanged = legacyHash(legacy) != m_backend.read(LEGACY_IMPORTED_KEY).toByteArray();
+    if (!legacy.isEmpty() && (reimportLegacy || legacyChanged)) {
+        importLegacy(legacy);
+    } else {
+        save();
+    }
+}
+
+void ServerStore::importLegacy(const QByteArray &data)
+{
+    const QJsonArray servers = QJsonDocument::fromJson(data).array();
+    qDebug() << "ServerStore: moving" << servers.size() << "servers to per-server records";
+
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const Record &record : std::as_const(m_records)) {
+            m_removedIds.append(record.id);
+        }
+        // The imported list replaces these as well.
+        m_removedIds.append(m_unreadableIds);
+        m_unreadableIds.clear();
+        m_records.clear();
+        for (const QJsonValue &server : servers) {
+            m_records.append({ newId(), server.toObject(), true });
+        }
+        m_manifestDirty = true;
+    }
+    save();
+
+    // Only once the records are written. The array itself is kept for
+    // previous builds.
+    m_backend.write(LEGACY_IMPORTED_KEY, legacyHash(data));
+}
+
+int ServerStore::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_records.size();
+}
+
+QJsonObject ServerStore::server(int index) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (index < 0 || index >= m_records.size()) {
+        return QJsonObject();
+    }
+    return m_records.at(index).server;
+}
+
+QJsonArray ServerStore::toArray() const
+{
+    QMutexLocker locker(&m_mutex);
+    QJsonArray servers;
+    for (const Record &record : m_records) {
+        servers.append(record.server);
+    }
+    return servers;
+}
+
+void ServerStore::append(const QJsonObject &server)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_records.append({ newId(), server, true });
+        m_manifestDirty = true;
+    }
+    save();
+}
+
+bool ServerStore::replace(int index, const QJsonObject &server)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (index < 0 || index >= m_records.size()) {
+            return false;
+        }
+
+        Record &record = m_records[index];
+        if (record.server == server) {
+            return true;
+        }
+        record.server = server;
+        record.dirty = true;
+    }
+    save();
+    return true;
+}
+
+bool ServerStore::remove(int index)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (index < 0 || index >= m_records.size()) {
+            return false;
+        }
+        m_removedIds.append(m_records.takeAt(index).id);
+        m_manifestDirty = true;
+    }
+    save();
+    return true;
+}
+
+void ServerStore::setAll(const QJsonArray &servers)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        for (int i = 0; i < servers.size(); ++i) {
+            const QJsonObject server = servers.at(i).toObject();
+            if (i >= m_records.size()) {
+                m_records.append({ newId(), server, true });
+                m_manifestDirty = true;
+            } else if (m_records.at(i).server != server) {
+                m_records[i].server = server;
+                m_records[i].dirty = true;
+            }
+        }
+        while (m_records.size() > servers.size()) {
+            m_removedIds.append(m_records.takeLast().id);
+            m_manifestDirty = true;
+        }
+    }
+    save();
+}
+
+void ServerStore::save()
+{
+    QList<QPair<QString, QByteArray>> records;
+    QStringList removedIds;
+    QStringList ids;
+    bool manifestDirty;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        for (Record &record : m_records) {
+            if (record.dirty) {
+                records.append({ record.id, QJsonDocument(record.server).toJson(QJsonDocument::Compact) });
+                record.dirty = false;
+            }
+        }
+        removedIds.swap(m_removedIds);
+
+        manifestDirty = m_manifestDirty;
+        m_manifestDirty = false;
+        if (manifestDirty) {
+            for (const Record &record : std::as_const(m_records)) {
+                ids.append(record.id);
+            }
+            ids.append(m_unreadableIds);
+        }
+    }
+
+    // Records first, so the manifest never names a record that isn't there.
+    for (const auto &record : std::as_const(records)) {
+        m_backend.write(RECORD_PREFIX + record.first, record.second);
+    }
+    if (manifestDirty) {
+        m_backend.write(MANIFEST_KEY, ids);
+    }
+    for (const QString &id : std::as_const(removedIds)) {
+        m_backend.remove(RECORD_PREFIX + id);
+    }
+}
+
+// static
+bool ServerStore::isStoreKey(const QString &key)
+{
+    return key == MANIFEST_KEY || key == LEGACY_IMPORTED_KEY || key.startsWith(RECORD_PREFIX);
+}
+
+// static
+QByteArray ServerStore::legacyHash(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex();
+}
+
+// static
+QString ServerStore::newId()
+{
+    return QUuid::createUuid().toString(QUuid::WithoutBraces);
+}
@@ -0,0 +1,87 @@
+#ifndef SERVERSTORE_H
+#define SERVERSTORE_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+#include <functional>
+
+// Server list kept parsed in memory and persisted one record per server, so
+// editing a server re-serializes and re-encrypts only that server. Records
+// live under RECORD_PREFIX + <id>, the order of the ids under MANIFEST_KEY.
+//
+// The list used to be a single JSON array under LEGACY_KEY; load() moves
+// such an array, including one restored from an old backup, into records.
+// The array itself stays in place, so a client downgraded to a previous
+// build still finds its servers. It is imported again only when it changes,
+// i.e. that build edited it. Removing it is left to a migration of a later
+// release, together with LEGACY_IMPORTED_KEY.
+class ServerStore
+{
+public:
+    static constexpr char LEGACY_KEY[] = "Servers/serversList";
+    // Hash of the legacy array last imported.
+    static constexpr char LEGACY_IMPORTED_KEY[] = "Servers/serversListImported";
+    static constexpr char MANIFEST_KEY[] = "Servers/serverIds";
+    static constexpr char RECORD_PREFIX[] = "Servers/server/";
+
+    // Access to the underlying settings.
+    struct Backend
+    {
+        std::function<QVariant(const QString &key)> read;
+        std::function<void(const QString &key, const QVariant &value)> write;
+        std::function<void(const QString &key)> remove;
+    };
+
+    explicit ServerStore(const Backend &backend);
+
+    // Drops the in-memory state and reads the stored servers again. With
+    // reimportLegacy set the legacy array replaces the records even if it
+    // was imported before, as a restored backup requires.
+    void load(bool reimportLegacy = false);
+
+    int count() const;
+    QJsonObject server(int index) const;
+    QJsonArray toArray() const;
+
+    void append(const QJsonObject &server);
+    bool replace(int index, const QJsonObject &server);
+    bool remove(int index);
+    // Stores only the servers that differ from the current ones.
+    void setAll(const QJsonArray &servers);
+
+    // True for the keys the store writes, they don't go into backups as is.
+    static bool isStoreKey(const QString &key);
+
+private:
+    struct Record
+    {
+        QString id;
+        QJsonObject server;
+        bool dirty = false;
+    };
+
+    void importLegacy(const QByteArray &data);
+    // Writes the dirty records and the manifest, outside of m_mutex: the
+    // backend may block on the GUI thread.
+    void save();
+
+    static QString newId();
+    static QByteArray legacyHash(const QByteArray &data);
+
+    Backend m_backend;
+
+    mutable QMutex m_mutex;
+    QList<Record> m_records;
+    QStringList m_removedIds;
+    // Listed in the manifest but not loaded, kept in it as they are.
+    QStringList m_unreadableIds;
+    bool m_manifestDirty = false;
+};
+
+#endif // SERVERSTORE_H
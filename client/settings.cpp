@@ -17,8 +17,15 @@ namespace
     constexpr char gatewayEndpoint[] = "http://gw.amnezia.org:80/";
 }
 
-Settings::Settings(QObject *parent) : QObject(parent), m_settings(ORGANIZATION_NAME, APPLICATION_NAME, this)
+Settings::Settings(QObject *parent)
+    : QObject(parent),
+      m_settings(ORGANIZATION_NAME, APPLICATION_NAME, this),
+      m_servers({ [this](const QString &key) { return value(key); },
+                  [this](const QString &key, const QVariant &value) { setValue(key, value); },
+                  [this](const QString &key) { remove(key); } })
 {
+    m_servers.load();
+
     // Import old settings
     if (serversCount() == 0) {
         QString user = value("Server/userName").toString();
@@ -48,45 +55,30 @@ Settings::Settings(QObject *parent) : QObject(parent), m_settings(ORGANIZATION_N
 
 int Settings::serversCount() const
 {
-    return serversArray().size();
+    return m_servers.count();
 }
 
 QJsonObject Settings::server(int index) const
 {
-    const QJsonArray &servers = serversArray();
-    if (index >= servers.size())
-        return QJsonObject();
-
-    return servers.at(index).toObject();
+    return m_servers.server(index);
 }
 
 void Settings::addServer(const QJsonObject &server)
 {
-    QJsonArray servers = serversArray();
-    servers.append(server);
-    setServersArray(servers);
+    m_servers.append(server);
 }
 
 void Settings::removeServer(int index)
 {
-    QJsonArray servers = serversArray();
-    if (index >= servers.size())
+    if (!m_servers.remove(index))
         return;
 
-    servers.removeAt(index);
-    setServersArray(servers);
     emit serverRemoved(index);
 }
 
 bool Settings::editServer(int index, const QJsonObject &server)
 {
-    QJsonArray servers = serversArray();
-    if (index >= servers.size())
-        return false;
-
-    servers.replace(index, server);
-    setServersArray(servers);
-    return true;
+    return m_servers.replace(index, server);
 }
 
 void Settings::setDefaultContainer(int serverIndex, DockerContainer container)
@@ -203,13 +195,14 @@ bool Settings::haveAuthData(int serverIndex) const
 
 QString Settings::nextAvailableServerName() const
 {
+    const QJsonArray servers = serversArray();
     int i = 0;
     bool nameExist = false;
 
     do {
         i++;
         nameExist = false;
-        for (const QJsonValue &server : serversArray()) {
+        for (const QJsonValue &server : servers) {
             if (server.toObject().value(config_key::description).toString() == tr("Server") + " " + QString::number(i)) {
                 nameExist = true;
                 break;
@@ -367,10 +360,35 @@ QString Settings::secondaryDns() const
     return value("Conf/secondaryDns", cloudFlareNs2).toString();
 }
 
+QByteArray Settings::backupAppConfig() const
+{
+    // Backups keep the single array, older versions and the import
+    // detection rely on it.
+    QJsonObject cfg = QJsonDocument::fromJson(m_settings.backupAppConfig()).object();
+    for (const QString &key : cfg.keys()) {
+        if (ServerStore::isStoreKey(key)) {
+            cfg.remove(key);
+        }
+    }
+    cfg.insert(ServerStore::LEGACY_KEY, QString::fromUtf8(QJsonDocument(m_servers.toArray()).toJson()));
+
+    return QJsonDocument(cfg).toJson();
+}
+
+bool Settings::restoreAppConfig(const QByteArray &cfg)
+{
+    if (!m_settings.restoreAppConfig(cfg))
+        return false;
+
+    m_servers.load(true);
+    return true;
+}
+
 void Settings::clearSettings()
 {
     auto uuid = getInstallationUuid(false);
     m_settings.clearSettings();
+    m_servers.load();
     setInstallationUuid(uuid);
     emit settingsCleared();
 }
@@ -509,6 +527,15 @@ void Settings::setValue(const QString &key, const QVariant &value)
     }
 }
 
+void Settings::remove(const QString &key)
+{
+    if (QThread::currentThread() == QCoreApplication::instance()->thread()) {
+        m_settings.remove(key);
+    } else {
+        QMetaObject::invokeMethod(&m_settings, "remove", Qt::BlockingQueuedConnection, Q_ARG(const QString &, key));
+    }
+}
+
 void Settings::resetGatewayEndpoint()
 {
     m_gatewayEndpoint = gatewayEndpoint;
@@ -12,6 +12,7 @@
 #include "containers/containers_defs.h"
 #include "core/defs.h"
 #include "secure_qsettings.h"
+#include "serverstore.h"
 
 using namespace amnezia;
 
@@ -29,11 +30,11 @@ public:
 
     QJsonArray serversArray() const
     {
-        return QJsonDocument::fromJson(value("Servers/serversList").toByteArray()).array();
+        return m_servers.toArray();
     }
     void setServersArray(const QJsonArray &servers)
     {
-        setValue("Servers/serversList", QJsonDocument(servers).toJson());
+        m_servers.setAll(servers);
     }
 
     // Servers section
@@ -163,14 +164,8 @@ public:
     //    static constexpr char openNicNs5[] = "94.103.153.176";
     //    static constexpr char openNicNs13[] = "144.76.103.143";
 
-    QByteArray backupAppConfig() const
-    {
-        return m_settings.backupAppConfig();
-    }
-    bool restoreAppConfig(const QByteArray &cfg)
-    {
-        return m_settings.restoreAppConfig(cfg);
-    }
+    QByteArray backupAppConfig() const;
+    bool restoreAppConfig(const QByteArray &cfg);
 
     QLocale getAppLanguage()
     {
@@ -228,10 +223,12 @@ signals:
 private:
     QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
     void setValue(const QString &key, const QVariant &value);
+    void remove(const QString &key);
 
     void setInstallationUuid(const QString &uuid);
 
     mutable SecureQSettings m_settings;
+    ServerStore m_servers;
 
     QString m_gatewayEndpoint;
 };
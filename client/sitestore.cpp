@@ -0,0 +1,254 @@
+#include "sitestore.h"
+
+#include <QHostAddress>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <utility>
+
+namespace
+{
+    constexpr qint64 READ_CHUNK_SIZE = 64 * 1024;
+
+    // Whitespace or a byte of the UTF-8 byte order mark.
+    bool isLeadingByte(char c)
+    {
+        const uchar byte = uchar(c);
+        return QChar::isSpace(byte) || byte == 0xEF || byte == 0xBB || byte == 0xBF;
+    }
+}
+
+SiteStore::SiteStore(const std::shared_ptr<Settings> &settings) : m_settings(settings)
+{
+}
+
+void SiteStore::load(Settings::RouteMode mode)
+{
+    m_mode = mode;
+    m_sites.clear();
+    m_index.clear();
+
+    const QVariantMap sites = m_settings->vpnSites(mode);
+    m_sites.reserve(sites.size());
+    m_index.reserve(sites.size());
+    for (auto it = sites.constBegin(); it != sites.constEnd(); ++it) {
+        int row;
+        insert({ it.key(), it.value().toString() }, row);
+    }
+}
+
+SiteStore::AddResult SiteStore::insert(const Site &site, int &row)
+{
+    const QString key = normalize(site.hostname);
+    auto it = m_index.constFind(key);
+    if (it == m_index.constEnd()) {
+        row = m_sites.size();
+        m_sites.append(site);
+        m_index.insert(key, row);
+        return Added;
+    }
+
+    row = it.value();
+    Site &existing = m_sites[row];
+    if (site.ip.isEmpty() || existing.ip == site.ip) {
+        return Unchanged;
+    }
+    existing.ip = site.ip;
+    return Updated;
+}
+
+SiteStore::AddResult SiteStore::add(const Site &site, int &row)
+{
+    const AddResult result = insert(site, row);
+    if (result != Unchanged) {
+        persist();
+    }
+    return result;
+}
+
+void SiteStore::addAll(const QList<Site> &sites, bool replaceExisting)
+{
+    if (replaceExisting) {
+        m_sites.clear();
+        m_index.clear();
+    }
+
+    m_sites.reserve(m_sites.size() + sites.size());
+    m_index.reserve(m_sites.size() + sites.size());
+    for (const Site &site : sites) {
+        int row;
+        insert(site, row);
+    }
+    persist();
+}
+
+void SiteStore::removeAt(int index)
+{
+    if (index < 0 || index >= m_sites.size()) {
+        return;
+    }
+
+    m_index.remove(normalize(m_sites.at(index).hostname));
+    m_sites.removeAt(index);
+    rebuildIndex(index);
+    persist();
+}
+
+void SiteStore::rebuildIndex(int from)
+{
+    for (int i = from; i < m_sites.size(); ++i) {
+        m_index.insert(normalize(m_sites.at(i).hostname), i);
+    }
+}
+
+void SiteStore::persist()
+{
+    // VpnConnection records the addresses it resolves straight into the
+    // settings, keep those rather than overwriting them with blanks.
+    const QVariantMap stored = m_settings->vpnSites(m_mode);
+
+    QVariantMap sites;
+    for (int i = 0; i < m_sites.size(); ++i) {
+        Site &site = m_sites[i];
+        if (site.ip.isEmpty()) {
+            site.ip = stored.value(site.hostname).toString();
+            if (!site.ip.isEmpty()) {
+                m_changedRows.append(i);
+            }
+        }
+        sites.insert(site.hostname, site.ip);
+    }
+    m_settings->setVpnSites(m_mode, sites);
+}
+
+QList<int> SiteStore::takeChangedRows()
+{
+    return std::exchange(m_changedRows, {});
+}
+
+// static
+QString SiteStore::normalize(const QString &hostname)
+{
+    QString key = hostname.trimmed().toLower();
+    if (key.endsWith('.')) {
+        key.chop(1);
+    }
+
+    const int slash = key.indexOf('/');
+    const QHostAddress address(slash < 0 ? key : key.left(slash));
+    if (address.isNull()) {
+        return key;
+    }
+
+    const int maxPrefix = address.protocol() == QAbstractSocket::IPv6Protocol ? 128 : 32;
+    bool ok = true;
+    const int prefix = slash < 0 ? maxPrefix : key.mid(slash + 1).toInt(&ok);
+    if (!ok || prefix < 0 || prefix > maxPrefix) {
+        return key;
+    }
+    return prefix == maxPrefix ? address.toString() : QString("%1/%2").arg(address.toString()).arg(prefix);
+}
+
+// static
+SiteStore::ReadResult SiteStore::readJson(QIODevice *device, const std::function<void(const Site &)> &handler)
+{
+    // Tracks the nesting just well enough to cut the array into its
+    // elements; each object element is then parsed on its own.
+    QByteArray element;
+    bool started = false;
+    bool capturing = false;
+    bool inString = false;
+    bool escaped = false;
+    int depth = 0;
+
+    while (!device->atEnd()) {
+        const QByteArray chunk = device->read(READ_CHUNK_SIZE);
+        if (chunk.isEmpty()) {
+            break;
+        }
+
+        for (const char c : chunk) {
+            if (capturing) {
+                element.append(c);
+            }
+
+            if (inString) {
+                if (escaped) {
+                    escaped = false;
+                } else if (c == '\\') {
+                    escaped = true;
+                } else if (c == '"') {
+                    inString = false;
+                }
+                continue;
+            }
+
+            if (!started) {
+                if (c == '[') {
+                    started = true;
+                    depth = 1;
+                } else if (!isLeadingByte(c)) {
+                    return ReadNotAnArray;
+                }
+                continue;
+            }
+            if (depth == 0) {
+                continue;
+            }
+
+            switch (c) {
+            case '"': inString = true; break;
+            case '{':
+            case '[':
+                if (depth == 1 && c == '{') {
+                    capturing = true;
+                    element = "{";
+                }
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                --depth;
+                if (capturing && depth == 1) {
+                    capturing = false;
+                    QJsonParseError error;
+                    const QJsonDocument doc = QJsonDocument::fromJson(element, &error);
+                    if (error.error != QJsonParseError::NoError) {
+                        return ReadInvalid;
+                    }
+                    const QJsonObject object = doc.object();
+                    handler({ object.value("hostname").toString(), object.value("ip").toString() });
+                }
+                break;
+            default: break;
+            }
+        }
+    }
+
+    if (!started) {
+        return ReadNotAnArray;
+    }
+    return depth == 0 ? ReadOk : ReadInvalid;
+}
+
+bool SiteStore::writeJson(QIODevice *device) const
+{
+    if (device->write("[\n") < 0) {
+        return false;
+    }
+
+    for (int i = 0; i < m_sites.size(); ++i) {
+        const QJsonObject object { { "hostname", m_sites.at(i).hostname }, { "ip", m_sites.at(i).ip } };
+        QByteArray line = "    " + QJsonDocument(object).toJson(QJsonDocument::Compact);
+        if (i + 1 < m_sites.size()) {
+            line += ',';
+        }
+        line += '\n';
+        if (device->write(line) != line.size()) {
+            return false;
+        }
+    }
+
+    return device->write("]\n") >= 0;
+}
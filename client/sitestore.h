@@ -0,0 +1,85 @@
+#ifndef SITESTORE_H
+#define SITESTORE_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <functional>
+#include <memory>
+
+#include "settings.h"
+
+class QIODevice;
+
+// Sites of one route mode, in the order they were added, with a hash index
+// on the normalized hostname or address. Edits are persisted to Settings
+// once per call, bulk inserts included.
+class SiteStore
+{
+public:
+    struct Site
+    {
+        QString hostname;
+        QString ip;
+    };
+
+    enum AddResult {
+        Added,
+        Updated,
+        Unchanged,
+    };
+
+    enum ReadResult {
+        ReadOk,
+        ReadNotAnArray,
+        ReadInvalid,
+    };
+
+    explicit SiteStore(const std::shared_ptr<Settings> &settings);
+
+    void load(Settings::RouteMode mode);
+    Settings::RouteMode routeMode() const { return m_mode; }
+
+    int count() const { return m_sites.size(); }
+    const Site &at(int index) const { return m_sites.at(index); }
+    const QList<Site> &sites() const { return m_sites; }
+
+    int indexOf(const QString &hostname) const { return m_index.value(normalize(hostname), -1); }
+    bool contains(const QString &hostname) const { return m_index.contains(normalize(hostname)); }
+
+    // An existing site only takes a new address, row is set to the site's row.
+    AddResult add(const Site &site, int &row);
+    // Adds all sites and persists once.
+    void addAll(const QList<Site> &sites, bool replaceExisting);
+    void removeAt(int index);
+
+    // Rows whose address was filled in from the settings by the last edit,
+    // the model has to report them as changed.
+    QList<int> takeChangedRows();
+
+    // Lower case without a trailing dot for hostnames, the canonical form for
+    // addresses and subnets (10.0.0.1/32 is 10.0.0.1).
+    static QString normalize(const QString &hostname);
+
+    // Reads a JSON array of {"hostname", "ip"} objects one object at a time,
+    // so large lists never exist as a whole document.
+    static ReadResult readJson(QIODevice *device, const std::function<void(const Site &)> &handler);
+    // Writes the sites in the same format, one object per line.
+    bool writeJson(QIODevice *device) const;
+
+private:
+    // Merges the site into the list without persisting.
+    AddResult insert(const Site &site, int &row);
+    void rebuildIndex(int from);
+    void persist();
+
+    std::shared_ptr<Settings> m_settings;
+    Settings::RouteMode m_mode = Settings::VpnOnlyForwardSites;
+
+    QList<Site> m_sites;
+    QHash<QString, int> m_index;
+    QList<int> m_changedRows;
+};
+
+#endif // SITESTORE_H
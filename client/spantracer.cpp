@@ -0,0 +1,180 @@
+#include "spantracer.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+
+#include <algorithm>
+
+namespace
+{
+    // Events kept for the trace file, older ones are dropped.
+    constexpr int MAX_EVENTS = 4096;
+    // Durations kept per span name for the percentiles.
+    constexpr int MAX_DURATIONS = 256;
+
+    qint64 percentile(const QList<qint64> &sorted, int p)
+    {
+        const int index = qBound(0, int((sorted.size() * p + 99) / 100) - 1, int(sorted.size()) - 1);
+        return sorted.at(index);
+    }
+}
+
+SpanTracer::Scope::Scope(const char *name) : m_name(name), m_start(SpanTracer::instance().now())
+{
+}
+
+SpanTracer::Scope::~Scope()
+{
+    SpanTracer &tracer = SpanTracer::instance();
+    tracer.record(m_name, m_start, tracer.now());
+}
+
+SpanTracer &SpanTracer::instance()
+{
+    static SpanTracer s;
+    return s;
+}
+
+SpanTracer::SpanTracer() : m_epochUsec(QDateTime::currentMSecsSinceEpoch() * 1000)
+{
+    m_clock.start();
+}
+
+qint64 SpanTracer::now() const
+{
+    return m_epochUsec + m_clock.nsecsElapsed() / 1000;
+}
+
+void SpanTracer::begin(const char *name)
+{
+    const qint64 start = now();
+    QMutexLocker locker(&m_mutex);
+    m_open.insert(QString::fromLatin1(name), start);
+}
+
+void SpanTracer::end(const char *name)
+{
+    const qint64 end = now();
+    qint64 start;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_open.find(QString::fromLatin1(name));
+        if (it == m_open.end()) {
+            return;
+        }
+        start = it.value();
+        m_open.erase(it);
+    }
+    record(name, start, end);
+}
+
+void SpanTracer::cancel(const char *name)
+{
+    QMutexLocker locker(&m_mutex);
+    m_open.remove(QString::fromLatin1(name));
+}
+
+void SpanTracer::record(const char *name, qint64 start, qint64 end)
+{
+    Event event { name, start, end - start, quint64(quintptr(QThread::currentThreadId())) };
+
+    QMutexLocker locker(&m_mutex);
+    if (m_events.size() >= MAX_EVENTS) {
+        m_events.removeFirst();
+    }
+    m_events.append(event);
+
+    QList<qint64> &durations = m_durations[QString::fromLatin1(name)];
+    if (durations.size() >= MAX_DURATIONS) {
+        durations.removeFirst();
+    }
+    durations.append(event.duration);
+}
+
+QMap<QString, SpanTracer::Percentiles> SpanTracer::percentiles()
+{
+    QHash<QString, QList<qint64>> durations;
+    {
+        QMutexLocker locker(&m_mutex);
+        durations = m_durations;
+    }
+
+    QMap<QString, Percentiles> result;
+    for (auto it = durations.begin(); it != durations.end(); ++it) {
+        QList<qint64> &sorted = it.value();
+        if (sorted.isEmpty()) {
+            continue;
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        Percentiles &p = result[it.key()];
+        p.count = sorted.size();
+        p.p50 = percentile(sorted, 50);
+        p.p95 = percentile(sorted, 95);
+        p.p99 = percentile(sorted, 99);
+    }
+    return result;
+}
+
+void SpanTracer::setTraceFile(const QString &fileName)
+{
+    QMutexLocker locker(&m_mutex);
+    m_traceFile = fileName;
+}
+
+bool SpanTracer::writeTrace()
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray events;
+    QString traceFile;
+    {
+        QMutexLocker locker(&m_mutex);
+        traceFile = m_traceFile;
+        for (const Event &event : m_events) {
+            QJsonObject json;
+            json.insert("name", QString::fromLatin1(event.name));
+            json.insert("cat", "connect");
+            json.insert("ph", "X");
+            json.insert("ts", event.start);
+            json.insert("dur", event.duration);
+            json.insert("pid", pid);
+            json.insert("tid", qint64(event.thread));
+            events.append(json);
+        }
+    }
+    if (traceFile.isEmpty()) {
+        return false;
+    }
+
+    QJsonObject stages;
+    const QMap<QString, Percentiles> stats = percentiles();
+    for (auto it = stats.begin(); it != stats.end(); ++it) {
+        stages.insert(it.key(), QJsonObject { { "count", it->count }, { "p50", it->p50 }, { "p95", it->p95 }, { "p99", it->p99 } });
+        qDebug().noquote() << QString("Span %1: n=%2 p50=%3us p95=%4us p99=%5us")
+                                      .arg(it.key())
+                                      .arg(it->count)
+                                      .arg(it->p50)
+                                      .arg(it->p95)
+                                      .arg(it->p99);
+    }
+
+    QJsonObject trace;
+    trace.insert("traceEvents", events);
+    trace.insert("displayTimeUnit", "ms");
+    trace.insert("stagePercentilesUs", stages);
+
+    QSaveFile file(traceFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
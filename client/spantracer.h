@@ -0,0 +1,82 @@
+#ifndef SPANTRACER_H
+#define SPANTRACER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+// Records where time goes while a connection is brought up. Spans carry
+// monotonic timestamps and the thread they ran on; they are kept in memory
+// and written out as Chrome trace-event JSON (load it in chrome://tracing
+// or Perfetto). For each span name the most recent durations are kept too,
+// so p50/p95/p99 per stage are available without the trace file.
+class SpanTracer
+{
+public:
+    struct Percentiles
+    {
+        int count = 0;
+        qint64 p50 = 0;
+        qint64 p95 = 0;
+        qint64 p99 = 0;
+    };
+
+    // Span covering the lifetime of the object, on the current thread.
+    class Scope
+    {
+    public:
+        explicit Scope(const char *name);
+        ~Scope();
+
+    private:
+        Q_DISABLE_COPY(Scope)
+
+        const char *m_name;
+        qint64 m_start;
+    };
+
+    static SpanTracer &instance();
+
+    // Spans crossing event loop iterations. Only one span per name can be
+    // open, beginning it again restarts it.
+    void begin(const char *name);
+    void end(const char *name);
+    // Drops an open span without recording it, e.g. on an aborted connect.
+    void cancel(const char *name);
+
+    void setTraceFile(const QString &fileName);
+    // Writes the retained spans to the trace file.
+    bool writeTrace();
+
+    // Durations in microseconds per span name.
+    QMap<QString, Percentiles> percentiles();
+
+private:
+    struct Event
+    {
+        const char *name;
+        qint64 start;
+        qint64 duration;
+        quint64 thread;
+    };
+
+    SpanTracer();
+
+    qint64 now() const;
+    void record(const char *name, qint64 start, qint64 end);
+
+    QElapsedTimer m_clock;
+    // Wall clock time of m_clock's start, so traces of several processes line up.
+    qint64 m_epochUsec;
+
+    QMutex m_mutex;
+    QList<Event> m_events;
+    QHash<QString, qint64> m_open;
+    QHash<QString, QList<qint64>> m_durations;
+    QString m_traceFile;
+};
+
+#endif // SPANTRACER_H
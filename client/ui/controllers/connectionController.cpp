@@ -8,6 +8,7 @@
 #include <QtConcurrent>
 
 #include "core/controllers/vpnConfigurationController.h"
+#include "spantracer.h"
 #include "core/enums/apiEnums.h"
 #include "version.h"
 
@@ -193,6 +194,10 @@ bool ConnectionController::isProtocolConfigExists(const QJsonObject &containerCo
 
 void ConnectionController::continueConnection()
 {
+    // Ended by VpnConnection once the tunnel is up or failed.
+    SpanTracer::instance().begin("connect");
+    SpanTracer::Scope span("connect.prepare");
+
     int serverIndex = m_serversModel->getDefaultServerIndex();
     QJsonObject serverConfig = m_serversModel->getServerConfig(serverIndex);
     auto configVersion = serverConfig.value(config_key::configVersion).toInt();
@@ -220,7 +225,11 @@ void ConnectionController::continueConnection()
 
     QJsonObject containerConfig = m_containersModel->getContainerConfig(container);
     ServerCredentials credentials = m_serversModel->getServerCredentials(serverIndex);
-    ErrorCode errorCode = updateProtocolConfig(container, credentials, containerConfig, serverController);
+    ErrorCode errorCode;
+    {
+        SpanTracer::Scope span("connect.updateProtocolConfig");
+        errorCode = updateProtocolConfig(container, credentials, containerConfig, serverController);
+    }
     if (errorCode != ErrorCode::NoError) {
         emit connectionErrorOccurred(errorCode);
         return;
@@ -228,7 +237,11 @@ void ConnectionController::continueConnection()
 
     auto dns = m_serversModel->getDnsPair(serverIndex);
 
-    auto vpnConfiguration = vpnConfigurationController.createVpnConfiguration(dns, serverConfig, containerConfig, container, errorCode);
+    QJsonObject vpnConfiguration;
+    {
+        SpanTracer::Scope span("connect.createVpnConfiguration");
+        vpnConfiguration = vpnConfigurationController.createVpnConfiguration(dns, serverConfig, containerConfig, container, errorCode);
+    }
     if (errorCode != ErrorCode::NoError) {
         emit connectionErrorOccurred(tr("unable to create configuration"));
         return;
@@ -95,8 +95,10 @@ void SettingsController::exportLogsFile(const QString &fileName)
 {
 #ifdef Q_OS_ANDROID
     AndroidController::instance()->exportLogsFile(fileName);
-#else
+#elif defined(Q_OS_IOS)
     SystemController::saveFile(fileName, Logger::getLogFile());
+#else
+    SystemController::saveFile(fileName, [](QIODevice *out) { Logger::exportLogFile(out); });
 #endif
 }
 
@@ -1,16 +1,20 @@
 #include "sitesController.h"
 
 #include <QFile>
-#include <QHostInfo>
 #include <QStandardPaths>
 
 #include "systemController.h"
+#include "core/dnsResolver.h"
 #include "core/networkUtilities.h"
 
 SitesController::SitesController(const std::shared_ptr<Settings> &settings,
                                  const QSharedPointer<VpnConnection> &vpnConnection,
                                  const QSharedPointer<SitesModel> &sitesModel, QObject *parent)
-    : QObject(parent), m_settings(settings), m_vpnConnection(vpnConnection), m_sitesModel(sitesModel)
+    : QObject(parent),
+      m_settings(settings),
+      m_vpnConnection(vpnConnection),
+      m_sitesModel(sitesModel),
+      m_dnsResolver(new DnsResolver(this))
 {
 }
 
@@ -47,21 +51,17 @@ void SitesController::addSite(QString hostname)
         QMetaObject::invokeMethod(m_vpnConnection.get(), "flushDns", Qt::QueuedConnection);
     };
 
-    const auto &resolveCallback = [this, processSite](const QHostInfo &hostInfo) {
-        const QList<QHostAddress> &addresses = hostInfo.addresses();
-        for (const QHostAddress &addr : hostInfo.addresses()) {
-            if (addr.protocol() == QAbstractSocket::NetworkLayerProtocol::IPv4Protocol) {
-                processSite(hostInfo.hostName(), addr.toString());
-                break;
-            }
-        }
-    };
-
     if (NetworkUtilities::ipAddressWithSubnetRegExp().exactMatch(hostname)) {
         processSite(hostname, "");
     } else {
         processSite(hostname, "");
-        QHostInfo::lookupHost(hostname, this, resolveCallback);
+        m_dnsResolver->resolve({ hostname }, DnsResolver::Ipv4, this,
+                               [processSite, hostname](const DnsResolver::Result &result) {
+                                   const QList<QHostAddress> &addresses = result.value(hostname);
+                                   if (!addresses.isEmpty()) {
+                                       processSite(hostname, addresses.first().toString());
+                                   }
+                               });
     }
 
     emit finished(tr("New site added: %1").arg(hostname));
@@ -71,10 +71,15 @@ void SitesController::removeSite(int index)
 {
     auto modelIndex = m_sitesModel->index(index);
     auto hostname = m_sitesModel->data(modelIndex, SitesModel::Roles::UrlRole).toString();
+    auto ip = m_sitesModel->data(modelIndex, SitesModel::Roles::IpRole).toString();
     m_sitesModel->removeSite(modelIndex);
 
-    QMetaObject::invokeMethod(m_vpnConnection.get(), "deleteRoutes", Qt::QueuedConnection,
-                              Q_ARG(QStringList, QStringList() << hostname));
+    // A domain is routed by the address it resolved to
+    QStringList routes { hostname };
+    if (!ip.isEmpty()) {
+        routes.append(ip);
+    }
+    QMetaObject::invokeMethod(m_vpnConnection.get(), "deleteRoutes", Qt::QueuedConnection, Q_ARG(QStringList, routes));
     QMetaObject::invokeMethod(m_vpnConnection.get(), "flushDns", Qt::QueuedConnection);
 
     emit finished(tr("Site removed: %1").arg(hostname));
@@ -89,40 +94,29 @@ void SitesController::importSites(const QString &fileName, bool replaceExisting)
         return;
     }
 
-    QByteArray jsonData = file.readAll();
-    QJsonDocument jsonDocument = QJsonDocument::fromJson(jsonData);
-    if (jsonDocument.isNull()) {
+    QList<SiteStore::Site> sites;
+    QStringList ips;
+
+    const auto result = SiteStore::readJson(&file, [&sites, &ips](const SiteStore::Site &site) {
+        if (!site.hostname.contains(".") && !NetworkUtilities::ipAddressWithSubnetRegExp().exactMatch(site.hostname)) {
+            qDebug() << site.hostname << " not look like ip adress or domain name";
+            return;
+        }
+
+        ips.append(site.ip.isEmpty() ? site.hostname : site.ip);
+        sites.append(site);
+    });
+
+    if (result == SiteStore::ReadInvalid) {
         emit errorOccurred(tr("Failed to parse JSON data from file: %1").arg(fileName));
         return;
     }
 
-    if (!jsonDocument.isArray()) {
+    if (result == SiteStore::ReadNotAnArray) {
         emit errorOccurred(tr("The JSON data is not an array in file: %1").arg(fileName));
         return;
     }
 
-    auto jsonArray = jsonDocument.array();
-    QMap<QString, QString> sites;
-    QStringList ips;
-
-    for (auto jsonValue : jsonArray) {
-        auto jsonObject = jsonValue.toObject();
-        auto hostname = jsonObject.value("hostname").toString("");
-        auto ip = jsonObject.value("ip").toString("");
-
-        if (!hostname.contains(".") && !NetworkUtilities::ipAddressWithSubnetRegExp().exactMatch(hostname)) {
-            qDebug() << hostname << " not look like ip adress or domain name";
-            continue;
-        }
-
-        if (ip.isEmpty()) {
-            ips.append(hostname);
-        } else {
-            ips.append(ip);
-        }
-        sites.insert(hostname, ip);
-    }
-
     m_sitesModel->addSites(sites, replaceExisting);
 
     QMetaObject::invokeMethod(m_vpnConnection.get(), "addRoutes", Qt::QueuedConnection, Q_ARG(QStringList, ips));
@@ -133,19 +127,8 @@ void SitesController::importSites(const QString &fileName, bool replaceExisting)
 
 void SitesController::exportSites(const QString &fileName)
 {
-    auto sites = m_sitesModel->getCurrentSites();
-
-    QJsonArray jsonArray;
-
-    for (const auto &site : sites) {
-        QJsonObject jsonObject { { "hostname", site.first }, { "ip", site.second } };
-        jsonArray.append(jsonObject);
-    }
-
-    QJsonDocument jsonDocument(jsonArray);
-    QByteArray jsonData = jsonDocument.toJson();
-
-    SystemController::saveFile(fileName, jsonData);
+    const SiteStore &sites = m_sitesModel->sites();
+    SystemController::saveFile(fileName, [&sites](QIODevice *device) { sites.writeJson(device); });
 
     emit finished(tr("Export completed"));
 }
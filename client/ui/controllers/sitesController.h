@@ -7,6 +7,8 @@
 #include "ui/models/sites_model.h"
 #include "vpnconnection.h"
 
+class DnsResolver;
+
 class SitesController : public QObject
 {
     Q_OBJECT
@@ -33,6 +35,8 @@ private:
 
     QSharedPointer<VpnConnection> m_vpnConnection;
     QSharedPointer<SitesModel> m_sitesModel;
+
+    DnsResolver *m_dnsResolver;
 };
 
 #endif // SITESCONTROLLER_H
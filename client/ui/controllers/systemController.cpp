@@ -1,5 +1,6 @@
 #include "systemController.h"
 
+#include <QBuffer>
 #include <QDesktopServices>
 #include <QDir>
 #include <QEventLoop>
@@ -31,6 +32,19 @@ void SystemController::saveFile(QString fileName, const QString &data)
     return;
 #endif
 
+    saveFile(fileName, [&data](QIODevice *out) { out->write(data.toUtf8()); });
+}
+
+void SystemController::saveFile(QString fileName, const std::function<void(QIODevice *)> &write)
+{
+#if defined Q_OS_ANDROID
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    write(&buffer);
+    AndroidController::instance()->saveFile(fileName, QString::fromUtf8(buffer.data()));
+    return;
+#endif
+
 #ifdef Q_OS_IOS
     QUrl fileUrl = QDir::tempPath() + "/" + fileName;
     QFile file(fileUrl.toString());
@@ -40,7 +54,7 @@ void SystemController::saveFile(QString fileName, const QString &data)
 
     // todo check if save successful
     file.open(QIODevice::WriteOnly);
-    file.write(data.toUtf8());
+    write(&file);
     file.close();
 
 #ifdef Q_OS_IOS
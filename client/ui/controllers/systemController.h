@@ -3,6 +3,8 @@
 
 #include <QObject>
 
+#include <functional>
+
 #include "settings.h"
 
 class SystemController : public QObject
@@ -12,6 +14,8 @@ public:
     explicit SystemController(const std::shared_ptr<Settings> &setting, QObject *parent = nullptr);
 
     static void saveFile(QString fileName, const QString &data);
+    // Lets write() stream the content into the file instead of building it in memory first.
+    static void saveFile(QString fileName, const std::function<void(QIODevice *)> &write);
 
 public slots:
     QString getFileName(const QString &acceptLabel, const QString &nameFilter, const QString &selectedFile = "",
@@ -2,6 +2,7 @@
 
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSet>
 
 #include "core/controllers/serverController.h"
 #include "logger.h"
@@ -21,6 +22,64 @@ namespace
         constexpr char dataReceived[] = "dataReceived";
         constexpr char dataSent[] = "dataSent";
     }
+
+    // Starts the lines separating the parts of the clients dump
+    constexpr char dumpSectionMarker[] = "@amnezia-section:";
+
+    // Same as wg show prints it, with the units shortened
+    QString formatHandshake(qint64 now, qint64 latestHandshake)
+    {
+        if (latestHandshake == now) {
+            return "Now";
+        }
+        if (latestHandshake > now) {
+            return "(FUTURE)";
+        }
+
+        qint64 left = now - latestHandshake;
+        const qint64 years = left / (365 * 24 * 60 * 60);
+        left %= 365 * 24 * 60 * 60;
+        const qint64 days = left / (24 * 60 * 60);
+        left %= 24 * 60 * 60;
+        const qint64 hours = left / (60 * 60);
+        left %= 60 * 60;
+        const qint64 minutes = left / 60;
+        const qint64 seconds = left % 60;
+
+        QStringList parts;
+        if (years) {
+            parts << QString("%1 year%2").arg(years).arg(years == 1 ? "" : "s");
+        }
+        if (days) {
+            parts << QString("%1d").arg(days);
+        }
+        if (hours) {
+            parts << QString("%1h").arg(hours);
+        }
+        if (minutes) {
+            parts << QString("%1m").arg(minutes);
+        }
+        if (seconds) {
+            parts << QString("%1s").arg(seconds);
+        }
+        return parts.join(", ") + " ago";
+    }
+
+    QString formatBytes(quint64 bytes)
+    {
+        if (bytes < 1024) {
+            return QString("%1 B").arg(bytes);
+        }
+
+        const char *units[] = { "KiB", "MiB", "GiB", "TiB" };
+        double value = bytes / 1024.0;
+        int unit = 0;
+        while (value >= 1024 && unit < 3) {
+            value /= 1024;
+            ++unit;
+        }
+        return QString("%1 %2").arg(value, 0, 'f', 2).arg(units[unit]);
+    }
 }
 
 ClientManagementModel::ClientManagementModel(std::shared_ptr<Settings> settings, QObject *parent)
@@ -54,262 +113,287 @@ QVariant ClientManagementModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
-void ClientManagementModel::migration(const QByteArray &clientsTableString)
+void ClientManagementModel::migration(const QByteArray &clientsTableString, QJsonArray &clientsTable)
 {
-    QJsonObject clientsTable = QJsonDocument::fromJson(clientsTableString).object();
+    QJsonObject oldClientsTable = QJsonDocument::fromJson(clientsTableString).object();
 
-    for (auto &clientId : clientsTable.keys()) {
+    for (auto &clientId : oldClientsTable.keys()) {
         QJsonObject client;
         client[configKey::clientId] = clientId;
 
         QJsonObject userData;
-        userData[configKey::clientName] = clientsTable.value(clientId).toObject().value(configKey::clientName);
+        userData[configKey::clientName] = oldClientsTable.value(clientId).toObject().value(configKey::clientName);
         client[configKey::userData] = userData;
 
-        m_clientsTable.push_back(client);
+        clientsTable.push_back(client);
     }
 }
 
 ErrorCode ClientManagementModel::updateModel(const DockerContainer container, const ServerCredentials &credentials,
                                              const QSharedPointer<ServerController> &serverController)
 {
-    beginResetModel();
-    m_clientsTable = QJsonArray();
-
-    ErrorCode error = ErrorCode::NoError;
-
-    QString clientsTableFile = QString("/opt/amnezia/%1/clientsTable");
-    if (container == DockerContainer::OpenVpn || container == DockerContainer::ShadowSocks || container == DockerContainer::Cloak) {
-        clientsTableFile = clientsTableFile.arg(ContainerProps::containerTypeToString(DockerContainer::OpenVpn));
-    } else {
-        clientsTableFile = clientsTableFile.arg(ContainerProps::containerTypeToString(container));
-    }
-
-    const QByteArray clientsTableString = serverController->getTextFileFromContainer(container, credentials, clientsTableFile, error);
+    ClientsDump dump;
+    ErrorCode error = getClientsDump(container, credentials, serverController, dump);
     if (error != ErrorCode::NoError) {
-        logger.error() << "Failed to get the clientsTable file from the server";
-        endResetModel();
+        applyClientsTable(QJsonArray());
         return error;
     }
 
-    m_clientsTable = QJsonDocument::fromJson(clientsTableString).array();
+    QJsonArray clientsTable = QJsonDocument::fromJson(dump.clientsTable).array();
 
-    if (m_clientsTable.isEmpty()) {
-        migration(clientsTableString);
+    if (clientsTable.isEmpty()) {
+        migration(dump.clientsTable, clientsTable);
+
+        QSet<QString> knownIds;
+        for (const QJsonValue &client : std::as_const(clientsTable)) {
+            knownIds.insert(client.toObject().value(configKey::clientId).toString());
+        }
 
         int count = 0;
+        for (const QString &clientId : std::as_const(dump.clientIds)) {
+            if (knownIds.contains(clientId)) {
+                continue;
+            }
+            knownIds.insert(clientId);
 
-        if (container == DockerContainer::OpenVpn || container == DockerContainer::ShadowSocks || container == DockerContainer::Cloak) {
-            error = getOpenVpnClients(container, credentials, serverController, count);
-        } else if (container == DockerContainer::WireGuard || container == DockerContainer::Awg) {
-            error = getWireGuardClients(container, credentials, serverController, count);
-        }
-        if (error != ErrorCode::NoError) {
-            endResetModel();
-            return error;
+            QJsonObject client;
+            client[configKey::clientId] = clientId;
+
+            QJsonObject userData;
+            userData[configKey::clientName] = QString("Client %1").arg(count);
+            client[configKey::userData] = userData;
+
+            clientsTable.push_back(client);
+
+            count++;
         }
 
-        const QByteArray newClientsTableString = QJsonDocument(m_clientsTable).toJson();
-        if (clientsTableString != newClientsTableString) {
-            error = serverController->uploadTextFileToContainer(container, credentials, newClientsTableString, clientsTableFile);
+        const QByteArray newClientsTableString = QJsonDocument(clientsTable).toJson();
+        if (dump.clientsTable != newClientsTableString) {
+            error = serverController->uploadTextFileToContainer(container, credentials, newClientsTableString,
+                                                                clientsTableFile(container));
             if (error != ErrorCode::NoError) {
                 logger.error() << "Failed to upload the clientsTable file to the server";
             }
         }
     }
 
-    std::vector<WgShowData> data;
-    wgShow(container, credentials, serverController, data);
+    // Join the peer statistics to the clients on the client id
+    QHash<QString, qsizetype> rows;
+    rows.reserve(clientsTable.size());
+    for (qsizetype i = 0; i < clientsTable.size(); ++i) {
+        rows.insert(clientsTable.at(i).toObject().value(configKey::clientId).toString(), i);
+    }
 
-    for (const auto &client : data) {
-        int i = 0;
-        for (const auto &it : std::as_const(m_clientsTable)) {
-            if (it.isObject()) {
-                QJsonObject obj = it.toObject();
-                if (obj.contains(configKey::clientId) && obj[configKey::clientId].toString() == client.clientId) {
-                    QJsonObject userData = obj[configKey::userData].toObject();
+    for (const WgShowData &peer : std::as_const(dump.peers)) {
+        const auto row = rows.constFind(peer.clientId);
+        if (row == rows.constEnd()) {
+            continue;
+        }
 
-                    if (!client.latestHandshake.isEmpty()) {
-                        userData[configKey::latestHandshake] = client.latestHandshake;
-                    }
+        QJsonObject client = clientsTable.at(row.value()).toObject();
+        QJsonObject userData = client[configKey::userData].toObject();
 
-                    if (!client.dataReceived.isEmpty()) {
-                        userData[configKey::dataReceived] = client.dataReceived;
-                    }
+        if (!peer.latestHandshake.isEmpty()) {
+            userData[configKey::latestHandshake] = peer.latestHandshake;
+        }
 
-                    if (!client.dataSent.isEmpty()) {
-                        userData[configKey::dataSent] = client.dataSent;
-                    }
+        if (!peer.dataReceived.isEmpty()) {
+            userData[configKey::dataReceived] = peer.dataReceived;
+        }
 
-                    obj[configKey::userData] = userData;
-                    m_clientsTable.replace(i, obj);
-                    break;
-                }
-            }
-            ++i;
+        if (!peer.dataSent.isEmpty()) {
+            userData[configKey::dataSent] = peer.dataSent;
         }
+
+        client[configKey::userData] = userData;
+        clientsTable.replace(row.value(), client);
     }
 
-    endResetModel();
+    applyClientsTable(clientsTable);
     return error;
 }
 
-ErrorCode ClientManagementModel::getOpenVpnClients(const DockerContainer container, const ServerCredentials &credentials,
-                                                   const QSharedPointer<ServerController> &serverController, int &count)
+ErrorCode ClientManagementModel::getClientsDump(const DockerContainer container, const ServerCredentials &credentials,
+                                                const QSharedPointer<ServerController> &serverController, ClientsDump &dump)
 {
-    ErrorCode error = ErrorCode::NoError;
+    const bool isOpenVpn =
+            container == DockerContainer::OpenVpn || container == DockerContainer::ShadowSocks || container == DockerContainer::Cloak;
+    const bool isWireGuard = container == DockerContainer::WireGuard || container == DockerContainer::Awg;
+
+    // Everything in one command, each part after a section line. The table
+    // goes as hex, the output arrives in chunks which may split a character.
+    QStringList commands;
+    commands << QString("echo %1clients; xxd -p %2 2>/dev/null").arg(dumpSectionMarker, clientsTableFile(container));
+    if (isOpenVpn) {
+        commands << QString("echo %1issued; ls /opt/amnezia/openvpn/pki/issued 2>/dev/null").arg(dumpSectionMarker);
+    } else if (isWireGuard) {
+        const QString wireGuardConfigFile =
+                QString("/opt/amnezia/%1/wg0.conf").arg(container == DockerContainer::WireGuard ? "wireguard" : "awg");
+        commands << QString("echo %1keys; grep PublicKey %2 2>/dev/null").arg(dumpSectionMarker, wireGuardConfigFile);
+        commands << QString("echo %1now; date +%s").arg(dumpSectionMarker);
+        commands << QString("echo %1peers; wg show all dump 2>/dev/null").arg(dumpSectionMarker);
+    }
+
     QString stdOut;
     auto cbReadStdOut = [&](const QString &data, libssh::Client &) {
-        stdOut += data + "\n";
+        stdOut += data;
         return ErrorCode::NoError;
     };
 
-    const QString getOpenVpnClientsList = "sudo docker exec -i $CONTAINER_NAME bash -c 'ls /opt/amnezia/openvpn/pki/issued'";
-    QString script = serverController->replaceVars(getOpenVpnClientsList, serverController->genVarsForScript(credentials, container));
-    error = serverController->runScript(credentials, script, cbReadStdOut);
+    const QString command = QString("sudo docker exec -i $CONTAINER_NAME bash -c '%1'").arg(commands.join("; "));
+    const QString script = serverController->replaceVars(command, serverController->genVarsForScript(credentials, container));
+    ErrorCode error = serverController->runScript(credentials, script, cbReadStdOut);
     if (error != ErrorCode::NoError) {
-        logger.error() << "Failed to retrieve the list of issued certificates on the server";
+        logger.error() << "Failed to get the list of clients from the server";
         return error;
     }
 
-    if (!stdOut.isEmpty()) {
-        QStringList certsIds = stdOut.split("\n", Qt::SkipEmptyParts);
-        certsIds.removeAll("AmneziaReq.crt");
-
-        for (auto &openvpnCertId : certsIds) {
-            openvpnCertId.replace(".crt", "");
-            if (!isClientExists(openvpnCertId)) {
-                QJsonObject client;
-                client[configKey::clientId] = openvpnCertId;
-
-                QJsonObject userData;
-                userData[configKey::clientName] = QString("Client %1").arg(count);
-                client[configKey::userData] = userData;
-
-                m_clientsTable.push_back(client);
-
-                count++;
+    QString section;
+    QByteArray clientsTableHex;
+    qint64 now = 0;
+    const QStringList lines = stdOut.split('\n', Qt::SkipEmptyParts);
+    for (const QString &line : lines) {
+        if (line.startsWith(dumpSectionMarker)) {
+            section = line.mid(qstrlen(dumpSectionMarker)).trimmed();
+        } else if (section == "clients") {
+            clientsTableHex += line.trimmed().toLatin1();
+        } else if (section == "issued") {
+            QString certId = line.trimmed();
+            if (certId == "AmneziaReq.crt") {
+                continue;
+            }
+            certId.replace(".crt", "");
+            dump.clientIds.append(certId);
+        } else if (section == "keys") {
+            const QStringList configPair = line.split("=");
+            if (configPair.size() >= 2 && configPair.front().trimmed() == "PublicKey") {
+                dump.clientIds.append(line.mid(line.indexOf('=') + 1).trimmed());
+            }
+        } else if (section == "now") {
+            now = line.trimmed().toLongLong();
+        } else if (section == "peers") {
+            // interface, public key, psk, endpoint, allowed ips, latest
+            // handshake, rx bytes, tx bytes, keepalive
+            const QStringList fields = line.split('\t');
+            if (fields.size() != 9) {
+                continue;
             }
-        }
-    }
-    return error;
-}
-
-ErrorCode ClientManagementModel::getWireGuardClients(const DockerContainer container, const ServerCredentials &credentials,
-                                                     const QSharedPointer<ServerController> &serverController, int &count)
-{
-    ErrorCode error = ErrorCode::NoError;
-
-    const QString wireGuardConfigFile = QString("opt/amnezia/%1/wg0.conf").arg(container == DockerContainer::WireGuard ? "wireguard" : "awg");
-    const QString wireguardConfigString = serverController->getTextFileFromContainer(container, credentials, wireGuardConfigFile, error);
-    if (error != ErrorCode::NoError) {
-        logger.error() << "Failed to get the wg conf file from the server";
-        return error;
-    }
 
-    auto configLines = wireguardConfigString.split("\n", Qt::SkipEmptyParts);
-    QStringList wireguardKeys;
-    for (const auto &line : configLines) {
-        auto configPair = line.split(" = ", Qt::SkipEmptyParts);
-        if (configPair.front() == "PublicKey") {
-            wireguardKeys.push_back(configPair.back());
+            const qint64 latestHandshake = fields.at(5).toLongLong();
+            // The server sends what the client receives
+            dump.peers.append({ fields.at(1), latestHandshake > 0 ? formatHandshake(now, latestHandshake) : QString(),
+                                formatBytes(fields.at(7).toULongLong()), formatBytes(fields.at(6).toULongLong()) });
         }
     }
+    dump.clientsTable = QByteArray::fromHex(clientsTableHex);
 
-    for (auto &wireguardKey : wireguardKeys) {
-        if (!isClientExists(wireguardKey)) {
-            QJsonObject client;
-            client[configKey::clientId] = wireguardKey;
-
-            QJsonObject userData;
-            userData[configKey::clientName] = QString("Client %1").arg(count);
-            client[configKey::userData] = userData;
-
-            m_clientsTable.push_back(client);
-
-            count++;
-        }
-    }
     return error;
 }
 
-ErrorCode ClientManagementModel::wgShow(const DockerContainer container, const ServerCredentials &credentials,
-                                        const QSharedPointer<ServerController> &serverController, std::vector<WgShowData> &data)
+void ClientManagementModel::applyClientsTable(const QJsonArray &clientsTable)
 {
-    if (container != DockerContainer::WireGuard && container != DockerContainer::Awg) {
-        return ErrorCode::NoError;
-    }
-
-    ErrorCode error = ErrorCode::NoError;
-    QString stdOut;
-    auto cbReadStdOut = [&](const QString &data, libssh::Client &) {
-        stdOut += data + "\n";
-        return ErrorCode::NoError;
+    const auto clientIdAt = [](const QJsonArray &table, qsizetype i) {
+        return table.at(i).toObject().value(configKey::clientId).toString();
     };
 
-    const QString command = QString("sudo docker exec -i $CONTAINER_NAME bash -c '%1'").arg("wg show all");
+    QHash<QString, qsizetype> newRows;
+    newRows.reserve(clientsTable.size());
+    for (qsizetype i = 0; i < clientsTable.size(); ++i) {
+        newRows.insert(clientIdAt(clientsTable, i), i);
+    }
+
+    // Rows are only removed, inserted and changed. Duplicate ids or clients
+    // that changed places reset the model instead.
+    bool canDiff = newRows.size() == clientsTable.size();
+    QSet<QString> oldIds;
+    qsizetype lastNewRow = -1;
+    for (qsizetype i = 0; canDiff && i < m_clientsTable.size(); ++i) {
+        const QString clientId = clientIdAt(m_clientsTable, i);
+        if (oldIds.contains(clientId)) {
+            canDiff = false;
+        }
+        oldIds.insert(clientId);
 
-    QString script = serverController->replaceVars(command, serverController->genVarsForScript(credentials, container));
-    error = serverController->runScript(credentials, script, cbReadStdOut);
-    if (error != ErrorCode::NoError) {
-        logger.error() << "Failed to execute wg show command";
-        return error;
+        const auto newRow = newRows.constFind(clientId);
+        if (newRow != newRows.constEnd()) {
+            canDiff = canDiff && newRow.value() > lastNewRow;
+            lastNewRow = newRow.value();
+        }
     }
 
-    if (stdOut.isEmpty()) {
-        return error;
+    if (!canDiff) {
+        beginResetModel();
+        m_clientsTable = clientsTable;
+        endResetModel();
+        return;
     }
 
-    const auto getStrValue = [](const auto str) { return str.mid(str.indexOf(":") + 1).trimmed(); };
-
-    const auto parts = stdOut.split('\n');
-    const auto peerList = parts.filter("peer:");
-    const auto latestHandshakeList = parts.filter("latest handshake:");
-    const auto transferredDataList = parts.filter("transfer:");
-
-    if (latestHandshakeList.isEmpty() || transferredDataList.isEmpty() || peerList.isEmpty()) {
-        return error;
-    }
+    // Clients gone from the server, from the end so row numbers stay valid
+    for (qsizetype last = m_clientsTable.size() - 1; last >= 0;) {
+        if (newRows.contains(clientIdAt(m_clientsTable, last))) {
+            --last;
+            continue;
+        }
 
-    const auto changeHandshakeFormat = [](QString &latestHandshake) {
-        const std::vector<std::pair<QString, QString>> replaceMap = { { " days", "d" },    { " hours", "h" }, { " minutes", "m" },
-                                                                      { " seconds", "s" }, { " day", "d" },   { " hour", "h" },
-                                                                      { " minute", "m" },  { " second", "s" } };
+        qsizetype first = last;
+        while (first > 0 && !newRows.contains(clientIdAt(m_clientsTable, first - 1))) {
+            --first;
+        }
 
-        for (const auto &item : replaceMap) {
-            latestHandshake.replace(item.first, item.second);
+        beginRemoveRows(QModelIndex(), first, last);
+        for (qsizetype i = last; i >= first; --i) {
+            m_clientsTable.removeAt(i);
         }
-    };
+        endRemoveRows();
 
-    for (int i = 0; i < peerList.size() && i < transferredDataList.size() && i < latestHandshakeList.size(); ++i) {
+        last = first - 1;
+    }
 
-        const auto transferredData = getStrValue(transferredDataList[i]).split(",");
-        auto latestHandshake = getStrValue(latestHandshakeList[i]);
-        auto serverBytesReceived = transferredData.front().trimmed();
-        auto serverBytesSent = transferredData.back().trimmed();
+    // The remaining clients are in the same order as in the new table, so
+    // every mismatch is the start of a run of new clients
+    for (qsizetype row = 0; row < clientsTable.size();) {
+        if (row < m_clientsTable.size() && clientIdAt(m_clientsTable, row) == clientIdAt(clientsTable, row)) {
+            ++row;
+            continue;
+        }
 
-        changeHandshakeFormat(latestHandshake);
+        qsizetype last = row;
+        while (last + 1 < clientsTable.size() && !oldIds.contains(clientIdAt(clientsTable, last + 1))) {
+            ++last;
+        }
 
-        serverBytesReceived.chop(QStringLiteral(" received").length());
-        serverBytesSent.chop(QStringLiteral(" sent").length());
+        beginInsertRows(QModelIndex(), row, last);
+        for (qsizetype i = row; i <= last; ++i) {
+            m_clientsTable.insert(i, clientsTable.at(i));
+        }
+        endInsertRows();
 
-        data.push_back({ getStrValue(peerList[i]), latestHandshake, serverBytesSent, serverBytesReceived });
+        row = last + 1;
     }
 
-    return error;
+    qsizetype firstChanged = -1;
+    for (qsizetype row = 0; row <= m_clientsTable.size(); ++row) {
+        const bool changed = row < m_clientsTable.size() && m_clientsTable.at(row) != clientsTable.at(row);
+        if (changed) {
+            m_clientsTable.replace(row, clientsTable.at(row));
+            if (firstChanged < 0) {
+                firstChanged = row;
+            }
+        } else if (firstChanged >= 0) {
+            emit dataChanged(index(firstChanged, 0), index(row - 1, 0));
+            firstChanged = -1;
+        }
+    }
 }
 
-bool ClientManagementModel::isClientExists(const QString &clientId)
+QString ClientManagementModel::clientsTableFile(const DockerContainer container)
 {
-    for (const QJsonValue &value : std::as_const(m_clientsTable)) {
-        if (value.isObject()) {
-            QJsonObject obj = value.toObject();
-            if (obj.contains(configKey::clientId) && obj[configKey::clientId].toString() == clientId) {
-                return true;
-            }
-        }
+    const QString path = QString("/opt/amnezia/%1/clientsTable");
+    if (container == DockerContainer::OpenVpn || container == DockerContainer::ShadowSocks || container == DockerContainer::Cloak) {
+        return path.arg(ContainerProps::containerTypeToString(DockerContainer::OpenVpn));
     }
-    return false;
+    return path.arg(ContainerProps::containerTypeToString(container));
 }
 
 ErrorCode ClientManagementModel::appendClient(const DockerContainer container, const ServerCredentials &credentials,
@@ -359,14 +443,8 @@ ErrorCode ClientManagementModel::appendClient(const QString &clientId, const QSt
 
     const QByteArray clientsTableString = QJsonDocument(m_clientsTable).toJson();
 
-    QString clientsTableFile = QString("/opt/amnezia/%1/clientsTable");
-    if (container == DockerContainer::OpenVpn || container == DockerContainer::ShadowSocks || container == DockerContainer::Cloak) {
-        clientsTableFile = clientsTableFile.arg(ContainerProps::containerTypeToString(DockerContainer::OpenVpn));
-    } else {
-        clientsTableFile = clientsTableFile.arg(ContainerProps::containerTypeToString(container));
-    }
 
-    error = serverController->uploadTextFileToContainer(container, credentials, clientsTableString, clientsTableFile);
+    error = serverController->uploadTextFileToContainer(container, credentials, clientsTableString, clientsTableFile(container));
     if (error != ErrorCode::NoError) {
         logger.error() << "Failed to upload the clientsTable file to the server";
     }
@@ -391,14 +469,8 @@ ErrorCode ClientManagementModel::renameClient(const int row, const QString &clie
 
     const QByteArray clientsTableString = QJsonDocument(m_clientsTable).toJson();
 
-    QString clientsTableFile = QString("/opt/amnezia/%1/clientsTable");
-    if (container == DockerContainer::OpenVpn || container == DockerContainer::ShadowSocks || container == DockerContainer::Cloak) {
-        clientsTableFile = clientsTableFile.arg(ContainerProps::containerTypeToString(DockerContainer::OpenVpn));
-    } else {
-        clientsTableFile = clientsTableFile.arg(ContainerProps::containerTypeToString(container));
-    }
 
-    ErrorCode error = serverController->uploadTextFileToContainer(container, credentials, clientsTableString, clientsTableFile);
+    ErrorCode error = serverController->uploadTextFileToContainer(container, credentials, clientsTableString, clientsTableFile(container));
     if (error != ErrorCode::NoError) {
         logger.error() << "Failed to upload the clientsTable file to the server";
     }
@@ -513,9 +585,7 @@ ErrorCode ClientManagementModel::revokeOpenVpn(const int row, const DockerContai
 
     const QByteArray clientsTableString = QJsonDocument(m_clientsTable).toJson();
 
-    QString clientsTableFile = QString("/opt/amnezia/%1/clientsTable");
-    clientsTableFile = clientsTableFile.arg(ContainerProps::containerTypeToString(DockerContainer::OpenVpn));
-    error = serverController->uploadTextFileToContainer(container, credentials, clientsTableString, clientsTableFile);
+    error = serverController->uploadTextFileToContainer(container, credentials, clientsTableString, clientsTableFile(container));
     if (error != ErrorCode::NoError) {
         logger.error() << "Failed to upload the clientsTable file to the server";
         return error;
@@ -561,13 +631,7 @@ ErrorCode ClientManagementModel::revokeWireGuard(const int row, const DockerCont
 
     const QByteArray clientsTableString = QJsonDocument(m_clientsTable).toJson();
 
-    QString clientsTableFile = QString("/opt/amnezia/%1/clientsTable");
-    if (container == DockerContainer::OpenVpn || container == DockerContainer::ShadowSocks || container == DockerContainer::Cloak) {
-        clientsTableFile = clientsTableFile.arg(ContainerProps::containerTypeToString(DockerContainer::OpenVpn));
-    } else {
-        clientsTableFile = clientsTableFile.arg(ContainerProps::containerTypeToString(container));
-    }
-    error = serverController->uploadTextFileToContainer(container, credentials, clientsTableString, clientsTableFile);
+    error = serverController->uploadTextFileToContainer(container, credentials, clientsTableString, clientsTableFile(container));
     if (error != ErrorCode::NoError) {
         logger.error() << "Failed to upload the clientsTable file to the server";
         return error;
@@ -54,23 +54,29 @@ signals:
     void adminConfigRevoked(const DockerContainer container);
 
 private:
-    bool isClientExists(const QString &clientId);
+    // What updateModel needs from the server, fetched with one command
+    struct ClientsDump
+    {
+        QByteArray clientsTable;
+        // Issued certificates or peer keys in the server config
+        QStringList clientIds;
+        QList<WgShowData> peers;
+    };
+
+    void migration(const QByteArray &clientsTableString, QJsonArray &clientsTable);
 
-    void migration(const QByteArray &clientsTableString);
+    ErrorCode getClientsDump(const DockerContainer container, const ServerCredentials &credentials,
+                             const QSharedPointer<ServerController> &serverController, ClientsDump &dump);
+    // Updates the rows in place where the clients kept their order
+    void applyClientsTable(const QJsonArray &clientsTable);
+
+    static QString clientsTableFile(const DockerContainer container);
 
     ErrorCode revokeOpenVpn(const int row, const DockerContainer container, const ServerCredentials &credentials, const int serverIndex,
                             const QSharedPointer<ServerController> &serverController);
     ErrorCode revokeWireGuard(const int row, const DockerContainer container, const ServerCredentials &credentials,
                               const QSharedPointer<ServerController> &serverController);
 
-    ErrorCode getOpenVpnClients(const DockerContainer container, const ServerCredentials &credentials,
-                                const QSharedPointer<ServerController> &serverController, int &count);
-    ErrorCode getWireGuardClients(const DockerContainer container, const ServerCredentials &credentials,
-                                  const QSharedPointer<ServerController> &serverController, int &count);
-
-    ErrorCode wgShow(const DockerContainer container, const ServerCredentials &credentials,
-                     const QSharedPointer<ServerController> &serverController, std::vector<WgShowData> &data);
-
     QJsonArray m_clientsTable;
 
     std::shared_ptr<Settings> m_settings;
@@ -0,0 +1,95 @@
+#include "logModel.h"
+
+LogModel::LogModel(int capacity, QObject *parent) : QAbstractListModel(parent)
+{
+    m_lines.resize(qMax(1, capacity));
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return m_count;
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_count) {
+        return QVariant();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case TextRole: return lineAt(index.row());
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> LogModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[TextRole] = "text";
+    return roles;
+}
+
+const QString &LogModel::lineAt(int row) const
+{
+    return m_lines.at((m_first + row) % m_lines.size());
+}
+
+void LogModel::append(const QString &line)
+{
+    append(QStringList { line });
+}
+
+void LogModel::append(const QStringList &lines)
+{
+    const int capacity = m_lines.size();
+
+    // Only the tail of an oversized batch would survive anyway.
+    const int skip = qMax(0, int(lines.size()) - capacity);
+    const int added = lines.size() - skip;
+    if (added == 0) {
+        return;
+    }
+
+    const int overflow = m_count + added - capacity;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        for (int i = 0; i < overflow; ++i) {
+            m_lines[(m_first + i) % capacity] = QString();
+        }
+        m_first = (m_first + overflow) % capacity;
+        m_count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_count, m_count + added - 1);
+    for (int i = skip; i < lines.size(); ++i) {
+        m_lines[(m_first + m_count) % capacity] = lines.at(i);
+        ++m_count;
+    }
+    endInsertRows();
+}
+
+QString LogModel::text() const
+{
+    QString result;
+    for (int row = 0; row < m_count; ++row) {
+        result += lineAt(row);
+        result += '\n';
+    }
+    return result;
+}
+
+void LogModel::clear()
+{
+    if (m_count == 0) {
+        return;
+    }
+
+    beginResetModel();
+    m_lines.fill(QString());
+    m_first = 0;
+    m_count = 0;
+    endResetModel();
+}
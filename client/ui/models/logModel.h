@@ -0,0 +1,44 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QVector>
+
+// Fixed-capacity ring of log lines. Appending past the capacity drops the
+// oldest lines, and views only receive row insert/remove notifications.
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        TextRole = Qt::UserRole + 1
+    };
+
+    static constexpr int DEFAULT_CAPACITY = 5000;
+
+    explicit LogModel(int capacity = DEFAULT_CAPACITY, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void append(const QString &line);
+    void append(const QStringList &lines);
+
+public slots:
+    QString text() const;
+    void clear();
+
+protected:
+    QHash<int, QByteArray> roleNames() const override;
+
+private:
+    const QString &lineAt(int row) const;
+
+    QVector<QString> m_lines;
+    int m_first = 0;
+    int m_count = 0;
+};
+
+#endif // LOGMODEL_H
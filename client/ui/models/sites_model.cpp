@@ -1,7 +1,7 @@
 #include "sites_model.h"
 
 SitesModel::SitesModel(std::shared_ptr<Settings> settings, QObject *parent)
-    : QAbstractListModel(parent), m_settings(settings)
+    : QAbstractListModel(parent), m_settings(settings), m_sites(settings)
 {
     m_isSplitTunnelingEnabled = m_settings->isSitesSplitTunnelingEnabled();
     m_currentRouteMode = m_settings->routeMode();
@@ -9,13 +9,13 @@ SitesModel::SitesModel(std::shared_ptr<Settings> settings, QObject *parent)
         m_settings->setRouteMode(static_cast<Settings::RouteMode>(Settings::VpnOnlyForwardSites));
         m_currentRouteMode = Settings::VpnOnlyForwardSites;
     }
-    fillSites();
+    m_sites.load(m_currentRouteMode);
 }
 
 int SitesModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
-    return m_sites.size();
+    return m_sites.count();
 }
 
 QVariant SitesModel::data(const QModelIndex &index, int role) const
@@ -25,11 +25,11 @@ QVariant SitesModel::data(const QModelIndex &index, int role) const
 
     switch (role) {
     case UrlRole: {
-        return m_sites.at(index.row()).first;
+        return m_sites.at(index.row()).hostname;
         break;
     }
     case IpRole: {
-        return m_sites.at(index.row()).second;
+        return m_sites.at(index.row()).ip;
         break;
     }
     default: {
@@ -42,45 +42,47 @@ QVariant SitesModel::data(const QModelIndex &index, int role) const
 
 bool SitesModel::addSite(const QString &hostname, const QString &ip)
 {
-    if (!m_settings->addVpnSite(m_currentRouteMode, hostname, ip)) {
-        return false;
+    int row;
+    if (!m_sites.contains(hostname)) {
+        beginInsertRows(QModelIndex(), m_sites.count(), m_sites.count());
+        m_sites.add({ hostname, ip }, row);
+        endInsertRows();
+        emitChangedRows();
+        return true;
     }
-    for (int i = 0; i < m_sites.size(); i++) {
-        if (m_sites[i].first == hostname && (m_sites[i].second.isEmpty() && !ip.isEmpty())) {
-            m_sites[i].second = ip;
-            QModelIndex index = createIndex(i, i);
-            emit dataChanged(index, index);
-            return true;
-        } else if (m_sites[i].first == hostname && (m_sites[i].second == ip)) {
-            return false;
-        }
+
+    if (m_sites.add({ hostname, ip }, row) == SiteStore::Updated) {
+        QModelIndex index = createIndex(row, 0);
+        emit dataChanged(index, index);
+        emitChangedRows();
+        return true;
     }
-    beginInsertRows(QModelIndex(), rowCount(), rowCount());
-    m_sites.append(qMakePair(hostname, ip));
-    endInsertRows();
-    return true;
+    return false;
 }
 
-void SitesModel::addSites(const QMap<QString, QString> &sites, bool replaceExisting)
+void SitesModel::addSites(const QList<SiteStore::Site> &sites, bool replaceExisting)
 {
     beginResetModel();
-
-    if (replaceExisting) {
-        m_settings->removeAllVpnSites(m_currentRouteMode);
-    }
-    m_settings->addVpnSites(m_currentRouteMode, sites);
-    fillSites();
-
+    m_sites.addAll(sites, replaceExisting);
+    m_sites.takeChangedRows();
     endResetModel();
 }
 
 void SitesModel::removeSite(QModelIndex index)
 {
-    auto hostname = m_sites.at(index.row()).first;
     beginRemoveRows(QModelIndex(), index.row(), index.row());
-    m_settings->removeVpnSite(m_currentRouteMode, hostname);
     m_sites.removeAt(index.row());
     endRemoveRows();
+    emitChangedRows();
+}
+
+void SitesModel::emitChangedRows()
+{
+    const QList<int> rows = m_sites.takeChangedRows();
+    for (int row : rows) {
+        QModelIndex index = createIndex(row, 0);
+        emit dataChanged(index, index, { IpRole });
+    }
 }
 
 int SitesModel::getRouteMode()
@@ -93,7 +95,7 @@ void SitesModel::setRouteMode(int routeMode)
     beginResetModel();
     m_settings->setRouteMode(static_cast<Settings::RouteMode>(routeMode));
     m_currentRouteMode = m_settings->routeMode();
-    fillSites();
+    m_sites.load(m_currentRouteMode);
     endResetModel();
     emit routeModeChanged();
 }
@@ -110,11 +112,6 @@ void SitesModel::toggleSplitTunneling(bool enabled)
     emit splitTunnelingToggled();
 }
 
-QVector<QPair<QString, QString> > SitesModel::getCurrentSites()
-{
-    return m_sites;
-}
-
 QHash<int, QByteArray> SitesModel::roleNames() const
 {
     QHash<int, QByteArray> roles;
@@ -122,14 +119,3 @@ QHash<int, QByteArray> SitesModel::roleNames() const
     roles[IpRole] = "ip";
     return roles;
 }
-
-void SitesModel::fillSites()
-{
-    m_sites.clear();
-    const QVariantMap &sites = m_settings->vpnSites(m_currentRouteMode);
-    auto i = sites.constBegin();
-    while (i != sites.constEnd()) {
-        m_sites.append(qMakePair(i.key(), i.value().toString()));
-        ++i;
-    }
-}
@@ -4,6 +4,7 @@
 #include <QAbstractListModel>
 
 #include "settings.h"
+#include "sitestore.h"
 
 class SitesModel : public QAbstractListModel
 {
@@ -26,7 +27,7 @@ public:
 
 public slots:
     bool addSite(const QString &hostname, const QString &ip);
-    void addSites(const QMap<QString, QString> &sites, bool replaceExisting);
+    void addSites(const QList<SiteStore::Site> &sites, bool replaceExisting);
     void removeSite(QModelIndex index);
 
     int getRouteMode();
@@ -35,7 +36,7 @@ public slots:
     bool isSplitTunnelingEnabled();
     void toggleSplitTunneling(bool enabled);
 
-    QVector<QPair<QString, QString>> getCurrentSites();
+    const SiteStore &sites() const { return m_sites; }
 
 signals:
     void routeModeChanged();
@@ -45,14 +46,14 @@ protected:
     QHash<int, QByteArray> roleNames() const override;
 
 private:
-    void fillSites();
+    void emitChangedRows();
 
     std::shared_ptr<Settings> m_settings;
 
     bool m_isSplitTunnelingEnabled;
     Settings::RouteMode m_currentRouteMode;
 
-    QVector<QPair<QString, QString>> m_sites;
+    SiteStore m_sites;
 };
 
 #endif // SITESMODEL_H
@@ -2,7 +2,6 @@
 
 #include <QDebug>
 #include <QFile>
-#include <QHostInfo>
 #include <QJsonObject>
 #include <QEventLoop>
 
@@ -26,11 +25,13 @@
     #include "platforms/ios/ios_controller.h"
 #endif
 
+#include "core/dnsResolver.h"
 #include "core/networkUtilities.h"
+#include "spantracer.h"
 #include "vpnconnection.h"
 
 VpnConnection::VpnConnection(std::shared_ptr<Settings> settings, QObject *parent)
-    : QObject(parent), m_settings(settings), m_checkTimer(new QTimer(this))
+    : QObject(parent), m_settings(settings), m_checkTimer(new QTimer(this)), m_dnsResolver(new DnsResolver(this))
 {
     m_checkTimer.setInterval(1000);
 #ifdef Q_OS_IOS
@@ -55,12 +56,22 @@ void VpnConnection::onBytesChanged(quint64 receivedBytes, quint64 sentBytes)
 
 void VpnConnection::onConnectionStateChanged(Vpn::ConnectionState state)
 {
+    SpanTracer &tracer = SpanTracer::instance();
+    if (state == Vpn::ConnectionState::Connected) {
+        tracer.end("connect.tunnelUp");
+        tracer.end("connect");
+    } else if (state == Vpn::ConnectionState::Error || state == Vpn::ConnectionState::Disconnected) {
+        tracer.cancel("connect.tunnelUp");
+        tracer.cancel("connect");
+        tracer.cancel("connect.sitesRoutesDelay");
+    }
 
 #ifdef AMNEZIA_DESKTOP
     QString proto = m_settings->defaultContainerName(m_settings->defaultServerIndex());
     
     if (IpcClient::Interface()) {
         if (state == Vpn::ConnectionState::Connected) {
+            SpanTracer::Scope span("connect.routes");
             IpcClient::Interface()->resetIpStack();
             IpcClient::Interface()->flushDns();
 
@@ -74,8 +85,12 @@ void VpnConnection::onConnectionStateChanged(Vpn::ConnectionState state)
                     IpcClient::Interface()->routeDeleteList(m_vpnProtocol->vpnGateway(), QStringList() << "0.0.0.0");
                         // qDebug() << "VpnConnection::onConnectionStateChanged :: adding custom routes, count:" << forwardIps.size();
                     if (m_settings->routeMode() == Settings::VpnOnlyForwardSites) {
-                        QTimer::singleShot(1000, m_vpnProtocol.data(),
-                                           [this]() { addSitesRoutes(m_vpnProtocol->vpnGateway(), m_settings->routeMode()); });
+                        tracer.begin("connect.sitesRoutesDelay");
+                        QTimer::singleShot(1000, m_vpnProtocol.data(), [this]() {
+                            SpanTracer::instance().end("connect.sitesRoutesDelay");
+                            addSitesRoutes(m_vpnProtocol->vpnGateway(), m_settings->routeMode());
+                            SpanTracer::instance().writeTrace();
+                        });
                     } else if (m_settings->routeMode() == Settings::VpnAllExceptSites) {
                         IpcClient::Interface()->routeAddList(m_vpnProtocol->vpnGateway(), QStringList() << "0.0.0.0/1");
                         IpcClient::Interface()->routeAddList(m_vpnProtocol->vpnGateway(), QStringList() << "128.0.0.0/1");
@@ -101,6 +116,10 @@ void VpnConnection::onConnectionStateChanged(Vpn::ConnectionState state)
     }
 #endif
 
+    if (state == Vpn::ConnectionState::Connected) {
+        tracer.writeTrace();
+    }
+
 #ifdef Q_OS_IOS
     if (state == Vpn::ConnectionState::Connected) {
         m_checkTimer.start();
@@ -118,6 +137,7 @@ const QString &VpnConnection::remoteAddress() const
 
 void VpnConnection::addSitesRoutes(const QString &gw, Settings::RouteMode mode)
 {
+    SpanTracer::Scope span("connect.addSitesRoutes");
 #ifdef AMNEZIA_DESKTOP
     QStringList ips;
     QStringList sites;
@@ -134,30 +154,77 @@ void VpnConnection::addSitesRoutes(const QString &gw, Settings::RouteMode mode)
     }
     ips.removeDuplicates();
 
-    // add all IPs immediately
-    IpcClient::Interface()->routeAddList(gw, ips);
-
-    // re-resolve domains
-    for (const QString &site : sites) {
-        const auto &cbResolv = [this, site, gw, mode, ips](const QHostInfo &hostInfo) {
-            const QList<QHostAddress> &addresses = hostInfo.addresses();
-            QString ipv4Addr;
-            for (const QHostAddress &addr : hostInfo.addresses()) {
-                if (addr.protocol() == QAbstractSocket::NetworkLayerProtocol::IPv4Protocol) {
-                    const QString &ip = addr.toString();
-                    // qDebug() << "VpnConnection::addSitesRoutes updating site" << site << ip;
-                    if (!ips.contains(ip)) {
-                        IpcClient::Interface()->routeAddList(gw, QStringList() << ip);
-                        m_settings->addVpnSite(mode, site, ip);
-                    }
-                    flushDns();
-                    break;
-                }
+    // add all IPs immediately, adjacent addresses are collapsed into shared prefixes
+    m_sitesGateway = gw;
+    m_sitesIps = QSet<QString>(ips.cbegin(), ips.cend());
+    m_sitesRoutes.clear();
+    applySitesRoutes();
+
+    // re-resolve domains, the new addresses go out in one route update
+    m_dnsResolver->resolve(sites, DnsResolver::Ipv4, this, [this, gw, mode, ips](const DnsResolver::Result &result) {
+        QStringList newIps;
+        QMap<QString, QString> resolvedSites;
+        for (auto it = result.constBegin(); it != result.constEnd(); ++it) {
+            if (it->isEmpty()) {
+                continue;
+            }
+            const QString &ip = it->first().toString();
+            if (!ips.contains(ip)) {
+                newIps.append(ip);
+                resolvedSites.insert(it.key(), ip);
             }
-        };
-        QHostInfo::lookupHost(site, this, cbResolv);
+        }
+
+        if (!newIps.isEmpty()) {
+            // Reconnected meanwhile, the new connection resolves on its own
+            if (gw == m_sitesGateway) {
+                m_sitesIps.unite(QSet<QString>(newIps.cbegin(), newIps.cend()));
+                applySitesRoutes();
+            }
+            m_settings->addVpnSites(mode, resolvedSites);
+        }
+        flushDns();
+    });
+#endif
+}
+
+// Site routes are installed as merged prefixes, so a single address can't be
+// deleted on its own. Every change recomputes the prefixes for all routed
+// addresses and replaces only the ones that differ, adding the new prefixes
+// before deleting the old so the remaining addresses stay routed throughout.
+void VpnConnection::applySitesRoutes()
+{
+#ifdef AMNEZIA_DESKTOP
+    if (!IpcClient::Interface()) {
+        return;
+    }
+
+    const QStringList routes = NetworkUtilities::summarizeRoutes(QStringList(m_sitesIps.cbegin(), m_sitesIps.cend()));
+    const QSet<QString> newRoutes(routes.cbegin(), routes.cend());
+    const QSet<QString> oldRoutes(m_sitesRoutes.cbegin(), m_sitesRoutes.cend());
+
+    const QSet<QString> added = newRoutes - oldRoutes;
+    const QSet<QString> removed = oldRoutes - newRoutes;
+    if (!added.isEmpty()) {
+        IpcClient::Interface()->routeAddList(m_sitesGateway, QStringList(added.cbegin(), added.cend()));
+    }
+    if (!removed.isEmpty()) {
+        IpcClient::Interface()->routeDeleteList(m_sitesGateway, QStringList(removed.cbegin(), removed.cend()));
+    }
+    m_sitesRoutes = routes;
+#endif
+}
+
+QString VpnConnection::sitesRouteGateway() const
+{
+#ifdef AMNEZIA_DESKTOP
+    if (m_settings->routeMode() == Settings::VpnOnlyForwardSites) {
+        return m_vpnProtocol->vpnGateway();
+    } else if (m_settings->routeMode() == Settings::VpnAllExceptSites) {
+        return m_vpnProtocol->routeGateway();
     }
 #endif
+    return QString();
 }
 
 QSharedPointer<VpnProtocol> VpnConnection::vpnProtocol() const
@@ -169,11 +236,18 @@ void VpnConnection::addRoutes(const QStringList &ips)
 {
 #ifdef AMNEZIA_DESKTOP
     if (connectionState() == Vpn::ConnectionState::Connected && IpcClient::Interface()) {
-        if (m_settings->routeMode() == Settings::VpnOnlyForwardSites) {
-            IpcClient::Interface()->routeAddList(m_vpnProtocol->vpnGateway(), ips);
-        } else if (m_settings->routeMode() == Settings::VpnAllExceptSites) {
-            IpcClient::Interface()->routeAddList(m_vpnProtocol->routeGateway(), ips);
+        const QString gw = sitesRouteGateway();
+        if (gw.isEmpty()) {
+            return;
         }
+        if (gw != m_sitesGateway) {
+            m_sitesGateway = gw;
+            m_sitesIps.clear();
+            m_sitesRoutes.clear();
+        }
+
+        m_sitesIps.unite(QSet<QString>(ips.cbegin(), ips.cend()));
+        applySitesRoutes();
     }
 #endif
 }
@@ -182,11 +256,24 @@ void VpnConnection::deleteRoutes(const QStringList &ips)
 {
 #ifdef AMNEZIA_DESKTOP
     if (connectionState() == Vpn::ConnectionState::Connected && IpcClient::Interface()) {
-        if (m_settings->routeMode() == Settings::VpnOnlyForwardSites) {
-            IpcClient::Interface()->routeDeleteList(vpnProtocol()->vpnGateway(), ips);
-        } else if (m_settings->routeMode() == Settings::VpnAllExceptSites) {
-            IpcClient::Interface()->routeDeleteList(m_vpnProtocol->routeGateway(), ips);
+        if (sitesRouteGateway() != m_sitesGateway) {
+            return;
+        }
+
+        // Another site may resolve to the same address, keep its route
+        QSet<QString> stillUsed;
+        const QVariantMap &sites = m_settings->vpnSites(m_settings->routeMode());
+        for (auto i = sites.constBegin(); i != sites.constEnd(); ++i) {
+            stillUsed.insert(i.key());
+            stillUsed.insert(i.value().toString());
         }
+
+        for (const QString &ip : ips) {
+            if (!stillUsed.contains(ip)) {
+                m_sitesIps.remove(ip);
+            }
+        }
+        applySitesRoutes();
     }
 #endif
 }
@@ -215,6 +302,7 @@ ErrorCode VpnConnection::lastError() const
 void VpnConnection::connectToVpn(int serverIndex, const ServerCredentials &credentials, DockerContainer container,
                                  const QJsonObject &vpnConfiguration)
 {
+    SpanTracer::Scope span("connect.connectToVpn");
     qDebug() << QString("ConnectToVpn, Server index is %1, container is %2, route mode is")
                         .arg(serverIndex)
                         .arg(ContainerProps::containerToString(container))
@@ -271,7 +359,12 @@ void VpnConnection::connectToVpn(int serverIndex, const ServerCredentials &crede
 
     createProtocolConnections();
 
-    ErrorCode errorCode = m_vpnProtocol.data()->start();
+    SpanTracer::instance().begin("connect.tunnelUp");
+    ErrorCode errorCode;
+    {
+        SpanTracer::Scope span("connect.protocolStart");
+        errorCode = m_vpnProtocol.data()->start();
+    }
     if (errorCode != ErrorCode::NoError)
         emit connectionStateChanged(Vpn::ConnectionState::Error);
 }
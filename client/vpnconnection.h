@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QString>
 #include <QScopedPointer>
+#include <QSet>
 #include <QRemoteObjectNode>
 #include <QTimer>
 
@@ -21,6 +22,8 @@
 
 using namespace amnezia;
 
+class DnsResolver;
+
 class VpnConnection : public QObject
 {
     Q_OBJECT
@@ -80,6 +83,14 @@ private:
     // Only for iOS for now, check counters
     QTimer m_checkTimer;
 
+    DnsResolver *m_dnsResolver;
+
+    // Split tunneling addresses routed for this connection, and the merged
+    // prefixes installed for them through m_sitesGateway
+    QSet<QString> m_sitesIps;
+    QStringList m_sitesRoutes;
+    QString m_sitesGateway;
+
 #ifdef AMNEZIA_DESKTOP
     IpcClient *m_IpcClient {nullptr};
 #endif
@@ -95,6 +106,9 @@ private:
 
    void appendSplitTunnelingConfig();
    void appendKillSwitchConfig();
+
+   void applySitesRoutes();
+   QString sitesRouteGateway() const;
 };
 
 #endif // VPNCONNECTION_H
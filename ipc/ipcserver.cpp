@@ -7,6 +7,7 @@
 
 #include "router.h"
 #include "logger.h"
+#include "spantracer.h"
 
 #include "../client/protocols/protocols_defs.h"
 #ifdef Q_OS_WIN
@@ -87,6 +88,7 @@ int IpcServer::routeAddList(const QString &gw, const QStringList &ips)
     qDebug() << "IpcServer::routeAddList";
 #endif
 
+    SpanTracer::Scope span("ipc.routeAddList");
     return Router::routeAddList(gw, ips);
 }
 
@@ -105,7 +107,7 @@ bool IpcServer::routeDeleteList(const QString &gw, const QStringList &ips)
     qDebug() << "IpcServer::routeDeleteList";
 #endif
 
-    return Router::routeDeleteList(gw ,ips);
+    return Router::routeDeleteList(gw, ips) > 0;
 }
 
 void IpcServer::flushDns()
@@ -168,6 +170,7 @@ void IpcServer::clearLogs() {
 
 bool IpcServer::createTun(const QString &dev, const QString &subnet)
 {
+    SpanTracer::Scope span("ipc.createTun");
     return Router::createTun(dev, subnet);
 }
 
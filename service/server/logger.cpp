@@ -1,17 +1,17 @@
 #include "logger.h"
 
 #include <QDir>
+#include <QFileInfo>
 #include <QJsonDocument>
 #include <QMetaEnum>
 #include <QStandardPaths>
 
-#include <iostream>
-
+#include "spantracer.h"
 #include "version.h"
 #include "utilities.h"
 
-QFile Logger::m_file;
-QTextStream Logger::m_textStream;
+RotatingLogFile Logger::m_file;
+LogWriter Logger::m_writer;
 QString Logger::m_logFileName = QString("%1.log").arg(SERVICE_NAME);
 
 void debugMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& msg)
@@ -20,9 +20,12 @@ void debugMessageHandler(QtMsgType type, const QMessageLogContext& context, cons
         return;
     }
 
-    Logger::m_textStream << qFormatLogMessage(type, context, msg) << Qt::endl << Qt::flush;
-
-    std::cout << qFormatLogMessage(type, context, msg).toStdString() << std::endl << std::flush;
+    // Formatting is the only work done on the calling thread, the writer
+    // thread does the file and console output.
+    Logger::m_writer.push(qFormatLogMessage(type, context, msg));
+    if (type == QtFatalMsg) {
+        Logger::m_writer.flush();
+    }
 }
 
 bool Logger::init()
@@ -37,13 +40,13 @@ bool Logger::init()
 
     qSetMessagePattern("%{time yyyy-MM-dd hh:mm:ss} %{type} %{message}");
 
-    m_file.setFileName(appDir.filePath(m_logFileName));
-    if (!m_file.open(QIODevice::Append)) {
+    if (!m_file.open(appDir.filePath(m_logFileName))) {
         qWarning() << "Cannot open log file:" << m_logFileName;
         return false;
     }
-    m_file.setTextModeEnabled(true);
-    m_textStream.setDevice(&m_file);
+    m_writer.start(&m_file);
+    BinaryLogSink::openIfEnabled(m_file.fileName());
+    SpanTracer::instance().setTraceFile(appDir.filePath(QFileInfo(m_logFileName).completeBaseName() + "-trace.json"));
     qInstallMessageHandler(debugMessageHandler);
 
     return true;
@@ -51,9 +54,10 @@ bool Logger::init()
 
 void Logger::deinit()
 {
-    m_file.close();
-    m_textStream.setDevice(nullptr);
     qInstallMessageHandler(nullptr);
+    m_writer.stop();
+    m_file.close();
+    BinaryLogSink::close();
 }
 
 QString Logger::serviceLogFileNamePath()
@@ -64,17 +68,14 @@ QString Logger::serviceLogFileNamePath()
 void Logger::clearLogs()
 {
     bool isLogActive = m_file.isOpen();
+    m_writer.stop();
     m_file.close();
-
+    BinaryLogSink::close();
 
     QString path = Utils::systemLogPath();
     QDir appDir(path);
-    QFile file;
-    file.setFileName(appDir.filePath(m_logFileName));
-
-    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
-    file.resize(0);
-    file.close();
+    RotatingLogFile::remove(appDir.filePath(m_logFileName));
+    QFile::remove(BinaryLogSink::fileNameFor(appDir.filePath(m_logFileName)));
 
     if (isLogActive) {
         init();
@@ -108,10 +109,16 @@ void Logger::cleanUp()
 
 
 Logger::Log::Log(Logger* logger, LogLevel logLevel)
-    : m_logger(logger), m_logLevel(logLevel), m_data(new Data()) {}
+    : m_logger(logger), m_logLevel(logLevel), m_data(new Data()) {
+    m_data->m_binary = BinaryLogSink::isOpen();
+}
 
 Logger::Log::~Log() {
-    qDebug() << "Amnezia" << m_logger->className() << m_data->m_buffer.trimmed();
+    if (m_data->m_binary) {
+        BinaryLogSink::write(m_logLevel, m_logger->className(), m_data->m_args);
+    } else {
+        qDebug() << "Amnezia" << m_logger->className() << m_data->m_buffer.trimmed();
+    }
     delete m_data;
 }
 
@@ -129,32 +136,89 @@ QString Logger::sensitive(const QString& input) {
 }
 
 
-#define CREATE_LOG_OP_REF(x)                  \
-Logger::Log& Logger::Log::operator<<(x t) {   \
-        m_data->m_ts << t << ' ';                 \
-        return *this;                             \
+Logger::Log& Logger::Log::operator<<(uint64_t t) {
+    if (m_data->m_binary) {
+        m_data->m_args.append({BinaryLog::Unsigned, t});
+    } else {
+        m_data->m_ts << t << ' ';
+    }
+    return *this;
 }
 
-CREATE_LOG_OP_REF(uint64_t);
-CREATE_LOG_OP_REF(const char*);
-CREATE_LOG_OP_REF(const QString&);
-CREATE_LOG_OP_REF(const QByteArray&);
-CREATE_LOG_OP_REF(const void*);
+void Logger::Log::addLiteral(const char* literal) {
+    if (m_data->m_binary) {
+        BinaryLog::Arg arg{BinaryLog::Literal};
+        arg.literal = literal;
+        m_data->m_args.append(arg);
+    } else {
+        m_data->m_ts << literal << ' ';
+    }
+}
 
-#undef CREATE_LOG_OP_REF
+void Logger::Log::addCString(const char* text) {
+    if (m_data->m_binary) {
+        addText(QString::fromUtf8(text));
+    } else {
+        m_data->m_ts << text << ' ';
+    }
+}
+
+Logger::Log& Logger::Log::operator<<(const QString& t) {
+    if (m_data->m_binary) {
+        addText(t);
+    } else {
+        m_data->m_ts << t << ' ';
+    }
+    return *this;
+}
+
+Logger::Log& Logger::Log::operator<<(const QByteArray& t) {
+    if (m_data->m_binary) {
+        addText(QString::fromUtf8(t));
+    } else {
+        m_data->m_ts << t << ' ';
+    }
+    return *this;
+}
+
+Logger::Log& Logger::Log::operator<<(const void* t) {
+    if (m_data->m_binary) {
+        m_data->m_args.append({BinaryLog::Pointer, quint64(quintptr(t))});
+    } else {
+        m_data->m_ts << t << ' ';
+    }
+    return *this;
+}
+
+void Logger::Log::addText(const QString& text) {
+    BinaryLog::Arg arg{BinaryLog::Text};
+    arg.text = text;
+    m_data->m_args.append(arg);
+}
 
 Logger::Log& Logger::Log::operator<<(const QStringList& t) {
-    m_data->m_ts << '[' << t.join(",") << ']' << ' ';
+    if (m_data->m_binary) {
+        addText('[' + t.join(",") + ']');
+    } else {
+        m_data->m_ts << '[' << t.join(",") << ']' << ' ';
+    }
     return *this;
 }
 
 Logger::Log& Logger::Log::operator<<(const QJsonObject& t) {
-    m_data->m_ts << QJsonDocument(t).toJson(QJsonDocument::Indented) << ' ';
+    if (m_data->m_binary) {
+        addText(QJsonDocument(t).toJson(QJsonDocument::Indented));
+    } else {
+        m_data->m_ts << QJsonDocument(t).toJson(QJsonDocument::Indented) << ' ';
+    }
     return *this;
 }
 
 Logger::Log& Logger::Log::operator<<(QTextStreamFunction t) {
-    m_data->m_ts << t;
+    // Stream manipulators only affect the text rendering.
+    if (!m_data->m_binary) {
+        m_data->m_ts << t;
+    }
     return *this;
 }
 
@@ -181,5 +245,9 @@ void Logger::Log::addMetaEnum(quint64 value, const QMetaObject* meta,
         ts << value << ")";
     }
 
-    m_data->m_ts << out;
+    if (m_data->m_binary) {
+        addText(out);
+    } else {
+        m_data->m_ts << out;
+    }
 }
@@ -6,6 +6,10 @@
 #include <QString>
 #include <QTextStream>
 
+#include "binarylog.h"
+#include "logwriter.h"
+#include "rotatinglogfile.h"
+
 #include "mozilla/shared/loglevel.h"
 
 class Logger
@@ -29,7 +33,6 @@ public:
         ~Log();
 
         Log& operator<<(uint64_t t);
-        Log& operator<<(const char* t);
         Log& operator<<(const QString& t);
         Log& operator<<(const QStringList& t);
         Log& operator<<(const QByteArray& t);
@@ -37,6 +40,26 @@ public:
         Log& operator<<(QTextStreamFunction t);
         Log& operator<<(const void* t);
 
+        // Only string literals are kept by pointer and interned by the binary
+        // log. Any other C string is copied, it may be gone or overwritten
+        // by the time the record is written.
+        template <size_t N>
+        Log& operator<<(const char (&t)[N]) {
+            addLiteral(t);
+            return *this;
+        }
+        template <size_t N>
+        Log& operator<<(char (&t)[N]) {
+            addCString(t);
+            return *this;
+        }
+        template <typename T>
+        typename std::enable_if<std::is_same<T, const char*>::value || std::is_same<T, char*>::value, Log&>::type
+        operator<<(T t) {
+            addCString(t);
+            return *this;
+        }
+
         // Q_ENUM
         template <typename T>
         typename std::enable_if<QtPrivate::IsQEnumHelper<T>::Value, Log&>::type
@@ -49,6 +72,9 @@ public:
 
     private:
         void addMetaEnum(quint64 value, const QMetaObject* meta, const char* name);
+        void addText(const QString& text);
+        void addLiteral(const char* literal);
+        void addCString(const char* text);
 
         Logger* m_logger;
         LogLevel m_logLevel;
@@ -58,6 +84,10 @@ public:
 
             QString m_buffer;
             QTextStream m_ts;
+
+            // Arguments kept typed for the binary log instead of m_buffer.
+            bool m_binary = false;
+            QList<BinaryLog::Arg> m_args;
         };
 
         Data* m_data;
@@ -72,9 +102,9 @@ public:
 private:
     friend void debugMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& msg);
 
-    static QFile m_file;
+    static RotatingLogFile m_file;
     static QString m_logFileName;
-    static QTextStream m_textStream;
+    static LogWriter m_writer;
 
     // compat with Mozilla logger
     QString m_className;
@@ -17,6 +17,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <QFileInfo>
 
@@ -28,127 +29,292 @@ RouterLinux &RouterLinux::Instance()
     return s;
 }
 
-bool RouterLinux::routeAdd(const QString &ipWithSubnet, const QString &gw, const int &sock)
-{
-    QString ip = NetworkUtilities::ipAddressFromIpWithSubnet(ipWithSubnet);
-    QString mask = NetworkUtilities::netMaskFromIpWithSubnet(ipWithSubnet);
-
-    if (!NetworkUtilities::checkIPv4Format(ip) || !NetworkUtilities::checkIPv4Format(gw)) {
-        qCritical().noquote() << "Critical, trying to add invalid route: " << ip << gw;
-        return false;
+namespace {
+    // Requests are flushed to the kernel once the pending buffer grows past
+    // this size, i.e. a few hundred routes per sendmsg().
+    constexpr int NETLINK_BATCH_SIZE = 32 * 1024;
+    // Every request of a batch is acknowledged, and each ACK is queued as a
+    // separate skb, which is charged well above its payload against the
+    // receive buffer. The batch is also bounded by how many of them fit.
+    constexpr int NETLINK_RCVBUF_SIZE = 1024 * 1024;
+    constexpr int NETLINK_ACK_TRUESIZE = 1024;
+
+    struct RoutePrefix {
+        QString ip;
+        struct in_addr dst;
+        int prefix;
+    };
+
+    bool parseIpv4Prefix(const QString &ipWithSubnet, struct in_addr *addr, int *prefix)
+    {
+        const int slash = ipWithSubnet.indexOf('/');
+        *prefix = 32;
+        if (slash >= 0) {
+            bool ok;
+            *prefix = ipWithSubnet.mid(slash + 1).toInt(&ok);
+            if (!ok || *prefix < 0 || *prefix > 32) {
+                return false;
+            }
+        }
+
+        const QByteArray ip = (slash >= 0 ? ipWithSubnet.left(slash) : ipWithSubnet).toLatin1();
+        if (inet_pton(AF_INET, ip.constData(), addr) != 1) {
+            return false;
+        }
+
+        addr->s_addr &= (*prefix == 0) ? 0 : htonl(0xFFFFFFFFu << (32 - *prefix));
+        return true;
     }
 
-    struct rtentry route;
-    memset(&route, 0, sizeof( route ));
+    void appendRouteAttr(QByteArray &buf, int msgOffset, int type, const void *data, int len)
+    {
+        struct rtattr attr;
+        attr.rta_type = type;
+        attr.rta_len = RTA_LENGTH(len);
 
-    // set gateway
-    ((struct sockaddr_in *)&route.rt_gateway)->sin_family = AF_INET;
-    ((struct sockaddr_in *)&route.rt_gateway)->sin_addr.s_addr = inet_addr(gw.toStdString().c_str());
-    ((struct sockaddr_in *)&route.rt_gateway)->sin_port = 0;
-    // set host rejecting
-    ((struct sockaddr_in *)&route.rt_dst)->sin_family = AF_INET;
-    ((struct sockaddr_in *)&route.rt_dst)->sin_addr.s_addr = inet_addr(ip.toStdString().c_str());
-    ((struct sockaddr_in *)&route.rt_dst)->sin_port = 0;
-    // set mask
-    ((struct sockaddr_in *)&route.rt_genmask)->sin_family = AF_INET;
-    ((struct sockaddr_in *)&route.rt_genmask)->sin_addr.s_addr = inet_addr(mask.toStdString().c_str());
-    ((struct sockaddr_in *)&route.rt_genmask)->sin_port = 0;
+        buf.append(reinterpret_cast<const char *>(&attr), sizeof(attr));
+        buf.append(reinterpret_cast<const char *>(data), len);
+        buf.append(RTA_SPACE(len) - RTA_LENGTH(len), '\0');
 
-    route.rt_flags = RTF_UP | RTF_GATEWAY;
-    route.rt_metric = 0;
+        reinterpret_cast<struct nlmsghdr *>(buf.data() + msgOffset)->nlmsg_len = buf.size() - msgOffset;
+    }
 
-    if (int err = ioctl(sock, SIOCADDRT, &route) < 0)
+    void appendRouteMessage(QByteArray &buf, int action, uint32_t seq,
+                            const struct in_addr &dst, int prefix, const struct in_addr &gw)
     {
-        qDebug().noquote() << "route add error: gw "
-                           << ((struct sockaddr_in *)&route.rt_gateway)->sin_addr.s_addr
-                           << " ip " << ((struct sockaddr_in *)&route.rt_dst)->sin_addr.s_addr
-                           << " mask " << ((struct sockaddr_in *)&route.rt_genmask)->sin_addr.s_addr << " " << err;
-        return false;
+        const int msgOffset = buf.size();
+
+        struct nlmsghdr nh;
+        memset(&nh, 0, sizeof(nh));
+        nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+        nh.nlmsg_type = action;
+        // Every request asks for an ACK, so a route is only reported as applied
+        // once the kernel has confirmed it, even if other ACKs get dropped.
+        nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+        if (action == RTM_NEWROUTE) {
+            nh.nlmsg_flags |= NLM_F_CREATE;
+        }
+        nh.nlmsg_seq = seq;
+
+        struct rtmsg rtm;
+        memset(&rtm, 0, sizeof(rtm));
+        rtm.rtm_family = AF_INET;
+        rtm.rtm_dst_len = prefix;
+        rtm.rtm_table = RT_TABLE_MAIN;
+        if (action == RTM_NEWROUTE) {
+            rtm.rtm_protocol = RTPROT_BOOT;
+            rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+            rtm.rtm_type = RTN_UNICAST;
+        } else {
+            rtm.rtm_scope = RT_SCOPE_NOWHERE;
+        }
+
+        buf.append(reinterpret_cast<const char *>(&nh), sizeof(nh));
+        buf.append(reinterpret_cast<const char *>(&rtm), sizeof(rtm));
+        buf.append(NLMSG_SPACE(sizeof(struct rtmsg)) - NLMSG_LENGTH(sizeof(struct rtmsg)), '\0');
+
+        appendRouteAttr(buf, msgOffset, RTA_DST, &dst, sizeof(dst));
+        appendRouteAttr(buf, msgOffset, RTA_GATEWAY, &gw, sizeof(gw));
     }
-
-    m_addedRoutes.append({ipWithSubnet, gw});
-    return true;
 }
 
 int RouterLinux::routeAddList(const QString &gw, const QStringList &ips)
 {
-    int temp_sock = socket(AF_INET, SOCK_DGRAM,  IPPROTO_IP);
-    int cnt = 0;
-    for (const QString &ip: ips) {
-        if (routeAdd(ip, gw, temp_sock)) cnt++;
+    QStringList added;
+    QStringList unconfirmed;
+    const int cnt = routeBatch(RTM_NEWROUTE, gw, ips, &added, &unconfirmed);
+    // Routes whose ACK was lost may well be installed, deleting them on
+    // cleanup is harmless if they aren't.
+    for (const QString &ip : added + unconfirmed) {
+        m_addedRoutes.append({ip, gw});
     }
-    close(temp_sock);
     return cnt;
 }
 
 bool RouterLinux::clearSavedRoutes()
 {
-    int temp_sock = socket(AF_INET, SOCK_DGRAM,  IPPROTO_IP);
-    int cnt = 0;
+    QHash<QString, QStringList> routesByGateway;
     for (const Route &r: m_addedRoutes) {
-        if (routeDelete(r.dst, r.gw, temp_sock)) cnt++;
+        routesByGateway[r.gw].append(r.dst);
+    }
+
+    int cnt = 0;
+    for (auto it = routesByGateway.constBegin(); it != routesByGateway.constEnd(); ++it) {
+        cnt += routeBatch(RTM_DELROUTE, it.key(), it.value());
     }
     bool ret = (cnt == m_addedRoutes.count());
     m_addedRoutes.clear();
-    close(temp_sock);
     return ret;
 }
 
-bool RouterLinux::routeDelete(const QString &ipWithSubnet, const QString &gw, const int &sock)
+int RouterLinux::routeDeleteList(const QString &gw, const QStringList &ips)
 {
-#ifdef MZ_DEBUG
-    qDebug().noquote() << "RouterLinux::routeDelete: " << ipWithSubnet << gw;
-#endif
+    return routeBatch(RTM_DELROUTE, gw, ips);
+}
 
-    QString ip = NetworkUtilities::ipAddressFromIpWithSubnet(ipWithSubnet);
-    QString mask = NetworkUtilities::netMaskFromIpWithSubnet(ipWithSubnet);
+int RouterLinux::routeBatch(int action, const QString &gw, const QStringList &ips, QStringList *applied,
+                            QStringList *unconfirmed)
+{
+    struct in_addr gwAddr;
+    if (inet_pton(AF_INET, gw.toLatin1().constData(), &gwAddr) != 1) {
+        qCritical().noquote() << "Critical, trying to use invalid route gateway: " << gw;
+        return 0;
+    }
 
-    if (!NetworkUtilities::checkIPv4Format(ip) || !NetworkUtilities::checkIPv4Format(gw)) {
-        qCritical().noquote() << "Critical, trying to remove invalid route: " << ip << gw;
-        return false;
+    int cnt = 0;
+    QList<RoutePrefix> routes;
+    routes.reserve(ips.size());
+    for (const QString &ip : ips) {
+        RoutePrefix r { ip, {}, 0 };
+        if (!parseIpv4Prefix(ip, &r.dst, &r.prefix)) {
+            qCritical().noquote() << "Critical, trying to use invalid route: " << ip << gw;
+            continue;
+        }
+        if (action == RTM_DELROUTE && r.prefix == 0) {
+            qDebug().noquote() << "Warning, trying to remove default route, skipping: " << ip << gw;
+            cnt++;
+            continue;
+        }
+        routes.append(r);
+    }
+    if (routes.isEmpty()) {
+        return cnt;
     }
 
-    if (ipWithSubnet == "0.0.0.0/0") {
-        qDebug().noquote() << "Warning, trying to remove default route, skipping: " << ip << gw;
-        return true;
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sock < 0) {
+        qDebug().noquote() << "can't open rtnl: " << strerror(errno);
+        return cnt;
     }
 
-    struct rtentry route;
-    memset(&route, 0, sizeof( route ));
+    struct sockaddr_nl local;
+    memset(&local, 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        qDebug().noquote() << "can't bind rtnl: " << strerror(errno);
+        close(sock);
+        return cnt;
+    }
 
-    // set gateway
-    ((struct sockaddr_in *)&route.rt_gateway)->sin_family = AF_INET;
-    ((struct sockaddr_in *)&route.rt_gateway)->sin_addr.s_addr = inet_addr(gw.toStdString().c_str());
-    ((struct sockaddr_in *)&route.rt_gateway)->sin_port = 0;
-    // set host rejecting
-    ((struct sockaddr_in *)&route.rt_dst)->sin_family = AF_INET;
-    ((struct sockaddr_in *)&route.rt_dst)->sin_addr.s_addr = inet_addr(ip.toStdString().c_str());
-    ((struct sockaddr_in *)&route.rt_dst)->sin_port = 0;
-    // set mask
-    ((struct sockaddr_in *)&route.rt_genmask)->sin_family = AF_INET;
-    ((struct sockaddr_in *)&route.rt_genmask)->sin_addr.s_addr = inet_addr(mask.toStdString().c_str());
-    ((struct sockaddr_in *)&route.rt_genmask)->sin_port = 0;
+    /* 1 Sec Timeout to avoid stall */
+    struct timeval tv;
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
-    route.rt_flags = RTF_UP | RTF_GATEWAY;
-    route.rt_metric = 0;
-    //route.rt_dev = "ens33";
+    // Error ACKs carry only the header of the failed request instead of echoing it.
+    int one = 1;
+    setsockopt(sock, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
 
-    if (ioctl(sock, SIOCDELRT, &route) < 0)
-    {
-        qDebug().noquote() << "route delete error: gw " << gw << " ip " << ip << " mask " << mask;
-        return false;
+    // The service runs as root, so the buffer may exceed rmem_max.
+    int rcvbuf = NETLINK_RCVBUF_SIZE;
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0) {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
     }
-    return true;
+    socklen_t optlen = sizeof(rcvbuf);
+    if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &optlen) < 0) {
+        rcvbuf = 0;
+    }
+    // Half of the buffer, the kernel's own bookkeeping takes the rest.
+    const int maxBatchRoutes = qMax(16, rcvbuf / 2 / NETLINK_ACK_TRUESIZE);
+
+    uint32_t seq = 1;
+    QByteArray buf;
+    buf.reserve(NETLINK_BATCH_SIZE + NLMSG_SPACE(sizeof(struct rtmsg) + 2 * RTA_SPACE(sizeof(struct in_addr))));
+    QStringList pending;
+
+    for (int i = 0; i < routes.size(); ++i) {
+        const RoutePrefix &r = routes.at(i);
+        appendRouteMessage(buf, action, seq + pending.size(), r.dst, r.prefix, gwAddr);
+        pending.append(r.ip);
+
+        const bool last = (i == routes.size() - 1) || (buf.size() >= NETLINK_BATCH_SIZE)
+                || (pending.size() >= maxBatchRoutes);
+        if (last) {
+            cnt += flushRouteBatch(sock, buf, seq, pending, applied, unconfirmed);
+            seq += pending.size();
+            buf.truncate(0);
+            pending.clear();
+        }
+    }
+
+    close(sock);
+    return cnt;
 }
 
-bool RouterLinux::routeDeleteList(const QString &gw, const QStringList &ips)
+int RouterLinux::flushRouteBatch(int sock, const QByteArray &buf, uint32_t firstSeq, const QStringList &pending,
+                                 QStringList *applied, QStringList *unconfirmed)
 {
-    int temp_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    enum Result { Unknown, Applied, Failed };
+
+    if (send(sock, buf.constData(), buf.size(), 0) != buf.size()) {
+        // Nothing of a short send is known to be handled.
+        qDebug().noquote() << "route batch send error: " << strerror(errno);
+        if (unconfirmed) {
+            unconfirmed->append(pending);
+        }
+        return 0;
+    }
+
+    const uint32_t lastSeq = firstSeq + pending.size() - 1;
+    QVector<Result> results(pending.size(), Unknown);
+    bool done = false;
+
+    char reply[8192];
+    while (!done) {
+        int len = recv(sock, reply, sizeof(reply), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                // Some ACKs were dropped, keep reading the ones still queued.
+                qDebug().noquote() << "route batch recv overrun, some results are lost";
+                continue;
+            }
+            // Timed out or failed, the requests without an ACK stay unknown.
+            qDebug().noquote() << "route batch recv error: " << strerror(errno);
+            break;
+        }
+
+        for (struct nlmsghdr *nh = (struct nlmsghdr *)reply; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type != NLMSG_ERROR || nh->nlmsg_seq < firstSeq || nh->nlmsg_seq > lastSeq) {
+                continue;
+            }
+
+            const struct nlmsgerr *err = (const struct nlmsgerr *)NLMSG_DATA(nh);
+            const int index = nh->nlmsg_seq - firstSeq;
+            if (err->error != 0) {
+                results[index] = Failed;
+                qDebug().noquote() << "route batch error: ip " << pending.at(index) << " " << strerror(-err->error);
+            } else {
+                results[index] = Applied;
+            }
+            // The kernel handles the batch in order, nothing else is coming.
+            if (nh->nlmsg_seq == lastSeq) {
+                done = true;
+            }
+        }
+    }
+
     int cnt = 0;
-    for (const QString &ip: ips) {
-        if (routeDelete(ip, gw, temp_sock)) cnt++;
+    for (int i = 0; i < pending.size(); ++i) {
+        switch (results.at(i)) {
+        case Applied:
+            cnt++;
+            if (applied) {
+                applied->append(pending.at(i));
+            }
+            break;
+        case Unknown:
+            if (unconfirmed) {
+                unconfirmed->append(pending.at(i));
+            }
+            break;
+        case Failed:
+            break;
+        }
     }
-    close(temp_sock);
     return cnt;
 }
 
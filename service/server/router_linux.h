@@ -24,11 +24,9 @@ public:
 
     static RouterLinux& Instance();
 
-    bool routeAdd(const QString &ip, const QString &gw, const int &sock);
     int routeAddList(const QString &gw, const QStringList &ips);
     bool clearSavedRoutes();
-    bool routeDelete(const QString &ip, const QString &gw, const int &sock);
-    bool routeDeleteList(const QString &gw, const QStringList &ips);
+    int routeDeleteList(const QString &gw, const QStringList &ips);
     QString getgatewayandiface();
     void flushDns();
     bool createTun(const QString &dev, const QString &subnet);
@@ -43,6 +41,15 @@ private:
     RouterLinux(RouterLinux const &) = delete;
     RouterLinux& operator= (RouterLinux const&) = delete;
 
+    // Programs all routes through one rtnetlink socket, packing many
+    // RTM_NEWROUTE/RTM_DELROUTE requests into each send() call. Returns the
+    // number of routes the kernel confirmed, routes whose ACK never arrived
+    // go to unconfirmed.
+    int routeBatch(int action, const QString &gw, const QStringList &ips, QStringList *applied = nullptr,
+                   QStringList *unconfirmed = nullptr);
+    int flushRouteBatch(int sock, const QByteArray &buf, uint32_t firstSeq, const QStringList &pending,
+                        QStringList *applied, QStringList *unconfirmed);
+
     QList<Route> m_addedRoutes;
     DnsUtilsLinux *m_dnsUtil;
 };
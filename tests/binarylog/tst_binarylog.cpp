@@ -0,0 +1,134 @@
+#include <QBuffer>
+#include <QTest>
+
+#include "binarylog.h"
+#include "mozilla/shared/loglevel.h"
+
+namespace
+{
+    BinaryLog::Arg literal(const char *value)
+    {
+        BinaryLog::Arg arg { BinaryLog::Literal };
+        arg.literal = value;
+        return arg;
+    }
+
+    BinaryLog::Arg text(const QString &value)
+    {
+        BinaryLog::Arg arg { BinaryLog::Text };
+        arg.text = value;
+        return arg;
+    }
+
+    BinaryLog::Arg number(BinaryLog::ArgType type, quint64 value)
+    {
+        BinaryLog::Arg arg { type };
+        arg.number = value;
+        return arg;
+    }
+
+    QByteArray header()
+    {
+        return QByteArray(BinaryLog::MAGIC, BinaryLog::MAGIC_SIZE);
+    }
+}
+
+class TestBinaryLog : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void literalsAreDefinedOnce();
+    void reset();
+    void truncated();
+};
+
+void TestBinaryLog::roundTrip()
+{
+    QByteArray data = header();
+    BinaryLogEncoder encoder;
+    encoder.encode(1000, LogLevel::Info, "Daemon",
+                   { literal("Activating"), text(QString::fromUtf8("wg0 é")), number(BinaryLog::Unsigned, 300),
+                     number(BinaryLog::Pointer, 0xdeadbeef) },
+                   data);
+    // An earlier timestamp, deltas are signed.
+    encoder.encode(990, LogLevel::Error, "Router", { literal("failed:"), text("No such process") }, data);
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    BinaryLogDecoder decoder(&buffer);
+    QVERIFY(decoder.readHeader());
+
+    BinaryLog::Entry entry;
+    QVERIFY(decoder.next(entry));
+    QCOMPARE(entry.timestamp, qint64(1000));
+    QCOMPARE(entry.level, int(LogLevel::Info));
+    QCOMPARE(entry.category, QString("Daemon"));
+    QCOMPARE(entry.message, QString::fromUtf8("Activating wg0 é 300 0xdeadbeef"));
+
+    QVERIFY(decoder.next(entry));
+    QCOMPARE(entry.timestamp, qint64(990));
+    QCOMPARE(entry.level, int(LogLevel::Error));
+    QCOMPARE(entry.category, QString("Router"));
+    QCOMPARE(entry.message, QString("failed: No such process"));
+
+    QVERIFY(!decoder.next(entry));
+    QVERIFY(decoder.error().isEmpty());
+}
+
+void TestBinaryLog::literalsAreDefinedOnce()
+{
+    BinaryLogEncoder encoder;
+    QByteArray first;
+    encoder.encode(0, LogLevel::Debug, "Category", { literal("a fairly long literal") }, first);
+    QByteArray second;
+    encoder.encode(0, LogLevel::Debug, "Category", { literal("a fairly long literal") }, second);
+
+    QVERIFY(first.contains("a fairly long literal"));
+    QVERIFY(!second.contains("a fairly long literal"));
+    QVERIFY(!second.contains("Category"));
+}
+
+void TestBinaryLog::reset()
+{
+    QByteArray data = header();
+    BinaryLogEncoder encoder;
+    encoder.encode(5000, LogLevel::Info, "First", { literal("before") }, data);
+    // A second writer appending to the same file starts over.
+    encoder.reset(data);
+    encoder.encode(20, LogLevel::Info, "Second", { literal("after") }, data);
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    BinaryLogDecoder decoder(&buffer);
+    QVERIFY(decoder.readHeader());
+
+    BinaryLog::Entry entry;
+    QVERIFY(decoder.next(entry));
+    QCOMPARE(entry.message, QString("before"));
+    QVERIFY(decoder.next(entry));
+    QCOMPARE(entry.timestamp, qint64(20));
+    QCOMPARE(entry.category, QString("Second"));
+    QCOMPARE(entry.message, QString("after"));
+}
+
+void TestBinaryLog::truncated()
+{
+    QByteArray data = header();
+    BinaryLogEncoder encoder;
+    encoder.encode(0, LogLevel::Info, "Category", { text("cut off here") }, data);
+    data.chop(4);
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    BinaryLogDecoder decoder(&buffer);
+    QVERIFY(decoder.readHeader());
+
+    BinaryLog::Entry entry;
+    QVERIFY(!decoder.next(entry));
+    QVERIFY(!decoder.error().isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TestBinaryLog)
+#include "tst_binarylog.moc"
@@ -0,0 +1,83 @@
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "spantracer.h"
+
+class TestSpanTracer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void chromeTrace();
+
+private:
+    QJsonObject readTrace();
+
+    QTemporaryDir m_dir;
+    QString m_traceFile;
+};
+
+void TestSpanTracer::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    m_traceFile = m_dir.filePath("trace.json");
+    SpanTracer::instance().setTraceFile(m_traceFile);
+}
+
+QJsonObject TestSpanTracer::readTrace()
+{
+    QFile file(m_traceFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+void TestSpanTracer::chromeTrace()
+{
+    SpanTracer &tracer = SpanTracer::instance();
+    {
+        SpanTracer::Scope span("test.scope");
+        QTest::qSleep(2);
+    }
+    tracer.begin("test.open");
+    tracer.end("test.open");
+    tracer.begin("test.cancelled");
+    tracer.cancel("test.cancelled");
+    // Not begun, nothing to record.
+    tracer.end("test.unknown");
+
+    QVERIFY(tracer.writeTrace());
+    const QJsonObject trace = readTrace();
+    QCOMPARE(trace.value("displayTimeUnit").toString(), QString("ms"));
+
+    const QJsonArray events = trace.value("traceEvents").toArray();
+    QCOMPARE(events.size(), 2);
+
+    const QJsonObject scope = events.at(0).toObject();
+    QCOMPARE(scope.value("name").toString(), QString("test.scope"));
+    QCOMPARE(scope.value("ph").toString(), QString("X"));
+    QVERIFY(scope.value("dur").toInteger() >= 2000);
+    QVERIFY(scope.value("ts").toInteger() > 0);
+    QVERIFY(scope.contains("pid"));
+    QVERIFY(scope.contains("tid"));
+
+    const QJsonObject open = events.at(1).toObject();
+    QCOMPARE(open.value("name").toString(), QString("test.open"));
+    QVERIFY(open.value("ts").toInteger() >= scope.value("ts").toInteger() + scope.value("dur").toInteger());
+
+    const QJsonObject stages = trace.value("stagePercentilesUs").toObject();
+    QCOMPARE(stages.keys(), QStringList({ "test.open", "test.scope" }));
+    const QJsonObject scopeStats = stages.value("test.scope").toObject();
+    QCOMPARE(scopeStats.value("count").toInt(), 1);
+    QCOMPARE(scopeStats.value("p50").toInteger(), scope.value("dur").toInteger());
+    QCOMPARE(scopeStats.value("p99").toInteger(), scope.value("dur").toInteger());
+}
+
+QTEST_GUILESS_MAIN(TestSpanTracer)
+#include "tst_spantracer.moc"
@@ -0,0 +1,324 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMap>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+
+#include "daemon/daemonlocalserverconnection.h"
+#include "mockdaemon.h"
+#include "spantracer.h"
+
+namespace
+{
+    constexpr int REPLY_TIMEOUT_MSEC = 5000;
+
+    struct Capture
+    {
+        QList<QJsonObject> requests;
+        QMap<QString, int> replyCounts;
+    };
+
+    bool loadCapture(const QString &fileName, Capture &capture, QString &error)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            error = file.errorString();
+            return false;
+        }
+
+        int lineNumber = 0;
+        while (!file.atEnd()) {
+            ++lineNumber;
+            const QByteArray line = file.readLine().trimmed();
+            if (line.isEmpty()) {
+                continue;
+            }
+
+            const QJsonObject entry = QJsonDocument::fromJson(line).object();
+            const QJsonObject message = entry.value("msg").toObject();
+            if (message.isEmpty()) {
+                error = QString("line %1: not a capture entry").arg(lineNumber);
+                return false;
+            }
+
+            if (entry.value("dir").toString() == "in") {
+                capture.requests.append(message);
+            } else {
+                ++capture.replyCounts[message.value("type").toString()];
+            }
+        }
+        return true;
+    }
+
+    QByteArray frame(const QJsonObject &message)
+    {
+        return QJsonDocument(message).toJson(QJsonDocument::Compact) + '\n';
+    }
+
+    QString percentiles(QList<qint64> values)
+    {
+        if (values.isEmpty()) {
+            return "-";
+        }
+        std::sort(values.begin(), values.end());
+        auto at = [&values](int percent) { return values.at((values.size() - 1) * percent / 100); };
+        return QString("n=%1 p50=%2us p99=%3us max=%4us").arg(values.size()).arg(at(50)).arg(at(99)).arg(values.last());
+    }
+
+    // Client end of the daemon socket, the role LocalSocketController plays.
+    class Client
+    {
+    public:
+        bool connectTo(const QString &name)
+        {
+            m_socket.connectToServer(name);
+            if (!m_socket.waitForConnected(REPLY_TIMEOUT_MSEC)) {
+                return false;
+            }
+            QObject::connect(&m_socket, &QLocalSocket::readyRead, [this]() { read(); });
+            return true;
+        }
+
+        void send(const QByteArray &data)
+        {
+            m_socket.write(data);
+            m_socket.flush();
+        }
+
+        // Runs the event loop until count replies of one of the types have
+        // arrived in total.
+        bool waitFor(const QStringList &types, int count)
+        {
+            auto received = [this, &types]() {
+                int total = 0;
+                for (const QString &type : types) {
+                    total += m_counts.value(type);
+                }
+                return total;
+            };
+            if (received() >= count) {
+                return true;
+            }
+
+            QEventLoop loop;
+            QTimer timeout;
+            timeout.setSingleShot(true);
+            QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+            m_onReply = [&]() {
+                if (received() >= count) {
+                    loop.quit();
+                }
+            };
+            timeout.start(REPLY_TIMEOUT_MSEC);
+            loop.exec();
+            m_onReply = nullptr;
+            return received() >= count;
+        }
+
+        int count(const QString &type) const { return m_counts.value(type); }
+        const QMap<QString, int> &counts() const { return m_counts; }
+
+    private:
+        void read()
+        {
+            m_buffer.append(m_socket.readAll());
+            qsizetype start = 0;
+            qsizetype pos;
+            while ((pos = m_buffer.indexOf('\n', start)) != -1) {
+                const QJsonObject reply = QJsonDocument::fromJson(m_buffer.mid(start, pos - start)).object();
+                start = pos + 1;
+                ++m_counts[reply.value("type").toString()];
+            }
+            m_buffer.remove(0, start);
+
+            if (m_onReply) {
+                m_onReply();
+            }
+        }
+
+        QLocalSocket m_socket;
+        QByteArray m_buffer;
+        QMap<QString, int> m_counts;
+        std::function<void()> m_onReply;
+    };
+
+    void quietMessageHandler(QtMsgType, const QMessageLogContext &, const QString &)
+    {
+    }
+}
+
+// Replays captures written with AMNEZIA_DAEMON_CAPTURE set against a daemon
+// with in-memory backends, timing each request and the framing of bursts.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("amnezia-daemonreplay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays AmneziaVPN daemon protocol captures against a mock daemon.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "Capture files to replay.", "<file>...");
+
+    QCommandLineOption repeatOption({ "r", "repeat" }, "Replay each capture this many times (default 1).", "count",
+                                    "1");
+    QCommandLineOption burstOption({ "b", "burst" },
+                                   "Also send the requests this many times in one write to measure framing "
+                                   "throughput (default 0).",
+                                   "count", "0");
+    QCommandLineOption verboseOption({ "v", "verbose" }, "Show the daemon log.");
+    parser.addOptions({ repeatOption, burstOption, verboseOption });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) {
+        parser.showHelp(1);
+    }
+    const int repeat = qMax(1, parser.value(repeatOption).toInt());
+    const int burst = qMax(0, parser.value(burstOption).toInt());
+
+    if (!parser.isSet(verboseOption)) {
+        qInstallMessageHandler(quietMessageHandler);
+    }
+
+    MockDaemon daemon;
+
+    const QString serverName = QString("amnezia-daemonreplay-%1").arg(QCoreApplication::applicationPid());
+    QLocalServer::removeServer(serverName);
+    QLocalServer server;
+    if (!server.listen(serverName)) {
+        err << "Unable to listen on " << serverName << ": " << server.errorString() << Qt::endl;
+        return 1;
+    }
+    QObject::connect(&server, &QLocalServer::newConnection, [&server]() {
+        QLocalSocket *socket = server.nextPendingConnection();
+        auto *connection = new DaemonLocalServerConnection(&server, socket);
+        QObject::connect(socket, &QLocalSocket::disconnected, connection, &DaemonLocalServerConnection::deleteLater);
+    });
+
+    Client client;
+    if (!client.connectTo(serverName)) {
+        err << "Unable to connect to " << serverName << Qt::endl;
+        return 1;
+    }
+
+    const QJsonObject sentinel { { "type", "status" } };
+
+    int result = 0;
+    for (const QString &fileName : files) {
+        Capture capture;
+        QString error;
+        if (!loadCapture(fileName, capture, error)) {
+            err << fileName << ": " << error << Qt::endl;
+            result = 1;
+            continue;
+        }
+
+        out << fileName << ": " << capture.requests.size() << " requests" << Qt::endl;
+
+        // Request round trips. Requests without a reply of their own are
+        // followed by a status request, the daemon handles them in order.
+        QMap<QString, QList<qint64>> latencies;
+        const QMap<QString, int> before = client.counts();
+        int sentinels = 0;
+        for (int i = 0; i < repeat; ++i) {
+            for (const QJsonObject &request : capture.requests) {
+                const QString type = request.value("type").toString();
+
+                QStringList replies;
+                if (type == "activate") {
+                    replies = QStringList { "connected", "disconnected" };
+                } else if (type == "status" || type == "logs") {
+                    replies = QStringList { type };
+                }
+
+                QElapsedTimer timer;
+                timer.start();
+                if (replies.isEmpty()) {
+                    client.send(frame(request) + frame(sentinel));
+                    ++sentinels;
+                    replies = QStringList { "status" };
+                } else {
+                    client.send(frame(request));
+                }
+
+                int expected = 0;
+                for (const QString &reply : replies) {
+                    expected += client.count(reply);
+                }
+                if (!client.waitFor(replies, expected + 1)) {
+                    err << fileName << ": no reply to " << type << Qt::endl;
+                    result = 1;
+                    continue;
+                }
+                latencies[type].append(timer.nsecsElapsed() / 1000);
+            }
+        }
+
+        for (auto it = latencies.constBegin(); it != latencies.constEnd(); ++it) {
+            out << "  " << it.key() << ": " << percentiles(it.value()) << Qt::endl;
+        }
+
+        // The replies of one pass should match the capture, apart from the
+        // status replies the sentinels caused.
+        for (auto it = capture.replyCounts.constBegin(); it != capture.replyCounts.constEnd(); ++it) {
+            int replayed = client.count(it.key()) - before.value(it.key());
+            if (it.key() == "status") {
+                replayed -= sentinels;
+            }
+            if (replayed != it.value() * repeat) {
+                err << fileName << ": " << replayed << " " << it.key() << " replies, captured "
+                    << it.value() * repeat << Qt::endl;
+                result = 1;
+            }
+        }
+
+        if (burst > 0) {
+            QByteArray data;
+            int statusRequests = 0;
+            for (int i = 0; i < burst; ++i) {
+                for (const QJsonObject &request : capture.requests) {
+                    data += frame(request);
+                    statusRequests += request.value("type").toString() == "status";
+                }
+            }
+            data += frame(sentinel);
+            ++statusRequests;
+
+            const int expected = client.count("status") + statusRequests;
+            QElapsedTimer timer;
+            timer.start();
+            client.send(data);
+            if (!client.waitFor({ "status" }, expected)) {
+                err << fileName << ": burst not fully answered" << Qt::endl;
+                result = 1;
+            }
+            const double seconds = qMax<qint64>(timer.nsecsElapsed(), 1) / 1e9;
+            const qint64 messages = qint64(burst) * capture.requests.size() + 1;
+            out << "  burst: " << messages << " messages, " << data.size() << " bytes in "
+                << QString::number(seconds * 1000, 'f', 1) << "ms, "
+                << QString::number(messages / seconds, 'f', 0) << " msg/s, "
+                << QString::number(data.size() / seconds / (1024 * 1024), 'f', 1) << " MiB/s" << Qt::endl;
+        }
+    }
+
+    // Time spent inside the daemon, from parsing a request on.
+    const QMap<QString, SpanTracer::Percentiles> spans = SpanTracer::instance().percentiles();
+    for (auto it = spans.constBegin(); it != spans.constEnd(); ++it) {
+        out << "span " << it.key() << ": n=" << it->count << " p50=" << it->p50 << "us p95=" << it->p95
+            << "us p99=" << it->p99 << "us" << Qt::endl;
+    }
+
+    return result;
+}
@@ -0,0 +1,148 @@
+#ifndef MOCKDAEMON_H
+#define MOCKDAEMON_H
+
+#include <QDateTime>
+#include <QHash>
+
+#include "daemon/daemon.h"
+
+// Backends that only keep state in memory. A peer reports its handshake as
+// soon as it has been added, so the daemon connects on its first poll.
+class MockWireguardUtils final : public WireguardUtils
+{
+public:
+    explicit MockWireguardUtils(QObject *parent) : WireguardUtils(parent)
+    {
+    }
+
+    bool interfaceExists() override { return m_exists; }
+
+    bool addInterface(const InterfaceConfig &config) override
+    {
+        Q_UNUSED(config)
+        m_exists = true;
+        return true;
+    }
+
+    bool deleteInterface() override
+    {
+        m_exists = false;
+        m_peers.clear();
+        return true;
+    }
+
+    bool updatePeer(const InterfaceConfig &config) override
+    {
+        m_peers.insert(config.m_serverPublicKey, QDateTime::currentMSecsSinceEpoch());
+        return true;
+    }
+
+    bool deletePeer(const InterfaceConfig &config) override
+    {
+        m_peers.remove(config.m_serverPublicKey);
+        return true;
+    }
+
+    QList<PeerStatus> getPeerStatus() override
+    {
+        QList<PeerStatus> result;
+        for (auto it = m_peers.constBegin(); it != m_peers.constEnd(); ++it) {
+            PeerStatus status(it.key());
+            status.m_handshake = it.value();
+            result.append(status);
+        }
+        return result;
+    }
+
+    bool updateRoutePrefix(const IPAddress &prefix) override
+    {
+        Q_UNUSED(prefix)
+        return true;
+    }
+
+    bool deleteRoutePrefix(const IPAddress &prefix) override
+    {
+        Q_UNUSED(prefix)
+        return true;
+    }
+
+    bool addExclusionRoute(const IPAddress &prefix) override
+    {
+        Q_UNUSED(prefix)
+        return true;
+    }
+
+    bool deleteExclusionRoute(const IPAddress &prefix) override
+    {
+        Q_UNUSED(prefix)
+        return true;
+    }
+
+private:
+    bool m_exists = false;
+    // Public key to handshake time (ms since epoch).
+    QHash<QString, qint64> m_peers;
+};
+
+class MockDnsUtils final : public DnsUtils
+{
+public:
+    explicit MockDnsUtils(QObject *parent) : DnsUtils(parent)
+    {
+    }
+
+    bool updateResolvers(const QString &ifname, const QList<QHostAddress> &resolvers) override
+    {
+        Q_UNUSED(ifname)
+        Q_UNUSED(resolvers)
+        return true;
+    }
+
+    bool restoreResolvers() override { return true; }
+};
+
+class MockIPUtils final : public IPUtils
+{
+public:
+    explicit MockIPUtils(QObject *parent) : IPUtils(parent)
+    {
+    }
+
+    bool addInterfaceIPs(const InterfaceConfig &config) override
+    {
+        Q_UNUSED(config)
+        return true;
+    }
+
+    bool setMTUAndUp(const InterfaceConfig &config) override
+    {
+        Q_UNUSED(config)
+        return true;
+    }
+};
+
+class MockDaemon final : public Daemon
+{
+public:
+    MockDaemon()
+        : Daemon(nullptr),
+          m_wgutils(new MockWireguardUtils(this)),
+          m_dnsutils(new MockDnsUtils(this)),
+          m_iputils(new MockIPUtils(this))
+    {
+    }
+
+protected:
+    WireguardUtils *wgutils() const override { return m_wgutils; }
+    bool supportDnsUtils() const override { return true; }
+    DnsUtils *dnsutils() override { return m_dnsutils; }
+    bool supportIPUtils() const override { return true; }
+    IPUtils *iputils() override { return m_iputils; }
+
+private:
+    MockWireguardUtils *m_wgutils;
+    MockDnsUtils *m_dnsutils;
+    MockIPUtils *m_iputils;
+};
+
+#endif // MOCKDAEMON_H
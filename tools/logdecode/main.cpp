@@ -0,0 +1,105 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QSet>
+#include <QTextStream>
+
+#include <limits>
+
+#include "binarylog.h"
+
+// Renders binary logs written with AMNEZIA_BINARY_LOG set back to text.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("amnezia-logdecode");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Decodes AmneziaVPN binary logs (*.blog) to text.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "Binary log files to decode.", "<file>...");
+
+    QCommandLineOption categoryOption({ "c", "category" }, "Only show records of this category, may be repeated.",
+                                      "name");
+    QCommandLineOption sinceOption({ "s", "since" }, "Only show records at or after this ISO 8601 time.", "time");
+    QCommandLineOption untilOption({ "u", "until" }, "Only show records before this ISO 8601 time.", "time");
+    QCommandLineOption levelOption({ "l", "level" }, "Minimum level: trace, debug, info, warning or error.", "level");
+    parser.addOptions({ categoryOption, sinceOption, untilOption, levelOption });
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    const QStringList categoryList = parser.values(categoryOption);
+    const QSet<QString> categories(categoryList.begin(), categoryList.end());
+
+    auto parseTime = [&err](const QString &value, qint64 fallback) -> qint64 {
+        if (value.isEmpty()) {
+            return fallback;
+        }
+        const QDateTime time = QDateTime::fromString(value, Qt::ISODateWithMs);
+        if (!time.isValid()) {
+            err << "Invalid time: " << value << Qt::endl;
+            exit(1);
+        }
+        return time.toMSecsSinceEpoch();
+    };
+    const qint64 since = parseTime(parser.value(sinceOption), std::numeric_limits<qint64>::min());
+    const qint64 until = parseTime(parser.value(untilOption), std::numeric_limits<qint64>::max());
+
+    int minLevel = 0;
+    if (parser.isSet(levelOption)) {
+        minLevel = -1;
+        for (int level = 0; level <= 4; ++level) {
+            if (BinaryLog::levelName(level).compare(parser.value(levelOption), Qt::CaseInsensitive) == 0) {
+                minLevel = level;
+            }
+        }
+        if (minLevel < 0) {
+            err << "Invalid level: " << parser.value(levelOption) << Qt::endl;
+            return 1;
+        }
+    }
+
+    QTextStream out(stdout);
+    int result = 0;
+    for (const QString &fileName : files) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            err << fileName << ": " << file.errorString() << Qt::endl;
+            result = 1;
+            continue;
+        }
+
+        BinaryLogDecoder decoder(&file);
+        if (!decoder.readHeader()) {
+            err << fileName << ": " << decoder.error() << Qt::endl;
+            result = 1;
+            continue;
+        }
+
+        BinaryLog::Entry entry;
+        while (decoder.next(entry)) {
+            if (entry.timestamp < since || entry.timestamp >= until || entry.level < minLevel) {
+                continue;
+            }
+            if (!categories.isEmpty() && !categories.contains(entry.category)) {
+                continue;
+            }
+            out << QDateTime::fromMSecsSinceEpoch(entry.timestamp).toString("yyyy-MM-dd hh:mm:ss.zzz") << ' '
+                << BinaryLog::levelName(entry.level) << ' ' << entry.category << ' ' << entry.message << '\n';
+        }
+
+        // A log cut short by a crash ends mid record, report but keep what was decoded.
+        if (!decoder.error().isEmpty()) {
+            err << fileName << ": " << decoder.error() << " at offset " << file.pos() << Qt::endl;
+            result = 1;
+        }
+    }
+
+    return result;
+}